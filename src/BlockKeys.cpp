@@ -0,0 +1,137 @@
+// BlockKeys.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "BlockKeys.h"
+
+// constructor
+BlockKeys::BlockKeys() {
+	mCapacity = BLOCK_KEYS_CAPACITY;
+	mSize = 0;
+	mKeys = new char*[mCapacity / 2];
+	mTable = new int[mCapacity];
+
+	for (int i = 0; i < mCapacity; i++) {
+		mTable[i] = NO_BLOCK;
+	}
+}
+
+// destructor
+BlockKeys::~BlockKeys() {
+	for (int i = 0; i < mSize; i++) {
+		delete[] mKeys[i];
+	}
+
+	delete[] mKeys;
+	delete[] mTable;
+}
+
+// compute the hash value of <key> (FNV-1a)
+unsigned int BlockKeys::hash(const char *key) {
+	unsigned int h = 2166136261u;
+
+	for (; *key != 0; key++) {
+		h = (h ^ (unsigned char) *key) * 16777619u;
+	}
+
+	return h;
+}
+
+// double the capacity of the hash table and re-insert all keys
+void BlockKeys::grow() {
+	char **keys = new char*[mCapacity];
+
+	memcpy(keys, mKeys, mSize * sizeof(char*));
+	delete[] mKeys;
+	delete[] mTable;
+
+	mKeys = keys;
+	mCapacity *= 2;
+	mTable = new int[mCapacity];
+
+	for (int i = 0; i < mCapacity; i++) {
+		mTable[i] = NO_BLOCK;
+	}
+
+	for (int b = 0; b < mSize; b++) {
+		unsigned int slot = hash(mKeys[b]) & (mCapacity - 1);
+
+		while (mTable[slot] != NO_BLOCK) {
+			slot = (slot + 1) & (mCapacity - 1);
+		}
+		mTable[slot] = b;
+	}
+}
+
+// get the number of <key>, add it if it is new
+int BlockKeys::add(const char *key) {
+	int block = find(key);
+	unsigned int slot;
+
+	if (block != NO_BLOCK) {
+		return block;
+	}
+
+	// keep the table at most half full
+	if (mSize == mCapacity / 2) {
+		grow();
+	}
+
+	slot = hash(key) & (mCapacity - 1);
+
+	while (mTable[slot] != NO_BLOCK) {
+		slot = (slot + 1) & (mCapacity - 1);
+	}
+
+	mKeys[mSize] = new char[strlen(key) + 1];
+	strcpy(mKeys[mSize], key);
+	mTable[slot] = mSize;
+
+	return mSize++;
+}
+
+// get the number of <key>, NO_BLOCK if it has not been added
+int BlockKeys::find(const char *key) {
+	unsigned int slot = hash(key) & (mCapacity - 1);
+
+	while (mTable[slot] != NO_BLOCK) {
+		if (strcmp(mKeys[mTable[slot]], key) == 0) {
+			return mTable[slot];
+		}
+		slot = (slot + 1) & (mCapacity - 1);
+	}
+
+	return NO_BLOCK;
+}
+
+// count the heap memory of the keys in <report>
+void BlockKeys::getMemory(memoryReportType *report) {
+	for (int i = 0; i < mSize; i++) {
+		memoryAdd(report, MEMORY_IDS, mKeys[i], strlen(mKeys[i]) + 1);
+	}
+
+	memoryAdd(report, MEMORY_GRID, mKeys, mCapacity / 2 * sizeof(char*), mSize * sizeof(char*));
+	memoryAdd(report, MEMORY_GRID, mTable, mCapacity * sizeof(int));
+}
@@ -0,0 +1,84 @@
+// BlockKeys.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BLOCKKEYS_H
+#define BLOCKKEYS_H
+
+#include "Memory.h"
+
+#define BLOCK_KEYS_CAPACITY 64		// initial number of hash table slots
+#define NO_BLOCK -1			// block number of an unknown key
+
+// Objects of class BlockKeys number the blocking keys of a grid, e.g.
+// sex or birth year. Records are only compared with queries of the same
+// key, so a grid partitions its cells by the number of each record's key.
+//
+// The keys are kept in an open addressing hash table with linear probing
+// that is at most half full. Keys are numbered from 0 in the order they
+// are added. Lookups do not modify the table, so any number of threads
+// may look up keys while no key is added.
+
+class BlockKeys {
+	private:
+
+	char **mKeys;			// key of each number
+	int *mTable;			// hash table of key numbers, NO_BLOCK for empty slots
+	int mCapacity;			// number of slots of the hash table, a power of 2
+	int mSize;			// number of keys
+
+	// compute the hash value of <key>
+	unsigned int hash(const char *key);
+
+	// double the capacity of the hash table
+	void grow();
+
+	public:
+
+	// constructor
+	BlockKeys();
+
+	// destructor
+	~BlockKeys();
+
+	// get the number of <key>, add it if it is new
+	int add(const char *key);
+
+	// get the number of <key>, NO_BLOCK if it has not been added
+	int find(const char *key);
+
+	// get key number <block>
+	inline const char *getKey(int block) {
+		return mKeys[block];
+	}
+
+	// get number of keys
+	inline int getSize() {
+		return mSize;
+	}
+
+	// count the heap memory of the keys in <report>
+	void getMemory(memoryReportType *report);
+};
+#endif
@@ -0,0 +1,139 @@
+// BruteForce.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "BruteForce.h"
+
+// constructor
+// copy the fingerprints <leafStart> to <leafEnd>-1 of <prints> with at most <nBits> bits
+BruteForce::BruteForce(Fingerprint **prints, long long leafStart, long long leafEnd, int nBits) {
+	long long *next;
+
+	mSize = leafEnd - leafStart;
+	mWordCount = (nBits - 1) / SCAN_WORD_LEN + 1;
+	mWords = new SCANWORD[mSize * mWordCount];
+	mRecords = new unsigned int[mSize];
+	mMinCard = (mSize > 0) ? nBits : 0;
+	mMaxCard = 0;
+	mCntTanimoto = 0;
+
+	for (long long i = leafStart; i < leafEnd; i++) {
+		mMinCard = MIN(mMinCard, prints[i]->cardinality());
+		mMaxCard = MAX(mMaxCard, prints[i]->cardinality());
+	}
+
+	// count fingerprints of each cardinality
+	mCardFirst = new long long[mMaxCard + 2];
+	next = new long long[mMaxCard + 1];
+
+	for (int c = 0; c <= mMaxCard + 1; c++) {
+		mCardFirst[c] = 0;
+	}
+	for (long long i = leafStart; i < leafEnd; i++) {
+		mCardFirst[prints[i]->cardinality() + 1]++;
+	}
+	for (int c = 0; c <= mMaxCard; c++) {
+		mCardFirst[c + 1] += mCardFirst[c];
+		next[c] = mCardFirst[c];
+	}
+
+	// copy fingerprints in order of cardinality
+	for (long long i = leafStart; i < leafEnd; i++) {
+		long long pos = next[prints[i]->cardinality()]++;
+		SCANWORD *words = &mWords[pos * mWordCount];
+
+		mRecords[pos] = (unsigned int) prints[i]->getIndex();
+
+		for (int w = 0; w < mWordCount; w++) {
+			words[w] = ((SCANWORD) prints[i]->getWord(2 * w)) | (((SCANWORD) prints[i]->getWord(2 * w + 1)) << WORD_LEN);
+		}
+	}
+
+	delete[] next;
+}
+
+// destructor
+BruteForce::~BruteForce() {
+	delete[] mWords;
+	delete[] mRecords;
+	delete[] mCardFirst;
+}
+
+// count the heap memory of the scan in <report>
+void BruteForce::getMemory(memoryReportType *report) {
+	memoryAdd(report, MEMORY_SCANS, this, sizeof(BruteForce));
+	memoryAdd(report, MEMORY_SCANS, mWords, mSize * mWordCount * sizeof(SCANWORD));
+	memoryAdd(report, MEMORY_SCANS, mRecords, mSize * sizeof(unsigned int));
+	memoryAdd(report, MEMORY_SCANS, mCardFirst, (mMaxCard + 2) * sizeof(long long));
+}
+
+// perform a search for <query> that has <cardinality> filtered by <minTanimoto>
+// and add the result to <result>, return number of results
+// <minTanimoto> is a threshold of the measure of <result>
+long long BruteForce::search(QueryResult *result, Fingerprint *query, int cardinality, float *minTanimoto) {
+	SCANWORD stackWords[SCAN_QUERY_WORDS];
+	SCANWORD *queryWords = (mWordCount <= SCAN_QUERY_WORDS) ? stackWords : new SCANWORD[mWordCount];
+	long long hits = 0;
+	const measureType *measure = result->getMeasure();
+
+	// pack query, bits beyond the stored words only count for the union
+	for (int w = 0; w < mWordCount; w++) {
+		queryWords[w] = ((SCANWORD) query->getWord(2 * w)) | (((SCANWORD) query->getWord(2 * w + 1)) << WORD_LEN);
+	}
+
+	for (int c = mMinCard; c <= mMaxCard; c++) {
+		// the score is at most the one of MIN(c, cardinality) common bits,
+		// for the Tanimoto coefficient this is the ratio of the cardinalities,
+		// computed like Fingerprint::tanimoto for identical rounding
+		if ((mCardFirst[c] == mCardFirst[c + 1]) || !(measureScore(measure, cardinality, c, MIN(c, cardinality)) >= *minTanimoto)) {
+			continue;
+		}
+
+		for (long long i = mCardFirst[c]; i < mCardFirst[c + 1]; i++) {
+			SCANWORD *words = &mWords[i * mWordCount];
+			int common = 0;
+			float score;
+
+			for (int w = 0; w < mWordCount; w++) {
+				common += popcount64(words[w] & queryWords[w]);
+			}
+
+			score = measureScore(measure, cardinality, c, common);
+
+			if (score >= *minTanimoto) {
+				result->addRecord(query, mRecords[i], score, minTanimoto);
+				hits++;
+			}
+		}
+
+		mCntTanimoto += mCardFirst[c + 1] - mCardFirst[c];
+	}
+
+	if (queryWords != stackWords) {
+		delete[] queryWords;
+	}
+
+	return hits;
+}
@@ -0,0 +1,106 @@
+// BruteForce.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef BRUTEFORCE_H
+#define BRUTEFORCE_H
+
+#include "Fingerprint.h"
+#include "QueryResult.h"
+
+typedef unsigned long long SCANWORD;	// 64bit-words of the packed fingerprints
+#define SCAN_WORD_LEN 64		// word-length in bits
+#define SCAN_QUERY_WORDS 64		// query words kept on the stack
+
+// count set bits of a 64bit-word
+inline int popcount64(SCANWORD word) {
+#if defined(__GNUC__) && defined(__POPCNT__)
+	return __builtin_popcountll(word);
+#else
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+	return (int) ((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Objects of class BruteForce compare a query with every fingerprint of
+// a range of an array of Fingerprints. The fingerprints are copied into one
+// contiguous array of 64bit-words in order of their cardinality with their
+// record numbers, so the scan does not need the Fingerprints and a search
+// streams through memory and skips only the cardinalities that cannot reach
+// the Tanimoto coefficient. There is no estimation that may miss a result,
+// so a BruteForce is the reference for the pruning of the MultibitTrees
+// and the XOR-hash. For small sets of fingerprints it is also faster than
+// a tree, as it needs no node arrays.
+class BruteForce {
+	private:
+
+	SCANWORD *mWords;		// packed fingerprints, mWordCount words each
+	int mWordCount;			// number of words of each fingerprint
+	unsigned int *mRecords;		// record number of each fingerprint in the order of mWords
+	long long *mCardFirst;		// first fingerprint of each cardinality
+					// cardinality i are mCardFirst[i] to mCardFirst[i+1]-1
+	int mMinCard;			// minimal cardinality
+	int mMaxCard;			// maximal cardinality
+	long long mSize;		// number of fingerprints
+
+	long long mCntTanimoto;		// statistic counter before tanimoto-check
+
+	public:
+
+	// constructor
+	// copy the fingerprints <leafStart> to <leafEnd>-1 of <prints> with at most <nBits> bits
+	BruteForce(Fingerprint **prints, long long leafStart, long long leafEnd, int nBits);
+
+	// destructor
+	~BruteForce();
+
+	// perform a search for <query> that has <cardinality> filtered by <minTanimoto>
+	// and add the result to <result>, return number of results
+	// if the number of results per query is limited, <minTanimoto> is
+	// raised to the lowest score that can still enter the result
+	long long search(QueryResult *result, Fingerprint *query, int cardinality, float *minTanimoto);
+
+	// count the heap memory of the scan in <report>
+	void getMemory(memoryReportType *report);
+
+	// return number of fingerprints
+	inline long long getSize() {
+		return mSize;
+	}
+
+	// return tanimoto counter
+	inline long long getCntTanimoto() {
+		return mCntTanimoto;
+	}
+
+	// initialize tanimoto counter
+	inline void initCntTanimoto() {
+		mCntTanimoto = 0;
+	}
+};
+#endif
@@ -0,0 +1,757 @@
+// CellStore.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "CellStore.h"
+
+// round <bytes> up to the alignment of the sections
+static inline long long alignSection(long long bytes) {
+	return (bytes + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+}
+
+// get size of a cell file with the counts of <header>
+static long long cellBytes(cellHeaderType *header) {
+	return alignSection(sizeof(cellHeaderType))
+		+ 3 * alignSection(header->nodes * sizeof(long long))
+		+ 2 * alignSection(header->nodes * sizeof(ushort))
+		+ alignSection(header->matchBits * sizeof(ushort))
+		+ alignSection(header->size * sizeof(long long))
+		+ alignSection(header->size * FOLDED_WORDS * sizeof(WORDTYPE))
+		+ alignSection(header->size * header->words * sizeof(WORDTYPE));
+}
+
+// set the section pointers of <cell> to its mapped file
+static void cellLayout(storedCellType *cell) {
+	char *pos = cell->image;
+	cellHeaderType *header = (cellHeaderType *) pos;
+
+	cell->header = header;
+	pos += alignSection(sizeof(cellHeaderType));
+	cell->left = (long long *) pos;
+	pos += alignSection(header->nodes * sizeof(long long));
+	cell->right = (long long *) pos;
+	pos += alignSection(header->nodes * sizeof(long long));
+	cell->matchStart = (long long *) pos;
+	pos += alignSection(header->nodes * sizeof(long long));
+	cell->sizes = (ushort *) pos;
+	pos += alignSection(header->nodes * sizeof(ushort));
+	cell->zeros = (ushort *) pos;
+	pos += alignSection(header->nodes * sizeof(ushort));
+	cell->matchBits = (ushort *) pos;
+	pos += alignSection(header->matchBits * sizeof(ushort));
+	cell->records = (long long *) pos;
+	pos += alignSection(header->size * sizeof(long long));
+	cell->hashes = (WORDTYPE *) pos;
+	pos += alignSection(header->size * FOLDED_WORDS * sizeof(WORDTYPE));
+	cell->words = (WORDTYPE *) pos;
+}
+
+// pad a section of <bytes> in <out> to the alignment of the sections
+// return 1 on success
+static int writePadding(FILE *out, long long bytes) {
+	static const char padding[STORE_ALIGN] = {0};
+	long long pad = alignSection(bytes) - bytes;
+
+	return (pad == 0) || (fwrite(padding, 1, pad, out) == (size_t) pad);
+}
+
+// write a section of <bytes> of <data> to <out>
+// return 1 on success
+static int writeSection(FILE *out, const void *data, long long bytes) {
+	if ((bytes > 0) && (fwrite(data, 1, bytes, out) != (size_t) bytes)) {
+		return 0;
+	}
+
+	return writePadding(out, bytes);
+}
+
+// write <bytes> of <data> at <offset> of file <fd>
+// return 1 on success
+static int writeAt(int fd, const void *data, long long bytes, long long offset) {
+	while (bytes > 0) {
+		ssize_t written = pwrite(fd, data, bytes, offset);
+
+		if (written <= 0) {
+			return 0;
+		}
+		data = (const char *) data + written;
+		bytes -= written;
+		offset += written;
+	}
+
+	return 1;
+}
+
+// read <bytes> at <offset> of file <fd> into <data>
+// return 1 on success
+static int readAt(int fd, void *data, long long bytes, long long offset) {
+	while (bytes > 0) {
+		ssize_t count = pread(fd, data, bytes, offset);
+
+		if (count <= 0) {
+			return 0;
+		}
+		data = (char *) data + count;
+		bytes -= count;
+		offset += count;
+	}
+
+	return 1;
+}
+
+// constructor
+// create a store in a new directory below <dir>
+// that keeps at most <residentLimit> bytes of cell files mapped
+CellStore::CellStore(const char *dir, long long residentLimit) {
+	mDir = new char[strlen(dir) + 21];
+	sprintf(mDir, "%s/multibitTree-XXXXXX", dir);
+
+	if (mkdtemp(mDir) == NULL) {
+		delete[] mDir;
+		mDir = NULL;
+	}
+
+	mNCells = 0;
+	mCells = NULL;
+	mResidentLimit = residentLimit;
+	mResident = 0;
+	mFirst = -1;
+	mLast = -1;
+	mMaps = 0;
+	mFailures = 0;
+	mPartition = -1;
+	mPartitionBits = 0;
+	mPartitionWords = 0;
+	mSlotBytes = 0;
+	mPartitionStart = NULL;
+	mPartitionNext = NULL;
+	mCountCapacity = 0;
+	mCntXOR = 0;
+	mCntTanimoto = 0;
+
+	pthread_mutex_init(&mMutex, NULL);
+}
+
+// destructor
+// unmap and remove all cell files and their directory
+CellStore::~CellStore() {
+	closePartition();
+
+	for (int i = 0; i < mNCells; i++) {
+		if (mCells[i].image != NULL) {
+			munmap(mCells[i].image, mCells[i].bytes);
+		}
+
+		if (mCells[i].stored) {
+			char path[strlen(mDir) + 32];
+
+			cellPath(i, path, sizeof(path));
+			unlink(path);
+		}
+	}
+
+	if (mDir != NULL) {
+		rmdir(mDir);
+		delete[] mDir;
+	}
+
+	if (mCells != NULL) {
+		delete[] mCells;
+	}
+
+	pthread_mutex_destroy(&mMutex);
+}
+
+// set number of cells, called by the grid before writing cells
+// the cells written so far are kept
+void CellStore::setCells(int cells) {
+	storedCellType *old = mCells;
+
+	mCells = new storedCellType[cells];
+
+	if (old != NULL) {
+		memcpy(mCells, old, mNCells * sizeof(storedCellType));
+		delete[] old;
+	}
+
+	for (int i = mNCells; i < cells; i++) {
+		mCells[i].stored = 0;
+		mCells[i].image = NULL;
+		mCells[i].bytes = 0;
+		mCells[i].pins = 0;
+		mCells[i].prev = -1;
+		mCells[i].next = -1;
+	}
+
+	mNCells = cells;
+}
+
+// write the path of the file of <cell> to <path>
+void CellStore::cellPath(int cell, char *path, size_t length) {
+	snprintf(path, length, "%s/cell%d", mDir, cell);
+}
+
+// write the path of the partition file to <path>
+void CellStore::partitionPath(char *path, size_t length) {
+	snprintf(path, length, "%s/partition", mDir);
+}
+
+// count <print> for the partition, all prints are counted before
+// the partition file is opened
+void CellStore::countPrint(Fingerprint *print) {
+	// the cardinality is at most the length
+	if (print->getLength() >= mCountCapacity) {
+		int capacity = MAX(2 * mCountCapacity, print->getLength() + 1);
+		long long *counts = new long long[capacity];
+
+		for (int c = 0; c < capacity; c++) {
+			counts[c] = (c < mCountCapacity) ? mPartitionNext[c] : 0;
+		}
+		if (mPartitionNext != NULL) {
+			delete[] mPartitionNext;
+		}
+		mPartitionNext = counts;
+		mCountCapacity = capacity;
+	}
+
+	mPartitionNext[print->cardinality()]++;
+	mPartitionBits = MAX(mPartitionBits, print->getLength());
+}
+
+// create the partition file for the counted prints, return 1 on success
+// each cardinality gets a range of slots, which are written in any order
+int CellStore::openPartition() {
+	if (mDir == NULL) {
+		return 0;
+	}
+
+	char path[strlen(mDir) + 32];
+
+	// without prints there is only the cardinality 0
+	if (mPartitionNext == NULL) {
+		mPartitionNext = new long long[1];
+		mPartitionNext[0] = 0;
+		mCountCapacity = 1;
+	}
+
+	mPartitionWords = (MAX(mPartitionBits, 128) - 1) / WORD_LEN + 1;
+	mSlotBytes = alignSection(sizeof(partitionSlotType) + mPartitionWords * sizeof(WORDTYPE));
+	mPartitionStart = new long long[mPartitionBits + 2];
+
+	mPartitionStart[0] = 0;
+	for (int c = 0; c <= mPartitionBits; c++) {
+		mPartitionStart[c + 1] = mPartitionStart[c] + mPartitionNext[c];
+		mPartitionNext[c] = mPartitionStart[c];
+	}
+
+	partitionPath(path, sizeof(path));
+	mPartition = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+	return mPartition >= 0;
+}
+
+// write <print> with its record number and block to the next free slot
+// of its cardinality, return 1 on success
+int CellStore::partitionPrint(Fingerprint *print) {
+	char slot[mSlotBytes];
+	partitionSlotType *header = (partitionSlotType *) slot;
+	WORDTYPE *words = (WORDTYPE *) (slot + sizeof(partitionSlotType));
+	int card = print->cardinality();
+
+	if ((card > mPartitionBits) || (mPartitionNext[card] == mPartitionStart[card + 1])) {
+		return 0;
+	}
+
+	memset(slot, 0, mSlotBytes);
+	header->record = print->getIndex();
+	header->block = print->getBlock();
+	header->cardinality = card;
+
+	for (int w = 0; w < mPartitionWords; w++) {
+		words[w] = print->getWord(w);
+	}
+
+	return writeAt(mPartition, slot, mSlotBytes, mPartitionNext[card]++ * mSlotBytes);
+}
+
+// set <print> to the partition slot at <slot>
+void CellStore::slotPrint(const char *slot, Fingerprint *print) {
+	const partitionSlotType *header = (const partitionSlotType *) slot;
+
+	print->setIndex(header->record);
+	print->setBlock(header->block);
+	print->setWords((const WORDTYPE *) (slot + sizeof(partitionSlotType)), mPartitionWords);
+}
+
+// read the prints of cardinality <card> into new Fingerprints at <prints>
+// return number of prints, less than getPartitionCount() if the file cannot be read
+// the slots are read in chunks of PARTITION_CHUNK
+long long CellStore::readPartition(int card, Fingerprint **prints) {
+	char *buffer = new char[PARTITION_CHUNK * mSlotBytes];
+	long long size = 0;
+
+	for (long long first = mPartitionStart[card]; first < mPartitionStart[card + 1]; first += PARTITION_CHUNK) {
+		long long count = MIN((long long) PARTITION_CHUNK, mPartitionStart[card + 1] - first);
+
+		if (!readAt(mPartition, buffer, count * mSlotBytes, first * mSlotBytes)) {
+			__sync_fetch_and_add(&mFailures, 1);
+			break;
+		}
+
+		for (long long i = 0; i < count; i++) {
+			prints[size] = new Fingerprint(mPartitionWords * WORD_LEN);
+			slotPrint(&buffer[i * mSlotBytes], prints[size]);
+			size++;
+		}
+	}
+
+	delete[] buffer;
+
+	return size;
+}
+
+// read a sample of at most <maxSize> prints of the largest cardinalities
+// into new Fingerprints at <prints>, like the sample of a Tuner
+// the largest cardinalities are taken as long as they fit, but at least one,
+// and their prints are thinned out evenly; return number of prints
+long long CellStore::samplePartition(Fingerprint **prints, long long maxSize) {
+	int taken[mPartitionBits + 1];		// flag if a cardinality is sampled
+	char slot[mSlotBytes];
+	long long total = 0;			// number of prints of the sampled cardinalities
+	long long seen = 0;			// number of prints of sampled cardinalities seen so far
+	long long sampleSize;
+	long long j = 0;
+
+	for (int c = 0; c <= mPartitionBits; c++) {
+		taken[c] = 0;
+	}
+
+	while (1) {
+		int largest = -1;
+
+		for (int c = 0; c <= mPartitionBits; c++) {
+			if (!taken[c] && (getPartitionCount(c) > 0) && ((largest < 0) || (getPartitionCount(c) > getPartitionCount(largest)))) {
+				largest = c;
+			}
+		}
+
+		if ((largest < 0) || ((total > 0) && (total + getPartitionCount(largest) > maxSize))) {
+			break;
+		}
+
+		taken[largest] = 1;
+		total += getPartitionCount(largest);
+	}
+
+	sampleSize = MIN(total, maxSize);
+
+	for (int c = 0; c <= mPartitionBits; c++) {
+		for (long long i = mPartitionStart[c]; taken[c] && (i < mPartitionStart[c + 1]); i++) {
+			if (seen * sampleSize / total == j) {
+				if (!readAt(mPartition, slot, mSlotBytes, i * mSlotBytes)) {
+					__sync_fetch_and_add(&mFailures, 1);
+					return j;
+				}
+				prints[j] = new Fingerprint(mPartitionWords * WORD_LEN);
+				slotPrint(slot, prints[j]);
+				j++;
+			}
+			seen++;
+		}
+	}
+
+	return j;
+}
+
+// remove the partition file
+void CellStore::closePartition() {
+	if (mPartition >= 0) {
+		char path[strlen(mDir) + 32];
+
+		close(mPartition);
+		partitionPath(path, sizeof(path));
+		unlink(path);
+		mPartition = -1;
+	}
+
+	if (mPartitionStart != NULL) {
+		delete[] mPartitionStart;
+		mPartitionStart = NULL;
+	}
+
+	if (mPartitionNext != NULL) {
+		delete[] mPartitionNext;
+		mPartitionNext = NULL;
+		mCountCapacity = 0;
+	}
+}
+
+// write <cell> with the <size> prints of <prints> starting at <start>
+// that have <cardinality> and at most <nBits> bits
+// if <tree> is given, it must have been built from these prints,
+// otherwise the cell is written as a single leaf
+// return 1 if the cell was written, 0 if it must be kept in memory
+int CellStore::write(int cell, MultibitTree *tree, Fingerprint **prints, long long start, long long size, int cardinality, int nBits) {
+	cellHeaderType header;
+	long long *left, *right, *matchStart, *records;
+	ushort *sizes, *zeros, *matchBits;
+	WORDTYPE *words;
+	FILE *out;
+	int ok;
+
+	if (mDir == NULL) {
+		return 0;
+	}
+
+	char path[strlen(mDir) + 32];
+
+	header.size = size;
+	header.nodes = (tree != NULL) ? tree->mNodes : 1;
+	header.matchBits = 0;
+	header.words = (MAX(nBits, 128) - 1) / WORD_LEN + 1;
+	header.cardinality = cardinality;
+
+	// copy the node arrays, leaves refer to the prints of the cell
+	left = new long long[header.nodes];
+	right = new long long[header.nodes];
+	matchStart = new long long[header.nodes];
+	sizes = new ushort[header.nodes];
+	zeros = new ushort[header.nodes];
+
+	if (tree == NULL) {
+		left[0] = 0;
+		right[0] = size;
+		matchStart[0] = 0;
+		sizes[0] = LEAF_BIT;
+		zeros[0] = 0;
+	} else {
+		for (long long i = 0; i < header.nodes; i++) {
+			sizes[i] = tree->mMatchBitsSize[i];
+			zeros[i] = tree->mMatchBitsZerosSize[i];
+			matchStart[i] = header.matchBits;
+			header.matchBits += sizes[i] & BIT_MASK;
+
+			if (sizes[i] & LEAF_BIT) {
+				left[i] = tree->mLeftChild[i] - start;
+				right[i] = tree->mRightChild[i] - start;
+			} else {
+				left[i] = tree->mLeftChild[i];
+				right[i] = tree->mRightChild[i];
+			}
+		}
+	}
+
+	// concatenate the match bits of the inner nodes
+	matchBits = new ushort[MAX(header.matchBits, 1)];
+
+	for (long long i = 0; i < header.nodes; i++) {
+		for (int j = 0; j < (sizes[i] & BIT_MASK); j++) {
+			matchBits[matchStart[i] + j] = tree->mMatchBits[i][j];
+		}
+	}
+
+	// record numbers, hash-keys and bit-vectors in the order of the leaves,
+	// hash-keys and bit-vectors are streamed
+	records = new long long[size];
+	words = new WORDTYPE[header.words];
+
+	for (long long i = 0; i < size; i++) {
+		records[i] = prints[start + i]->getIndex();
+	}
+
+	cellPath(cell, path, sizeof(path));
+	out = fopen(path, "wb");
+
+	ok = (out != NULL)
+		&& writeSection(out, &header, sizeof(cellHeaderType))
+		&& writeSection(out, left, header.nodes * sizeof(long long))
+		&& writeSection(out, right, header.nodes * sizeof(long long))
+		&& writeSection(out, matchStart, header.nodes * sizeof(long long))
+		&& writeSection(out, sizes, header.nodes * sizeof(ushort))
+		&& writeSection(out, zeros, header.nodes * sizeof(ushort))
+		&& writeSection(out, matchBits, header.matchBits * sizeof(ushort))
+		&& writeSection(out, records, size * sizeof(long long));
+
+	for (long long i = 0; ok && (i < size); i++) {
+		ok = (fwrite(prints[start + i]->getHash(), sizeof(WORDTYPE), FOLDED_WORDS, out) == FOLDED_WORDS);
+	}
+
+	ok = ok && writePadding(out, size * FOLDED_WORDS * sizeof(WORDTYPE));
+
+	for (long long i = 0; ok && (i < size); i++) {
+		for (int w = 0; w < header.words; w++) {
+			words[w] = prints[start + i]->getWord(w);
+		}
+		ok = (fwrite(words, sizeof(WORDTYPE), header.words, out) == (size_t) header.words);
+	}
+
+	ok = ok && writePadding(out, size * header.words * sizeof(WORDTYPE));
+
+	delete[] left;
+	delete[] right;
+	delete[] matchStart;
+	delete[] sizes;
+	delete[] zeros;
+	delete[] matchBits;
+	delete[] records;
+	delete[] words;
+
+	if (out != NULL) {
+		ok = (fclose(out) == 0) && ok;
+	}
+
+	if (!ok) {
+		unlink(path);
+		return 0;
+	}
+
+	mCells[cell].stored = 1;
+	mCells[cell].bytes = cellBytes(&header);
+
+	return 1;
+}
+
+// map the file of <cell> and pin it for a search, return NULL if it cannot be mapped
+// the mapping is cheap, the pages are read when the search touches them
+storedCellType *CellStore::acquire(int cell) {
+	storedCellType *stored = &mCells[cell];
+
+	pthread_mutex_lock(&mMutex);
+
+	if (stored->image == NULL) {
+		char path[strlen(mDir) + 32];
+		void *image;
+		int fd;
+
+		evict(stored->bytes);
+
+		cellPath(cell, path, sizeof(path));
+		fd = open(path, O_RDONLY);
+		image = (fd >= 0) ? mmap(NULL, stored->bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+
+		if (fd >= 0) {
+			close(fd);
+		}
+
+		if (image == MAP_FAILED) {
+			pthread_mutex_unlock(&mMutex);
+			return NULL;
+		}
+
+		// start reading the whole cell, a search visits most of its pages
+		madvise(image, stored->bytes, MADV_WILLNEED);
+
+		stored->image = (char *) image;
+		cellLayout(stored);
+		mResident += stored->bytes;
+		mMaps++;
+	} else {
+		// remove from its position in the list
+		if (stored->prev >= 0) {
+			mCells[stored->prev].next = stored->next;
+		} else {
+			mFirst = stored->next;
+		}
+		if (stored->next >= 0) {
+			mCells[stored->next].prev = stored->prev;
+		} else {
+			mLast = stored->prev;
+		}
+	}
+
+	// insert as most recently used cell
+	stored->prev = -1;
+	stored->next = mFirst;
+	if (mFirst >= 0) {
+		mCells[mFirst].prev = cell;
+	} else {
+		mLast = cell;
+	}
+	mFirst = cell;
+
+	stored->pins++;
+
+	pthread_mutex_unlock(&mMutex);
+
+	return stored;
+}
+
+// unpin <cell> after a search
+void CellStore::release(int cell) {
+	pthread_mutex_lock(&mMutex);
+	mCells[cell].pins--;
+	pthread_mutex_unlock(&mMutex);
+}
+
+// unmap least recently used cells that are not pinned until
+// <bytes> more fit into the resident limit
+// must be called with the mutex locked
+void CellStore::evict(long long bytes) {
+	int cell = mLast;
+
+	while ((cell >= 0) && (mResident + bytes > mResidentLimit)) {
+		int prev = mCells[cell].prev;
+
+		if (mCells[cell].pins == 0) {
+			unmap(cell);
+		}
+		cell = prev;
+	}
+}
+
+// unmap <cell> and remove it from the list of mapped cells
+// must be called with the mutex locked
+void CellStore::unmap(int cell) {
+	storedCellType *stored = &mCells[cell];
+
+	munmap(stored->image, stored->bytes);
+	stored->image = NULL;
+	mResident -= stored->bytes;
+
+	if (stored->prev >= 0) {
+		mCells[stored->prev].next = stored->next;
+	} else {
+		mFirst = stored->next;
+	}
+	if (stored->next >= 0) {
+		mCells[stored->next].prev = stored->prev;
+	} else {
+		mLast = stored->prev;
+	}
+
+	stored->prev = -1;
+	stored->next = -1;
+}
+
+// perform a search for <query> that has <cardinality> filtered by <minTanimoto>
+// in the file of <cell> and add the result to <result>, return number of results
+long long CellStore::search(int cell, QueryResult *result, Fingerprint *query, int cardinality, float *minTanimoto) {
+	storedCellType *stored = acquire(cell);
+	long long cntXOR = 0;
+	long long cntTanimoto = 0;
+	long long hits;
+	scoreFilterType filter;
+
+	if (stored == NULL) {
+		__sync_fetch_and_add(&mFailures, 1);
+		return 0;
+	}
+
+	filterInit(&filter, result->getMeasure(), cardinality, stored->header->cardinality, minTanimoto);
+	hits = searchNode(stored, result, query, 0, 0, cardinality + stored->header->cardinality, cardinality, stored->header->cardinality, &filter, &cntXOR, &cntTanimoto);
+
+	release(cell);
+
+	// update statistics, other threads may search concurrently
+	__sync_fetch_and_add(&mCntXOR, cntXOR);
+	__sync_fetch_and_add(&mCntTanimoto, cntTanimoto);
+
+	return hits;
+}
+
+// recursively search the sub tree of <node> in the mapped <cell> like MultibitTree::internalSearch
+// return number of results
+long long CellStore::searchNode(storedCellType *cell, QueryResult *result, Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatched, scoreFilterType *filter, long long *cntXOR, long long *cntTanimoto) {
+	int size = cell->sizes[node];
+	long long hits = 0;
+
+	if (size & LEAF_BIT) {
+		int words = cell->header->words;
+
+		// check each leaf print's XOR-hash estimation and tanimoto coefficient
+		for (long long i = cell->left[node]; i < cell->right[node]; i++) {
+			(*cntXOR)++;
+
+			if (queryPrint->tanimotoXOR(&cell->hashes[i * FOLDED_WORDS], AB) >= filterTanimoto(filter)) {
+				float score;
+
+				(*cntTanimoto)++;
+				score = filterScoreTanimoto(filter, queryPrint->tanimoto(&cell->words[i * words], words));
+
+				if (score >= *filter->minScore) {
+					result->addRecord(queryPrint, (unsigned int) cell->records[i], score, filter->minScore);
+					hits++;
+				}
+			}
+		}
+	} else {
+		// estimate the minimal tanimoto coefficient by the match bits
+		ushort *matchBitIdx = &cell->matchBits[cell->matchStart[node]];
+		int sizeZeros = cell->zeros[node];
+		int countOnes = 0;
+		int countZeros = 0;
+
+		for (int i = 0; i < sizeZeros; i++) {
+			countOnes += queryPrint->getBit(matchBitIdx[i]);
+		}
+
+		for (int i = sizeZeros; i < size; i++) {
+			countZeros += queryPrint->getBit(matchBitIdx[i]) ^ 1;
+		}
+
+		commonXOR += countZeros + countOnes;
+		queryUnmatched -= countOnes;
+		treeUnmatched -= countZeros;
+
+		if (((float) MIN(queryUnmatched, treeUnmatched)) / (commonXOR + MAX(queryUnmatched, treeUnmatched)) >= filterTanimoto(filter)) {
+			hits += searchNode(cell, result, queryPrint, cell->left[node], commonXOR, AB, queryUnmatched, treeUnmatched, filter, cntXOR, cntTanimoto);
+			hits += searchNode(cell, result, queryPrint, cell->right[node], commonXOR, AB, queryUnmatched, treeUnmatched, filter, cntXOR, cntTanimoto);
+		}
+	}
+
+	return hits;
+}
+
+// count the heap memory of the store and its mapped cell files in <report>
+// the mapped files are counted with their pages
+void CellStore::getMemory(memoryReportType *report) {
+	long long page = sysconf(_SC_PAGESIZE);
+
+	memoryAdd(report, MEMORY_GRID, this, sizeof(CellStore));
+	if (mCells != NULL) {
+		memoryAdd(report, MEMORY_GRID, mCells, mNCells * sizeof(storedCellType));
+	}
+	if (mDir != NULL) {
+		memoryAdd(report, MEMORY_GRID, mDir, strlen(mDir) + 1);
+	}
+	memoryAdd(report, MEMORY_GRID, mPartitionStart, (mPartitionBits + 2) * sizeof(long long));
+	memoryAdd(report, MEMORY_GRID, mPartitionNext, mCountCapacity * sizeof(long long));
+
+	pthread_mutex_lock(&mMutex);
+
+	for (int i = mFirst; i >= 0; i = mCells[i].next) {
+		report->bytes[MEMORY_MAPPED] += mCells[i].bytes;
+		report->overhead[MEMORY_MAPPED] += (mCells[i].bytes + page - 1) / page * page - mCells[i].bytes;
+		report->allocations[MEMORY_MAPPED]++;
+	}
+
+	pthread_mutex_unlock(&mMutex);
+}
@@ -0,0 +1,254 @@
+// CellStore.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef CELLSTORE_H
+#define CELLSTORE_H
+
+#include <pthread.h>
+#include "Fingerprint.h"
+#include "MultibitTree.h"
+#include "QueryResult.h"
+#include "Memory.h"
+
+#define STORE_ALIGN 8			// alignment of the sections of a cell file
+#define PARTITION_CHUNK 4096		// slots read from the partition file at a time
+
+// Instances of cellHeaderType start each cell file.
+typedef struct cellHeaderStruct {
+	long long size;			// number of prints
+	long long nodes;		// number of tree nodes
+	long long matchBits;		// total number of match bits of all nodes
+	int words;			// 32bit-words of each print
+	int cardinality;		// common cardinality of the prints
+} cellHeaderType;
+
+// Instances of partitionSlotType start each slot of the partition file,
+// the bit-vector of the print follows.
+typedef struct partitionSlotStruct {
+	long long record;		// record number of the print
+	int block;			// number of the blocking key
+	int cardinality;		// cardinality of the print
+} partitionSlotType;
+
+// Instances of storedCellType hold the state of one cell of a CellStore.
+// While the cell file is mapped, the pointers refer to its sections.
+typedef struct storedCellStruct {
+	int stored;			// flag if the cell was written to its file
+	char *image;			// mapped cell file, NULL if it is not resident
+	long long bytes;		// size of the cell file
+	int pins;			// number of searches that use the mapping
+	int prev;			// more recently used mapped cell, -1 for the first
+	int next;			// less recently used mapped cell, -1 for the last
+	cellHeaderType *header;		// header of the mapped file
+	long long *left;		// left child of each inner node, first leaf of each leaf node
+	long long *right;		// right child of each inner node, end of the leaves of each leaf node
+	long long *matchStart;		// first match bit of each node
+	ushort *sizes;			// number of match bits of each node, LEAF_BIT for leaves
+	ushort *zeros;			// number of zero match bits of each node
+	ushort *matchBits;		// match bits of all nodes
+	long long *records;		// record number of each leaf print
+	WORDTYPE *hashes;		// folded hash-key of each leaf print
+	WORDTYPE *words;		// bit-vector of each leaf print
+} storedCellType;
+
+// Objects of class CellStore keep the cells of a Grid1D out of core.
+// Each cell is written to its own file: the node arrays and match bits
+// of its MultibitTree, followed by the record numbers, hash-keys and
+// bit-vectors of its prints in the order of the tree's leaves. A cell
+// that is scanned is written as a tree with a single leaf.
+//
+// A search maps the cell file on demand and searches the mapped arrays
+// like a MultibitTree. Mapped cells are kept in a list in the order of
+// their last use. When the mapped files exceed the resident limit, the
+// least recently used cells that are not searched are unmapped, so the
+// operating system can reclaim their pages.
+//
+// Before a grid is built, the loaded prints are written to a partition file
+// of fixed-size slots that are grouped by cardinality. The grid reads the
+// prints of a few cardinalities at a time, builds and writes their cells and
+// deletes them before it reads the next, so the prints are never all in memory.
+//
+// The files are created in a new directory below the given directory
+// and are removed with the store. They are only valid for this process.
+class CellStore {
+	private:
+
+	char *mDir;			// directory of the cell files, NULL if it cannot be created
+	storedCellType *mCells;		// state of each cell
+	int mNCells;			// number of cells
+	long long mResidentLimit;	// maximal size of the mapped cell files
+	long long mResident;		// size of the mapped cell files
+	int mFirst;			// most recently used mapped cell, -1 if none
+	int mLast;			// least recently used mapped cell, -1 if none
+	long long mMaps;		// number of cell files mapped so far
+	long long mFailures;		// number of searches in cells that could not be mapped
+					// and of failed reads of the partition file
+	int mPartition;			// descriptor of the partition file, -1 if it is not open
+	int mPartitionBits;		// maximal size of the partitioned prints
+	int mPartitionWords;		// 32bit-words of each partitioned print
+	long long mSlotBytes;		// size of a slot of the partition file
+	long long *mPartitionStart;	// first slot of each cardinality, mPartitionBits+2 entries
+	long long *mPartitionNext;	// next free slot of each cardinality,
+					// the number of prints while they are counted
+	int mCountCapacity;		// allocated size of mPartitionNext
+	pthread_mutex_t mMutex;		// mutex for the mapping and the list of mapped cells
+
+	long long mCntXOR;		// statistic counter before XOR-check
+	long long mCntTanimoto;		// statistic counter before tanimoto-check
+
+	// write the path of the file of <cell> to <path>
+	void cellPath(int cell, char *path, size_t length);
+
+	// write the path of the partition file to <path>
+	void partitionPath(char *path, size_t length);
+
+	// set <print> to the partition slot at <slot>
+	void slotPrint(const char *slot, Fingerprint *print);
+
+	// map the file of <cell> and pin it for a search, return NULL if it cannot be mapped
+	storedCellType *acquire(int cell);
+
+	// unpin <cell> after a search
+	void release(int cell);
+
+	// unmap least recently used cells that are not pinned until
+	// <bytes> more fit into the resident limit
+	// must be called with the mutex locked
+	void evict(long long bytes);
+
+	// unmap <cell> and remove it from the list of mapped cells
+	// must be called with the mutex locked
+	void unmap(int cell);
+
+	// recursively search the sub tree of <node> in the mapped <cell> like MultibitTree::internalSearch
+	long long searchNode(storedCellType *cell, QueryResult *result, Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatched, scoreFilterType *filter, long long *cntXOR, long long *cntTanimoto);
+
+	public:
+
+	// constructor
+	// create a store in a new directory below <dir>
+	// that keeps at most <residentLimit> bytes of cell files mapped
+	CellStore(const char *dir, long long residentLimit);
+
+	// destructor
+	// unmap and remove all cell files and their directory
+	~CellStore();
+
+	// check if the directory of the cell files was created
+	inline int isOpen() {
+		return mDir != NULL;
+	}
+
+	// get maximal size of the mapped cell files
+	inline long long getResidentLimit() {
+		return mResidentLimit;
+	}
+
+	// count <print> for the partition, all prints are counted before
+	// the partition file is opened
+	void countPrint(Fingerprint *print);
+
+	// create the partition file for the counted prints, return 1 on success
+	int openPartition();
+
+	// write <print> with its record number and block to the next free slot
+	// of its cardinality, return 1 on success
+	int partitionPrint(Fingerprint *print);
+
+	// get maximal size of the partitioned prints
+	inline int getPartitionBits() {
+		return mPartitionBits;
+	}
+
+	// get number of partitioned prints of cardinality <card>
+	inline long long getPartitionCount(int card) {
+		return mPartitionStart[card + 1] - mPartitionStart[card];
+	}
+
+	// read the prints of cardinality <card> into new Fingerprints at <prints>
+	// return number of prints, less than getPartitionCount() if the file cannot be read
+	long long readPartition(int card, Fingerprint **prints);
+
+	// read a sample of at most <maxSize> prints of the largest cardinalities
+	// into new Fingerprints at <prints>, like the sample of a Tuner
+	// return number of prints
+	long long samplePartition(Fingerprint **prints, long long maxSize);
+
+	// remove the partition file
+	void closePartition();
+
+	// set number of cells, called by the grid before writing cells
+	// the cells written so far are kept
+	void setCells(int cells);
+
+	// write <cell> with the <size> prints of <prints> starting at <start>
+	// that have <cardinality> and at most <nBits> bits
+	// if <tree> is given, it must have been built from these prints,
+	// otherwise the cell is written as a single leaf
+	// return 1 if the cell was written, 0 if it must be kept in memory
+	int write(int cell, MultibitTree *tree, Fingerprint **prints, long long start, long long size, int cardinality, int nBits);
+
+	// check if <cell> was written to its file
+	inline int isStored(int cell) {
+		return mCells[cell].stored;
+	}
+
+	// perform a search for <query> that has <cardinality> filtered by <minTanimoto>
+	// in the file of <cell> and add the result to <result>, return number of results
+	long long search(int cell, QueryResult *result, Fingerprint *query, int cardinality, float *minTanimoto);
+
+	// count the heap memory of the store and its mapped cell files in <report>
+	void getMemory(memoryReportType *report);
+
+	// return number of cell files mapped so far
+	inline long long getMaps() {
+		return mMaps;
+	}
+
+	// return number of searches in cells that could not be mapped
+	// and of failed reads of the partition file while the grid was built
+	// these cells were not searched, the prints that were not read are missing
+	inline long long getFailures() {
+		return mFailures;
+	}
+
+	// return XOR counter
+	inline long long getCntXOR() {
+		return mCntXOR;
+	}
+
+	// return tanimoto counter
+	inline long long getCntTanimoto() {
+		return mCntTanimoto;
+	}
+
+	// initialize counters
+	inline void initStatistics() {
+		mCntXOR = 0;
+		mCntTanimoto = 0;
+	}
+};
+#endif
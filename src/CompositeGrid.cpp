@@ -0,0 +1,360 @@
+// CompositeGrid.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <math.h>
+#include "CompositeGrid.h"
+#include "Parser.h"
+
+// the cardinality range of the first field is widened by this margin,
+// so records with rounding errors in their score are not lost
+#define SCORE_MARGIN 1e-4f
+
+// Instances of recordKeyType are used to sort the records
+// by the cardinalities of their fields.
+typedef struct recordKeyStruct {
+	unsigned long long key;		// field cardinalities, 16 bits each, first field highest
+	long long record;		// record number
+} recordKeyType;
+
+// compare function for sorting recordKeyType with qsort
+static int compareRecordKeys(const void *a, const void *b) {
+	const recordKeyType *keyA = (const recordKeyType*) a;
+	const recordKeyType *keyB = (const recordKeyType*) b;
+
+	if (keyA->key != keyB->key) {
+		return (keyA->key > keyB->key) ? 1 : -1;
+	}
+
+	return (keyA->record > keyB->record) - (keyA->record < keyB->record);
+}
+
+// constructor:
+//
+// create a grid with its own ThreadPool
+// the grid takes ownership of the arrays of <fields> and all their Fingerprints
+//
+// fields	: one array of <size> Fingerprints for each field, the first holds the ids
+// nFields	: number of fields (1 to MAX_FIELDS)
+// size		: number of records
+// nBits	: maximal size of the Fingerprints of each field
+// weights	: weight of each field, NULL for equal weights
+// threads	: number of parallel threads passed to ThreadPool
+CompositeGrid::CompositeGrid(Fingerprint ***fields, int nFields, long long size, int *nBits, const double *weights, int threads) {
+	mWorkerPool = new ThreadPool(threads, 0);
+	mOwnPool = 1;
+	mFields = nFields;
+	mSize = size;
+	mSizeLastSearch = 0;
+	initStatistics();
+
+	build(fields, nBits, weights);
+}
+
+// constructor:
+//
+// create a grid that uses the ThreadPool <pool>, which has to outlive the grid
+// the other parameters are those of the first constructor
+CompositeGrid::CompositeGrid(Fingerprint ***fields, int nFields, long long size, int *nBits, const double *weights, ThreadPool *pool) {
+	mWorkerPool = pool;
+	mOwnPool = 0;
+	mFields = nFields;
+	mSize = size;
+	mSizeLastSearch = 0;
+	initStatistics();
+
+	build(fields, nBits, weights);
+}
+
+// sort the records into cells by the cardinalities of their fields,
+// pack the fields in cell order and release the bit-vectors
+void CompositeGrid::build(Fingerprint ***fields, int *nBits, const double *weights) {
+	recordKeyType *keys = new recordKeyType[mSize];
+	double sum = 0;
+	int cellCapacity;
+
+	// normalize the weights
+	for (int f = 0; f < mFields; f++) {
+		sum += (weights != NULL) ? weights[f] : 1;
+	}
+	for (int f = 0; f < mFields; f++) {
+		mWeights[f] = (float) (((weights != NULL) ? weights[f] : 1) / sum);
+	}
+
+	// lay out the fields of a packed record
+	mWordCount = 0;
+	for (int f = 0; f < mFields; f++) {
+		mFieldOffset[f] = mWordCount;
+		mFieldWords[f] = (MAX(nBits[f], 1) - 1) / SCAN_WORD_LEN + 1;
+		mWordCount += mFieldWords[f];
+	}
+	mNBits = nBits[0];
+
+	// sort records by the cardinalities of their fields
+	for (long long i = 0; i < mSize; i++) {
+		keys[i].key = 0;
+		for (int f = 0; f < mFields; f++) {
+			keys[i].key = (keys[i].key << 16) | fields[f][i]->cardinality();
+		}
+		keys[i].record = i;
+	}
+
+	qsort(keys, mSize, sizeof(recordKeyType), compareRecordKeys);
+
+	// find cells as runs of equal keys and pack the records
+	cellCapacity = mNBits + 1;
+	mCellStart = new long long[cellCapacity + 1];
+	mCellCards = new int[cellCapacity * mFields];
+	mCellFirst = new int[mNBits + 2];
+	mWords = new SCANWORD[mSize * mWordCount];
+	mNumbers = new unsigned int[mSize];
+	mNCells = 0;
+
+	for (int i = 0; i < (mNBits + 2); i++) {
+		mCellFirst[i] = -1;
+	}
+
+	for (long long i = 0; i < mSize; i++) {
+		long long record = keys[i].record;
+		SCANWORD *words = &mWords[i * mWordCount];
+
+		if ((i == 0) || (keys[i].key != keys[i - 1].key)) {
+			// grow cell arrays
+			if (mNCells == cellCapacity) {
+				long long *newStart = new long long[2 * cellCapacity + 1];
+				int *newCards = new int[2 * cellCapacity * mFields];
+
+				memcpy(newStart, mCellStart, cellCapacity * sizeof(long long));
+				memcpy(newCards, mCellCards, cellCapacity * mFields * sizeof(int));
+				delete[] mCellStart;
+				delete[] mCellCards;
+				mCellStart = newStart;
+				mCellCards = newCards;
+				cellCapacity *= 2;
+			}
+
+			// start new cell
+			mCellStart[mNCells] = i;
+			for (int f = 0; f < mFields; f++) {
+				mCellCards[mNCells * mFields + f] = fields[f][record]->cardinality();
+			}
+			if (mCellFirst[mCellCards[mNCells * mFields]] < 0) {
+				mCellFirst[mCellCards[mNCells * mFields]] = mNCells;
+			}
+			mNCells++;
+		}
+
+		mNumbers[i] = (unsigned int) record;
+
+		for (int f = 0; f < mFields; f++) {
+			Fingerprint *print = fields[f][record];
+
+			for (int w = 0; w < mFieldWords[f]; w++) {
+				words[mFieldOffset[f] + w] = ((SCANWORD) print->getWord(2 * w)) | (((SCANWORD) print->getWord(2 * w + 1)) << WORD_LEN);
+			}
+		}
+	}
+
+	mCellStart[mNCells] = mSize;
+
+	// cardinalities without cells start at the next cell
+	mCellFirst[mNBits + 1] = mNCells;
+	for (int i = mNBits; i >= 0; i--) {
+		if (mCellFirst[i] < 0) {
+			mCellFirst[i] = mCellFirst[i + 1];
+		}
+	}
+
+	delete[] keys;
+
+	// keep the ids of the first field, all fields are packed
+	mRecords = new RecordTable();
+
+	for (long long i = 0; i < mSize; i++) {
+		mRecords->add(fields[0][i]->getId());
+	}
+
+	for (int f = 0; f < mFields; f++) {
+		for (long long i = 0; i < mSize; i++) {
+			delete fields[f][i];
+		}
+		delete[] fields[f];
+	}
+}
+
+// perform a search for the record <query> with one print per field
+// and add the records with a score of at least <minScore> to <result>
+// in the calling thread, return number of results
+long long CompositeGrid::search(QueryResult *result, Fingerprint **query, float minScore) {
+	SCANWORD stackWords[SCAN_QUERY_WORDS];
+	SCANWORD *queryWords = (mWordCount <= SCAN_QUERY_WORDS) ? stackWords : new SCANWORD[mWordCount];
+	int cards[MAX_FIELDS];
+	long long skippedCells = 0;
+	long long scored = 0;
+	long long hits = 0;
+	float threshold = minScore;	// raised if the results per query are limited
+	float bound;
+	int min, max;
+
+	// pack query, bits beyond the stored words only count for the union
+	for (int f = 0; f < mFields; f++) {
+		cards[f] = query[f]->cardinality();
+
+		for (int w = 0; w < mFieldWords[f]; w++) {
+			queryWords[mFieldOffset[f] + w] = ((SCANWORD) query[f]->getWord(2 * w)) | (((SCANWORD) query[f]->getWord(2 * w + 1)) << WORD_LEN);
+		}
+	}
+
+	// the first field needs this coefficient if all other fields match
+	bound = (minScore - (1 - mWeights[0])) / mWeights[0] - SCORE_MARGIN;
+
+	if (bound > 0) {
+		max = (int) MIN(1.0 / bound * cards[0] + 1, (double) (mNBits + 1));
+		min = MIN((int) ceil(bound * cards[0]), max);
+	} else {
+		min = 0;
+		max = mNBits + 1;
+	}
+
+	skippedCells = mNCells - (mCellFirst[max] - mCellFirst[min]);
+
+	for (int c = mCellFirst[min]; c < mCellFirst[max]; c++) {
+		int *cellCards = &mCellCards[c * mFields];
+		float cellBound = 0;
+
+		// the weighted mean of the cardinality ratios bounds the scores of the cell
+		for (int f = 0; f < mFields; f++) {
+			cellBound += mWeights[f] * cardinalityRatio(cards[f], cellCards[f]);
+		}
+
+		if (!(cellBound >= threshold)) {
+			skippedCells++;
+			continue;
+		}
+
+		for (long long i = mCellStart[c]; i < mCellStart[c + 1]; i++) {
+			SCANWORD *words = &mWords[i * mWordCount];
+			float score = 0;
+
+			for (int f = 0; f < mFields; f++) {
+				int common = 0;
+				int total;
+
+				for (int w = mFieldOffset[f]; w < mFieldOffset[f] + mFieldWords[f]; w++) {
+					common += popcount64(words[w] & queryWords[w]);
+				}
+
+				total = cards[f] + cellCards[f] - common;
+				score += mWeights[f] * ((total > 0) ? ((float) common) / total : 0);
+			}
+
+			if (score >= threshold) {
+				result->addRecord(query[0], mNumbers[i], score, &threshold);
+				hits++;
+			}
+		}
+
+		scored += mCellStart[c + 1] - mCellStart[c];
+	}
+
+	if (queryWords != stackWords) {
+		delete[] queryWords;
+	}
+
+	// update statistics, other threads may search concurrently
+	__sync_fetch_and_add(&mCntCells, skippedCells);
+	__sync_fetch_and_add(&mCntScores, scored);
+
+	return hits;
+}
+
+// search all records of file <in> asynchronously and add the results to <result>
+// queries are numbered by line, queries without id get their line number as id
+// return number of queries
+//
+// the queries are read in blocks, each block is searched before the next is read
+long long CompositeGrid::searchFile(QueryResult *result, FILE *in, float minScore) {
+	Fingerprint **block = new Fingerprint*[FIELD_BLOCK_SIZE * mFields];
+	lineBufferType line;
+	char *fields[MAX_FIELDS + 1];
+	int blockSize = 0;
+	int count;
+	long long i = 0;
+
+	for (int j = 0; j < FIELD_BLOCK_SIZE * mFields; j++) {
+		block[j] = new Fingerprint(0);
+	}
+	lineBufferInit(&line);
+
+	while (1) {
+		// for each line parse the fields
+		count = parseFields(in, &line, fields, mFields + 1);
+
+		// search the block if it is complete or the file has ended
+		if ((blockSize == FIELD_BLOCK_SIZE) || ((count < 0) && (blockSize > 0))) {
+			for (int j = 0; j < blockSize; j++) {
+				searchAsync(result, &block[j * mFields], minScore);
+			}
+			wait();
+			blockSize = 0;
+		}
+
+		if (count < 0) {
+			break;
+		}
+
+		parseRecord(fields, count, mFields, i+1, &block[blockSize * mFields]);
+		block[blockSize * mFields]->setIndex(i);
+		blockSize++;
+		i++;
+	}
+
+	setSizeLastSearch(i);
+	lineBufferFree(&line);
+
+	for (int j = 0; j < FIELD_BLOCK_SIZE * mFields; j++) {
+		delete block[j];
+	}
+	delete[] block;
+
+	return i;
+}
+
+// destructor
+// delete all used resources
+CompositeGrid::~CompositeGrid() {
+	delete mRecords;
+	delete[] mWords;
+	delete[] mNumbers;
+	delete[] mCellStart;
+	delete[] mCellCards;
+	delete[] mCellFirst;
+
+	if (mOwnPool) {
+		delete mWorkerPool;
+	}
+}
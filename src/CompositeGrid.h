@@ -0,0 +1,173 @@
+// CompositeGrid.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef COMPOSITEGRID_H
+#define COMPOSITEGRID_H
+
+#include <stdio.h>
+#include "Fingerprint.h"
+#include "BruteForce.h"
+#include "QueryResult.h"
+#include "RecordTable.h"
+#include "ThreadPool.h"
+
+#define MAX_FIELDS 4			// maximal number of fields of a record
+#define FIELD_BLOCK_SIZE 4096		// number of queries read from a file at a time
+
+// Objects of class CompositeGrid index records that consist of several
+// fingerprints, e.g. one for each of name, birth date and address. The score
+// of a record for a query is the weighted mean of the Tanimoto coefficients of
+// its fields, an empty field of both contributes 0.
+//
+// The records are grouped into cells by the cardinalities of all their fields.
+// The Tanimoto coefficient of a field is at most the ratio of the smaller to the
+// larger cardinality, so the weighted mean of these ratios bounds the score of all
+// records of a cell, and cells below the threshold are skipped. The cells are
+// sorted by the cardinality of the first field, and only the cardinalities of the
+// first field are visited that can reach the threshold if all other fields match.
+//
+// The fields of the records of a cell are packed into 64bit-words and scanned
+// like a BruteForce. The loaded fingerprints are deleted, only the ids of the
+// first field are kept in a RecordTable.
+class CompositeGrid {
+	private:
+
+	RecordTable *mRecords;		// ids of the first field by record number
+	SCANWORD *mWords;		// packed fields of all records in cell order
+	unsigned int *mNumbers;		// record number of each packed record
+	int mFields;			// number of fields
+	float mWeights[MAX_FIELDS];	// weight of each field, the weights sum up to 1
+	int mFieldWords[MAX_FIELDS];	// number of 64bit-words of each field
+	int mFieldOffset[MAX_FIELDS];	// first word of each field in a packed record
+	int mWordCount;			// number of words of a packed record
+	int mNBits;			// maximal size of the first field
+	long long *mCellStart;		// first packed record of each cell
+	int *mCellCards;		// field cardinalities, <mFields> for each cell
+	int *mCellFirst;		// first cell of each cardinality of the first field
+					// cells of cardinality i are mCellFirst[i] to mCellFirst[i+1]-1
+	int mNCells;			// number of cells
+	long long mSize;		// number of records
+	long long mSizeLastSearch;	// for statistics
+	long long mCntCells;		// statistic counter for skipped cells
+	long long mCntScores;		// statistic counter for scored records
+	ThreadPool *mWorkerPool;	// ThreadPool for concurrency
+	int mOwnPool;			// flag if mWorkerPool is deleted with this grid
+
+	// sort the records into cells and pack their fields
+	void build(Fingerprint ***fields, int *nBits, const double *weights);
+
+	// compute the ratio of the smaller to the larger of <a> and <b>, 0 if both are 0
+	// this bounds the Tanimoto coefficient of prints with these cardinalities
+	// and is computed like the coefficient for identical rounding
+	inline float cardinalityRatio(int a, int b) {
+		return (MAX(a, b) > 0) ? ((float) MIN(a, b)) / MAX(a, b) : 0;
+	}
+
+	public:
+
+	// constructor with a private ThreadPool of <threads> threads
+	CompositeGrid(Fingerprint ***fields, int nFields, long long size, int *nBits, const double *weights, int threads);
+
+	// constructor with a ThreadPool shared with other grids
+	CompositeGrid(Fingerprint ***fields, int nFields, long long size, int *nBits, const double *weights, ThreadPool *pool);
+
+	// destructor
+	~CompositeGrid();
+
+	// perform a search for the record <query> with one print per field
+	// and add the records with a score of at least <minScore> to <result>
+	// in the calling thread, return number of results
+	// if the results per query are limited, <minScore> is raised like a Tanimoto filter
+	long long search(QueryResult *result, Fingerprint **query, float minScore);
+
+	// perform a search like search() as one task of the ThreadPool and return
+	// the task registers the id of the query if it has results
+	inline void searchAsync(QueryResult *result, Fingerprint **query, float minScore) {
+		mWorkerPool->searchComposite(this, result, query, minScore);
+	}
+
+	// search all records of file <in> asynchronously and add the results to <result>
+	// queries are numbered by line, queries without id get their line number as id
+	// return number of queries
+	long long searchFile(QueryResult *result, FILE *in, float minScore);
+
+	// wait for running threads
+	inline void wait() {
+		mWorkerPool->wait();
+	}
+
+	// init statistic values
+	inline void initStatistics() {
+		mCntCells = 0;
+		mCntScores = 0;
+	}
+
+	// set size of last search for statistics
+	inline void setSizeLastSearch(long long size) {
+		mSizeLastSearch = size;
+	}
+
+	// get percentage of skipped cells in the last search
+	inline double getSkippedCells() {
+		return (double) mCntCells / ((double) mNCells * MAX(mSizeLastSearch, 1)) * 100;
+	}
+
+	// get percentage of scored records in the last search
+	inline double getScoredRecords() {
+		return (double) mCntScores / ((double) mSize * MAX(mSizeLastSearch, 1)) * 100;
+	}
+
+	// get number of records
+	inline long long getSize() {
+		return mSize;
+	}
+
+	// get number of fields
+	inline int getFields() {
+		return mFields;
+	}
+
+	// get number of cells
+	inline int getCells() {
+		return mNCells;
+	}
+
+	// get the ids of the records by record number
+	inline RecordTable *getRecords() {
+		return mRecords;
+	}
+
+	// get number of threads
+	inline int getThreads() {
+		return mWorkerPool->getSize();
+	}
+
+	// get the ThreadPool
+	inline ThreadPool *getWorkerPool() {
+		return mWorkerPool;
+	}
+};
+#endif
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "Misc.h"
+#include "Memory.h"
 
 typedef unsigned int WORDTYPE;			// 32bit-words
 #define WORD_LEN 32				// word-length in bits
@@ -48,9 +49,11 @@ class Fingerprint {
 	protected:
 
 	char *mId;				// pointer to ID string
+	long long mIndex;			// record or query number
 	WORDTYPE *mArray;			// array for stored bits
 	WORDTYPE mHashArray[FOLDED_WORDS];	// 128 Bit folded Hash-Key
 	int mLength;				// length of fingerprint in bits
+	int mBlock;				// number of the blocking key, 0 if there is none
 	static int sCardinalityMap[0x10000];	// static 16-bit cardinality-map
 	
 	// calculate length of word-array
@@ -78,6 +81,8 @@ class Fingerprint {
 	
 	inline Fingerprint(int length) {
 		mId = NULL;
+		mIndex = 0;
+		mBlock = 0;
 		mLength = length;
 		allocate();
 		clear();
@@ -87,26 +92,13 @@ class Fingerprint {
 	// constructor for fingerprint based on given ascii-string
 
 	inline Fingerprint(char * id, const char *str) {
-		int l = 0;
-		
 		mId = id;
-		
-		while ((str[l] == '0') || (str[l] == '1')) {
-			l++;
-		}
-
-		mLength = l;
-		
-		allocate();
-		clear();
-	
-		for (int i = 0; i < l; i++) {
-			if (str[i] != '0') {
-				setBit(i);
-			}
-		}
+		mIndex = 0;
+		mBlock = 0;
+		mLength = 0;
+		mArray = NULL;
 
-		fold();
+		parse(str);
 	}
 	
 	// copy-constructor for fingerprints
@@ -122,6 +114,8 @@ class Fingerprint {
 		}
 		
 		// copy word-array 
+		mIndex = print->mIndex;
+		mBlock = print->mBlock;
 		mLength = print->mLength;
 		allocate();
 	
@@ -150,6 +144,93 @@ class Fingerprint {
 		return mId;
 	}
 
+	// replace id by <id>, the fingerprint takes ownership of the string
+
+	inline void setId(char *id) {
+		if (mId != NULL) {
+			delete[] mId;
+		}
+		mId = id;
+	}
+
+	// replace id by a copy of <id>
+	// the current string is re-used if it is long enough
+
+	inline void copyId(const char *id) {
+		if ((mId == NULL) || (strlen(mId) < strlen(id))) {
+			if (mId != NULL) {
+				delete[] mId;
+			}
+			mId = new char[strlen(id) + 1];
+		}
+		strcpy(mId, id);
+	}
+
+	// get record or query number
+
+	inline long long getIndex() {
+		return mIndex;
+	}
+
+	// set record or query number
+
+	inline void setIndex(long long index) {
+		mIndex = index;
+	}
+
+	// get number of the blocking key
+	// only prints with the same blocking key are compared in a grid
+
+	inline int getBlock() {
+		return mBlock;
+	}
+
+	// set number of the blocking key
+
+	inline void setBlock(int block) {
+		mBlock = block;
+	}
+
+	// clear all bits and change the bit-length to <length>
+	// the word-array is re-used if it is large enough,
+	// call fold() after setting the bits
+
+	inline void reset(int length) {
+		int oldLength = (mArray != NULL) ? arrayLength() : 0;
+
+		mLength = MAX(length, 128);
+
+		if (arrayLength() > oldLength) {
+			if (mArray != NULL) {
+				delete[] mArray;
+			}
+			allocate();
+		}
+
+		clear();
+	}
+
+	// replace bits by the given ascii-string
+	// the word-array is re-used if it is large enough
+
+	inline void parse(const char *str) {
+		int l = 0;
+
+		while ((str[l] == '0') || (str[l] == '1')) {
+			l++;
+		}
+
+		reset(l);
+	
+		for (int i = 0; i < l; i++) {
+			if (str[i] != '0') {
+				setBit(i);
+			}
+		}
+
+		fold();
+	}
+
 	// clear all bits
 	
 	inline void clear() {
@@ -171,10 +252,22 @@ class Fingerprint {
 	}
 	
 	// get length in bits
-	
+
 	inline int getLength() {
 		return mLength;
 	}
+
+	// get number of words
+
+	inline int getWordCount() {
+		return arrayLength();
+	}
+
+	// get word <n>, 0 beyond the length
+
+	inline WORDTYPE getWord(int n) {
+		return (n < arrayLength()) ? mArray[n] : 0;
+	}
 	
 	// count set bits
 	
@@ -188,6 +281,37 @@ class Fingerprint {
 		return count;
 	}
 
+	// count set bits at positions start to end-1
+
+	inline int cardinality(int start, int end) {
+		int count = 0;
+		int first, last;
+
+		// ignore positions beyond the stored bits
+		end = MIN(end, arrayLength() * WORD_LEN);
+		first = start / WORD_LEN;
+		last = (end - 1) / WORD_LEN;
+
+		if (end <= start) {
+			return 0;
+		}
+
+		for (int i = first; i <= last; i++) {
+			WORDTYPE word = mArray[i];
+
+			// mask bits outside the range in the first and last word
+			if (i == first) {
+				word &= ~((BIT1 << (start % WORD_LEN)) - 1);
+			}
+			if ((i == last) && (end % WORD_LEN != 0)) {
+				word &= (BIT1 << (end % WORD_LEN)) - 1;
+			}
+			count += cardWord(word);
+		}
+
+		return count;
+	}
+
 	// get bit at position n
 	
 	inline WORDTYPE getBit(int n) {
@@ -200,21 +324,57 @@ class Fingerprint {
 		mArray[n / WORD_LEN] |= (BIT1 << (n % WORD_LEN));
 	}
 	
+	// set the bits of <byte> at positions 8n to 8n+7, lowest bit first
+	
+	inline void setByte(int n, unsigned char byte) {
+		mArray[n / (WORD_LEN / 8)] |= ((WORDTYPE) byte) << (8 * (n % (WORD_LEN / 8)));
+	}
+	
 	// unset bit at position n
 	
 	inline void unsetBit(int n) {
 		mArray[n / WORD_LEN] &= 0xFFFF - (BIT1 << (n % WORD_LEN));
 	}
 
+	// order by bit-vector, return 0 if the bits of <print> are equal
+	// different bits mostly differ in the hash-key, which is compared first
+
+	inline int compare(Fingerprint *print) {
+		int len = MAX(arrayLength(), print->arrayLength());
+
+		for (int i = 0; i < FOLDED_WORDS; i++) {
+			if (mHashArray[i] != print->mHashArray[i]) {
+				return (mHashArray[i] > print->mHashArray[i]) ? 1 : -1;
+			}
+		}
+
+		for (int i = 0; i < len; i++) {
+			WORDTYPE a = getWord(i);
+			WORDTYPE b = print->getWord(i);
+
+			if (a != b) {
+				return (a > b) ? 1 : -1;
+			}
+		}
+
+		return 0;
+	}
+
 	// compute tanimoto-index
 
 	inline float tanimoto(Fingerprint *print) {
+		return tanimoto(print->mArray, print->arrayLength());
+	}
+
+	// compute tanimoto-index with the bit-vector of <length> words at <array>
+
+	inline float tanimoto(const WORDTYPE *array, int length) {
 		int count_and = 0;
 		int count_or = 0;
 		int min, len;
 
 		len = arrayLength();
-		min = print->arrayLength();
+		min = length;
 		
 		// handle different bit-length
 		if (min <= len) {
@@ -223,14 +383,14 @@ class Fingerprint {
 			}
 		} else {
 			for (int i = len; i < min; i++) {
-				count_or += cardWord(print->mArray[i]);
+				count_or += cardWord(array[i]);
 			}
 			min = len;
 		}
 		
 		for (int i = 0; i < min; i++) {
-			int a = mArray[i] & print->mArray[i];
-			int o = mArray[i] | print->mArray[i];
+			int a = mArray[i] & array[i];
+			int o = mArray[i] | array[i];
 			count_and += cardWord(a);
 			count_or  += cardWord(o);
 		}
@@ -257,14 +417,52 @@ class Fingerprint {
 	// compute tanimoto estimation on hash-keys
 	
 	inline float tanimotoXOR(Fingerprint *print, int AB) {
+		return tanimotoXOR(print->mHashArray, AB);
+	}
+
+	// compute tanimoto estimation with the hash-key at <hash>
 
-		int xorCount  = cardWord(mHashArray[0] ^ print->mHashArray[0])
-			      + cardWord(mHashArray[1] ^ print->mHashArray[1])
-			      + cardWord(mHashArray[2] ^ print->mHashArray[2])
-			      + cardWord(mHashArray[3] ^ print->mHashArray[3]);
+	inline float tanimotoXOR(const WORDTYPE *hash, int AB) {
+
+		int xorCount  = cardWord(mHashArray[0] ^ hash[0])
+			      + cardWord(mHashArray[1] ^ hash[1])
+			      + cardWord(mHashArray[2] ^ hash[2])
+			      + cardWord(mHashArray[3] ^ hash[3]);
 		
 		return ((float) (AB - xorCount)) / (AB + xorCount);
 	}
+
+	// get hash-key
+
+	inline const WORDTYPE *getHash() {
+		return mHashArray;
+	}
+
+	// replace bits by the <count> words at <words> and compute the hash-key
+	// the word-array is re-used if it is large enough
+
+	inline void setWords(const WORDTYPE *words, int count) {
+		reset(count * WORD_LEN);
+
+		for (int i = 0; i < count; i++) {
+			mArray[i] = words[i];
+		}
+
+		fold();
+	}
+	
+	// count the heap memory of this fingerprint in <report>
+	// the fingerprint must have been allocated by new
+
+	inline void getMemory(memoryReportType *report) {
+		memoryAdd(report, MEMORY_PRINTS, this, sizeof(Fingerprint));
+		memoryMove(report, MEMORY_PRINTS, MEMORY_HASHES, sizeof(mHashArray));
+		memoryAdd(report, MEMORY_WORDS, mArray, arrayLength() * sizeof(WORDTYPE));
+
+		if (mId != NULL) {
+			memoryAdd(report, MEMORY_IDS, mId, strlen(mId) + 1);
+		}
+	}
 	
 	// static class function to initialise cardinality-map
 	
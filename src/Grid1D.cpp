@@ -24,30 +24,227 @@
 // along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
 
 #include "Grid1D.h"
+#include "Parser.h"
+
+// Instances of cellKeyType are used to sort the prints of one
+// cardinality by their blocking key and range cardinalities.
+typedef struct cellKeyStruct {
+	int block;			// blocking key number
+	unsigned long long key;		// range cardinalities, 16 bits each
+	Fingerprint *print;		// pointer to sorted Fingerprint
+} cellKeyType;
+
+// compare function for sorting cellKeyType with qsort
+static int compareCellKeys(const void *a, const void *b) {
+	int blockA = ((cellKeyType*) a)->block;
+	int blockB = ((cellKeyType*) b)->block;
+	unsigned long long keyA = ((cellKeyType*) a)->key;
+	unsigned long long keyB = ((cellKeyType*) b)->key;
+
+	if (blockA != blockB) {
+		return (blockA > blockB) - (blockA < blockB);
+	}
+
+	return (keyA > keyB) - (keyA < keyB);
+}
+
+// compare function for sorting Fingerprint pointers by bits and record number with qsort
+static int comparePrints(const void *a, const void *b) {
+	Fingerprint *printA = *((Fingerprint**) a);
+	Fingerprint *printB = *((Fingerprint**) b);
+	int order = printA->compare(printB);
+
+	if (order != 0) {
+		return order;
+	}
+
+	return (printA->getIndex() > printB->getIndex()) - (printA->getIndex() < printB->getIndex());
+}
 
 // constructor:
 //
-// sort Fingerprints by cardinality and
-// create a MultibitTree for each cardinality
+// create a grid with its own ThreadPool that keeps its cells in memory
+// the grid takes ownership of <prints> and all its Fingerprints,
+// their ids are moved to the RecordTable of the grid
 //
 // prints	: pointer on Fingerprint array
 // size		: size of <prints>
 // nBits	: maximal size of Fingerprints in <prints>
 // threads	: number of parallel threads passed to ThreadPool
+// numa		: flag if the ThreadPool is NUMA-aware
 // leafLimit	: leaf limit parameter passed to all MultibitTrees
+// dims		: number of bit ranges for partitioning into cells (1 to MAX_DIMS)
+// engine	: search engine of the cells, ENGINE_AUTO chooses by the cost model
+// planTanimoto	: Tanimoto filter of the sampled queries of the cost model
+// blocks	: blocking keys of the prints, NULL if prints of all keys are compared,
+//		  the grid takes ownership of the keys
+
+Grid1D::Grid1D(Fingerprint **prints, long long size, int nBits, int threads, int numa, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks) {
+	mWorkerPool = new ThreadPool(threads, numa);
+	mOwnPool = 1;
+	mPrints = prints;
+	mRecords = NULL;
+	mSize = size;
+	init(nBits, dims, engine, planTanimoto, NULL, blocks);
+
+	build(leafLimit);
+}
+
+// constructor:
+//
+// create a grid that uses a ThreadPool shared with other grids
+// the pool must outlive the grid
+//
+// pool		: ThreadPool used for building and searching
+
+Grid1D::Grid1D(Fingerprint **prints, long long size, int nBits, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks) {
+	mWorkerPool = pool;
+	mOwnPool = 0;
+	mPrints = prints;
+	mRecords = NULL;
+	mSize = size;
+	init(nBits, dims, engine, planTanimoto, NULL, blocks);
+
+	build(leafLimit);
+}
+
+// constructor:
+//
+// create a grid with its own ThreadPool that keeps its cells in <store>
+// the prints are read from the partition of the store, which is removed
+// after the build, the grid takes ownership of the store and <records>
+//
+// store	: CellStore whose partition holds the prints
+// records	: ids of the prints by record number
+
+Grid1D::Grid1D(CellStore *store, RecordTable *records, int threads, int numa, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks) {
+	mWorkerPool = new ThreadPool(threads, numa);
+	mOwnPool = 1;
+	mPrints = NULL;
+	mRecords = records;
+	mSize = records->getSize();
+	init(store->getPartitionBits(), dims, engine, planTanimoto, store, blocks);
 
-Grid1D::Grid1D(Fingerprint **prints, long long size, int nBits, int threads, int leafLimit) {
+	buildStored(leafLimit);
+}
+
+// constructor:
+//
+// create a grid that keeps its cells in <store> and uses a ThreadPool
+// shared with other grids, the pool must outlive the grid
+
+Grid1D::Grid1D(CellStore *store, RecordTable *records, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks) {
+	mWorkerPool = pool;
+	mOwnPool = 0;
+	mPrints = NULL;
+	mRecords = records;
+	mSize = records->getSize();
+	init(store->getPartitionBits(), dims, engine, planTanimoto, store, blocks);
+
+	buildStored(leafLimit);
+}
+
+// set the parameters of the constructors
+
+void Grid1D::init(int nBits, int dims, int engine, float planTanimoto, CellStore *store, BlockKeys *blocks) {
+	mNBits = nBits;
+	mDistinct = 0;
+	mPrintsStart = 0;
+	mSizeLastSearch = 0;
+	memoryInit(&mResultMemory);
+	mDims = MAX(1, MIN(dims, MAX_DIMS));
+	mEngine = engine;
+	mPlanTanimoto = planTanimoto;
+	mStore = store;
+	mBlockKeys = blocks;
+}
+
+// set the bit ranges of the cells, allocate the cell arrays for one cell
+// of each cardinality and clear the counters of the NUMA nodes
+
+void Grid1D::initCells() {
+	for (int d = 0; d <= mDims; d++) {
+		mRangeBounds[d] = (int) ((long long) d * mNBits / mDims);
+	}
+
+	mCellCapacity = mNBits + 1;
+	mCellStart = new long long[mCellCapacity + 1];
+	mCellCards = new int[mCellCapacity * mDims];
+	mCellBlock = new int[mCellCapacity];
+	mCellNode = new int[mCellCapacity];
+	mBuckets = new MultibitTree*[mCellCapacity];
+	mScans = new BruteForce*[mCellCapacity];
+	mPlans = new cellPlanType[mCellCapacity];
+	mCellFirst = new int[mNBits + 2];
+	mNCells = 0;
+	mCellStart[0] = 0;
+
+	mNodes = mWorkerPool->getNodes();
+	mNodeCells = new int[mNodes];
+	mNodePrints = new long long[mNodes];
+
+	for (int n = 0; n < mNodes; n++) {
+		mNodeCells[n] = 0;
+		mNodePrints[n] = 0;
+	}
+}
+
+// double the capacity of the cell arrays
+
+void Grid1D::growCells() {
+	long long *newStart = new long long[2 * mCellCapacity + 1];
+	int *newCards = new int[2 * mCellCapacity * mDims];
+	int *newBlock = new int[2 * mCellCapacity];
+	int *newNode = new int[2 * mCellCapacity];
+	MultibitTree **newBuckets = new MultibitTree*[2 * mCellCapacity];
+	BruteForce **newScans = new BruteForce*[2 * mCellCapacity];
+	cellPlanType *newPlans = new cellPlanType[2 * mCellCapacity];
+
+	memcpy(newStart, mCellStart, (mCellCapacity + 1) * sizeof(long long));
+	memcpy(newCards, mCellCards, mCellCapacity * mDims * sizeof(int));
+	memcpy(newBlock, mCellBlock, mCellCapacity * sizeof(int));
+	memcpy(newNode, mCellNode, mCellCapacity * sizeof(int));
+	memcpy(newBuckets, mBuckets, mCellCapacity * sizeof(MultibitTree*));
+	memcpy(newScans, mScans, mCellCapacity * sizeof(BruteForce*));
+	memcpy(newPlans, mPlans, mCellCapacity * sizeof(cellPlanType));
+	delete[] mCellStart;
+	delete[] mCellCards;
+	delete[] mCellBlock;
+	delete[] mCellNode;
+	delete[] mBuckets;
+	delete[] mScans;
+	delete[] mPlans;
+	mCellStart = newStart;
+	mCellCards = newCards;
+	mCellBlock = newBlock;
+	mCellNode = newNode;
+	mBuckets = newBuckets;
+	mScans = newScans;
+	mPlans = newPlans;
+	mCellCapacity *= 2;
+}
+
+// sort Fingerprints by cardinality, blocking key and range cardinalities,
+// create a MultibitTree for each cell and choose the engine of each cell
+
+void Grid1D::build(int leafLimit) {
+	int nBits = mNBits;
+	long long size = mSize;
+	Fingerprint **prints = mPrints;
 	int count[nBits + 1];		// cardnality cluster counter
 	int pos[nBits + 1];		// destination positions for each cluster
 	Fingerprint *swap1, *swap2;	// helper pointer for sorting
 	int card;			// helper variable for current cardinality
 
-	mWorkerPool = new ThreadPool(threads);
-	
-	mNBits = nBits;
-	mSize = size;
-	mSizeLastSearch = 0;
-	mBuckets = new MultibitTree*[nBits + 1];
+	// number prints in load order and move their ids to the record table
+	mRecords = new RecordTable();
+
+	for (long long i = 0; i < size; i++) {
+		prints[i]->setIndex(mRecords->add(prints[i]->getId()));
+		prints[i]->setId(NULL);
+	}
+
+	initCells();
 
 	// sort prints by cardinality
 	// this can be done in linear time because we have a limited number of clusters
@@ -97,29 +294,601 @@ Grid1D::Grid1D(Fingerprint **prints, long long size, int nBits, int threads, int
 		}
 	}
 
-	// create a MultibitTree for each cardinality cluster
 	for (int i = 0; i < (nBits + 1); i++) {
-		if (pos[i] < count[i]) {
-			mWorkerPool->createMultibitTree(&mBuckets[i], prints, pos[i], count[i], nBits, i, leafLimit);
+		addCells(i, pos[i], count[i]);
+	}
+
+	mCellFirst[nBits + 1] = mNCells;
+
+	buildCells(0, mNCells, leafLimit);
+}
+
+// build the cells from the partition of the CellStore in batches of
+// consecutive cardinalities: the prints of a batch are read while their
+// estimated memory fits into the resident limit of the store, then its
+// cells are built and written and its prints deleted before the next batch
+
+void Grid1D::buildStored(int leafLimit) {
+	long long printBytes = ((MAX(mNBits, 128) - 1) / WORD_LEN + 1) * sizeof(WORDTYPE) + BUILD_PRINT_BYTES;
+	long long batchLimit = MAX(mStore->getResidentLimit() / printBytes, 1LL);
+	int card = 0;
+
+	initCells();
+
+	while (card <= mNBits) {
+		long long batchSize = 0;
+		long long read = 0;
+		int first = mNCells;
+		int end = card;
+
+		// take the next cardinalities as long as they fit, but at least one
+		while ((end <= mNBits) && ((end == card) || (batchSize + mStore->getPartitionCount(end) <= batchLimit))) {
+			batchSize += mStore->getPartitionCount(end);
+			end++;
+		}
+
+		mPrints = new Fingerprint*[MAX(batchSize, 1LL)];
+		mPrintsStart = mDistinct;
+
+		for (; card < end; card++) {
+			long long size = mStore->readPartition(card, &mPrints[read]);
+
+			addCells(card, read, read + size);
+			read += size;
+		}
+
+		buildCells(first, mNCells, leafLimit);
+		writeCells(first, mNCells);
+
+		for (long long i = 0; i < mDistinct - mPrintsStart; i++) {
+			delete mPrints[i];
+		}
+		delete[] mPrints;
+		mPrints = NULL;
+	}
+
+	mCellFirst[mNBits + 1] = mNCells;
+	mStore->closePartition();
+
+	// return the memory of the batches to the operating system
+	memoryTrim();
+}
+
+// sort the prints <start> to <end>-1 of mPrints, which have cardinality <card>,
+// by blocking key and range cardinalities and append their cells
+
+void Grid1D::addCells(int card, long long start, long long end) {
+	int cards[MAX_DIMS];		// helper array for current range cardinalities
+	cellKeyType *keys;		// sort buffer for range cardinalities
+
+	mCellFirst[card] = mNCells;
+
+	// sort the prints by blocking key and range cardinalities
+	if ((mDims > 1) || (mBlockKeys != NULL)) {
+		keys = new cellKeyType[MAX(end - start, 1LL)];
+
+		for (long long j = start; j < end; j++) {
+			rangeCardinalities(mPrints[j], cards);
+			keys[j - start].key = 0;
+			for (int d = 0; d < mDims; d++) {
+				keys[j - start].key = (keys[j - start].key << 16) | cards[d];
+			}
+			keys[j - start].block = printBlock(mPrints[j]);
+			keys[j - start].print = mPrints[j];
+		}
+
+		qsort(keys, end - start, sizeof(cellKeyType), compareCellKeys);
+
+		for (long long j = start; j < end; j++) {
+			mPrints[j] = keys[j - start].print;
+		}
+
+		delete[] keys;
+	}
+
+	// find cells as runs of equal blocking keys and range cardinalities
+	for (long long j = start; j < end; j++) {
+		rangeCardinalities(mPrints[j], cards);
+
+		if ((j > start) && (printBlock(mPrints[j]) == mCellBlock[mNCells - 1]) && (memcmp(cards, &mCellCards[(mNCells - 1) * mDims], mDims * sizeof(int)) == 0)) {
+			continue;
+		}
+
+		if (mNCells == mCellCapacity) {
+			growCells();
+		}
+
+		// start new cell
+		mCellStart[mNCells] = mPrintsStart + j;
+		memcpy(&mCellCards[mNCells * mDims], cards, mDims * sizeof(int));
+		mCellBlock[mNCells] = printBlock(mPrints[j]);
+		mNCells++;
+	}
+
+	mCellStart[mNCells] = mPrintsStart + end;
+}
+
+// collapse the duplicates of the cells <first> to <last>-1, distribute the
+// cells over the NUMA nodes, create their MultibitTrees and choose their engines
+
+void Grid1D::buildCells(int first, int last, int leafLimit) {
+	int node;			// helper variable for NUMA node selection
+
+	collapseDuplicates(first, last);
+
+	// distribute cells over NUMA nodes
+	// each cell is assigned to the node with the fewest prints so far,
+	// so neighbouring cardinalities are spread over all nodes
+	for (int c = first; c < last; c++) {
+		node = 0;
+		for (int n = 1; n < mNodes; n++) {
+			if (mNodePrints[n] < mNodePrints[node]) {
+				node = n;
+			}
+		}
+
+		mCellNode[c] = node;
+		mNodeCells[node]++;
+		mNodePrints[node] += cellSize(c);
+	}
+
+	// create a MultibitTree for each cell, unless all cells are scanned
+	for (int c = first; c < last; c++) {
+		long long start = mCellStart[c] - mPrintsStart;
+
+		mScans[c] = NULL;
+
+		if (mEngine == ENGINE_SCAN) {
+			mBuckets[c] = NULL;
 		} else {
-			mBuckets[i] = NULL;
+			mWorkerPool->createMultibitTree(&mBuckets[c], mPrints, start, start + cellSize(c), mNBits, mPrints[start]->cardinality(), leafLimit, mCellNode[c]);
 		}
 	}
 
 	// wait for running threads
 	mWorkerPool->wait();
+
+	// predict the costs of each cell and replace the trees that are slower than a scan
+	for (int c = first; c < last; c++) {
+		mWorkerPool->planCell(this, c, mCellNode[c]);
+	}
+
+	mWorkerPool->wait();
+}
+
+// write the cells <first> to <last>-1 with their tree, or as a single leaf
+// if they are scanned, to the CellStore and delete their trees
+// a cell that cannot be written is kept in memory as a BruteForce scan
+
+void Grid1D::writeCells(int first, int last) {
+	mStore->setCells(last);
+
+	for (int c = first; c < last; c++) {
+		long long start = mCellStart[c] - mPrintsStart;
+
+		if (!mStore->write(c, mBuckets[c], mPrints, start, cellSize(c), mPrints[start]->cardinality(), mNBits)) {
+			mScans[c] = new BruteForce(mPrints, start, start + cellSize(c), mNBits);
+			mPlans[c].engine = ENGINE_SCAN;
+		}
+
+		if (mBuckets[c] != NULL) {
+			delete mBuckets[c];
+			mBuckets[c] = NULL;
+		}
+	}
+}
+
+// predict the costs of a search in <cell> with its tree and with a scan
+// and replace the tree by a BruteForce scan if that is cheaper
+// a cell of a CellStore gets no BruteForce, it is written as a single leaf
+//
+// the tree is probed by up to PLAN_SAMPLES evenly spaced prints of the
+// cell, which all have the cell's cardinality. Each visited inner node costs
+// its match bits, each checked leaf the XOR-hash and, if that passes, the
+// Tanimoto coefficient. A scan computes the intersection of each print.
+// With ENGINE_SCAN no tree is built and its cost is not measured (NAN).
+
+void Grid1D::planCell(int cell) {
+	cellPlanType *plan = &mPlans[cell];
+	MultibitTree *tree = mBuckets[cell];
+	long long start = mCellStart[cell] - mPrintsStart;
+	long long size = cellSize(cell);
+	int samples = (int) MIN((long long) PLAN_SAMPLES, size);
+	int card = mPrints[start]->cardinality();
+	int treeWords = (MAX(mNBits, 128) - 1) / WORD_LEN + 1;
+	int scanWords = (mNBits - 1) / SCAN_WORD_LEN + 1;
+	treeProbeType probe;
+
+	plan->scanCost = COST_SCAN_SEARCH + size * (COST_SCAN_PRINT + COST_SCAN_WORD * scanWords);
+
+	if (tree == NULL) {
+		plan->engine = ENGINE_SCAN;
+		plan->matchBitYield = NAN;
+		plan->pruning = NAN;
+		plan->treeCost = NAN;
+		if (mStore == NULL) {
+			mScans[cell] = new BruteForce(mPrints, start, start + size, mNBits);
+		}
+		return;
+	}
+
+	probe.nodes = 0;
+	probe.checksXOR = 0;
+	probe.checksTanimoto = 0;
+
+	for (int i = 0; i < samples; i++) {
+		tree->probe(mPrints[start + i * size / samples], card, mPlanTanimoto, &probe);
+	}
+
+	plan->matchBitYield = tree->getMatchBitYield();
+	plan->pruning = 1.0 - ((double) probe.checksXOR) / ((double) samples * size);
+	plan->treeCost = COST_TREE_SEARCH + (probe.nodes * (COST_NODE + plan->matchBitYield * COST_MATCH_BIT)
+		+ probe.checksXOR * COST_XOR
+		+ probe.checksTanimoto * COST_TANIMOTO_WORD * treeWords) / samples;
+
+	if (mEngine == ENGINE_AUTO) {
+		plan->engine = (plan->scanCost < plan->treeCost) ? ENGINE_SCAN : ENGINE_TREE;
+	} else {
+		plan->engine = mEngine;
+	}
+
+	if (plan->engine == ENGINE_SCAN) {
+		if (mStore == NULL) {
+			mScans[cell] = new BruteForce(mPrints, start, start + size, mNBits);
+		}
+		delete tree;
+		mBuckets[cell] = NULL;
+	}
+}
+
+// perform a search for <query> and <minTanimoto> in the calling thread
+// in the cells of NUMA <node> or in all cells if <node> is negative
+// this is called by the ThreadPool for asynchronous searches
+//
+// cardinalities closest to the query's are searched first, so a query
+// with limited results raises its threshold early and skips more cells
+
+long long Grid1D::searchRange(QueryResult *result, Fingerprint *query, float minTanimoto, int node) {
+	int min, max, card, first, last;
+	int cards[MAX_DIMS];
+	long long skippedCells;
+	long long skippedPrints;
+	long long hits = 0;
+	float threshold = minTanimoto;	// raised if the results per query are limited
+
+	if (node < 0) {
+		skippedCells = mNCells;
+		skippedPrints = mDistinct;
+	} else {
+		skippedCells = mNodeCells[node];
+		skippedPrints = mNodePrints[node];
+	}
+
+	card = query->cardinality();
+	rangeCardinalities(query, cards);
+
+	// search only in MultibitTrees with suitable cardinality and blocking key
+	cardRange(card, result->getMeasure(), minTanimoto, &min, &max);
+
+	for (int delta = 0; (card - delta >= min) || (card + delta < max); delta++) {
+		for (int side = 0; side < 2; side++) {
+			int c = (side == 0) ? card - delta : card + delta;
+
+			if ((c < min) || (c >= max) || ((side == 1) && (delta == 0))) {
+				continue;
+			}
+
+			blockCells(c, printBlock(query), &first, &last);
+
+			for (int i = first; i < last; i++) {
+				if (((node < 0) || (mCellNode[i] == node)) && reachable(i, cards, result->getMeasure(), threshold)) {
+					skippedCells--;
+					skippedPrints -= cellSize(i);
+					hits += searchCell(i, result, query, card, &threshold);
+				}
+			}
+		}
+	}
+
+	// update statistics, other threads may search concurrently
+	__sync_fetch_and_add(&mCntCells, skippedCells);
+	__sync_fetch_and_add(&mCntPrints, skippedPrints);
+
+	return hits;
+}
+
+// count the heap memory of the grid in <report>
+// this includes the prints, trees, scans, mapped cell files and the results
+// of the last search, but not the ThreadPool
+
+void Grid1D::getMemory(memoryReportType *report) {
+	for (long long i = 0; (mPrints != NULL) && (i < mDistinct); i++) {
+		mPrints[i]->getMemory(report);
+	}
+
+	mRecords->getMemory(report);
+
+	for (int i = 0; i < mNCells; i++) {
+		if (mScans[i] != NULL) {
+			mScans[i]->getMemory(report);
+		} else if (mBuckets[i] != NULL) {
+			mBuckets[i]->getMemory(report);
+		}
+	}
+
+	if (mStore != NULL) {
+		mStore->getMemory(report);
+	}
+
+	if (mBlockKeys != NULL) {
+		mBlockKeys->getMemory(report);
+	}
+
+	memoryAdd(report, MEMORY_GRID, mPrints, mSize * sizeof(Fingerprint*));
+	memoryAdd(report, MEMORY_GRID, mBuckets, mNCells * sizeof(MultibitTree*));
+	memoryAdd(report, MEMORY_GRID, mScans, mNCells * sizeof(BruteForce*));
+	memoryAdd(report, MEMORY_GRID, mPlans, mNCells * sizeof(cellPlanType));
+	memoryAdd(report, MEMORY_GRID, mCellStart, (mNCells + 1) * sizeof(long long));
+	memoryAdd(report, MEMORY_GRID, mCellCards, mNCells * mDims * sizeof(int));
+	memoryAdd(report, MEMORY_GRID, mCellFirst, (mNBits + 2) * sizeof(int));
+	memoryAdd(report, MEMORY_GRID, mCellBlock, mNCells * sizeof(int));
+	memoryAdd(report, MEMORY_GRID, mCellNode, mNCells * sizeof(int));
+	memoryAdd(report, MEMORY_GRID, mNodeCells, mNodes * sizeof(int));
+	memoryAdd(report, MEMORY_GRID, mNodePrints, mNodes * sizeof(long long));
+
+	memoryMerge(report, &mResultMemory);
 }
 
 // destructor
 // delete all used resources
 
 Grid1D::~Grid1D() {
-	for (int i = 0; i < mNBits; i++) {
-		if (mBuckets[i]) {
+	for (int i = 0; i < mNCells; i++) {
+		if (mScans[i] != NULL) {
+			delete mScans[i];
+		} else if (mBuckets[i] != NULL) {
 			delete mBuckets[i];
 		}
 	}
 
+	if (mStore != NULL) {
+		delete mStore;
+	}
+
+	if (mBlockKeys != NULL) {
+		delete mBlockKeys;
+	}
+
+	for (long long i = 0; (mPrints != NULL) && (i < mDistinct); i++) {
+		delete mPrints[i];
+	}
+
 	delete[] mBuckets;
-	delete mWorkerPool;
+	delete[] mScans;
+	delete[] mPlans;
+	delete[] mCellStart;
+	delete[] mCellCards;
+	delete[] mCellFirst;
+	delete[] mCellBlock;
+	delete[] mCellNode;
+	delete[] mNodeCells;
+	delete[] mNodePrints;
+	delete[] mPrints;
+	delete mRecords;
+
+	if (mOwnPool) {
+		delete mWorkerPool;
+	}
+}
+
+// perform a search in <cell> for the queries <first> to <last>-1 of <block>
+// and release each query to the QueryPool of the block
+// queries with another blocking key than the cell are released without a search
+
+void Grid1D::searchCellBlock(int cell, queryBlockType *block, int first, int last, QueryResult *result, float minTanimoto) {
+	long long searched = 0;
+
+	for (int q = first; q < last; q++) {
+		Fingerprint *query = block->queries[q];
+		float threshold = minTanimoto;
+		long long hits = 0;
+
+		if ((printBlock(query) == mCellBlock[cell]) && reachable(cell, &block->rangeCards[q * MAX_DIMS], result->getMeasure(), threshold)) {
+			searched++;
+			hits = searchCell(cell, result, query, block->cards[q], &threshold);
+		}
+
+		// results are attributed to the query on flushing
+		result->flush(query);
+		block->pool->release(query, result, hits);
+	}
+
+	// update statistics, other threads may search concurrently
+	__sync_fetch_and_sub(&mCntCells, searched);
+	__sync_fetch_and_sub(&mCntPrints, searched * cellSize(cell));
+}
+
+// keep one print of each set of equal prints in the cells <first> to <last>-1
+// the others are chained to its record in order of their record number and
+// deleted, the kept prints are moved together and the cells start at them
+// equal prints have equal range cardinalities, so they are in the same cell
+
+void Grid1D::collapseDuplicates(int first, int last) {
+	long long next = mCellStart[first] - mPrintsStart;
+
+	for (int c = first; c < last; c++) {
+		long long start = mCellStart[c] - mPrintsStart;
+		long long end = mCellStart[c + 1] - mPrintsStart;
+		Fingerprint *kept = NULL;	// print that is kept for the current chain
+		unsigned int chain = NO_RECORD;	// last record of the current chain
+
+		qsort(&mPrints[start], end - start, sizeof(Fingerprint*), comparePrints);
+		mCellStart[c] = mPrintsStart + next;
+
+		for (long long i = start; i < end; i++) {
+			if ((kept != NULL) && (mPrints[i]->compare(kept) == 0)) {
+				mRecords->setDuplicate(chain, (unsigned int) mPrints[i]->getIndex());
+				chain = (unsigned int) mPrints[i]->getIndex();
+				delete mPrints[i];
+			} else {
+				kept = mPrints[i];
+				chain = (unsigned int) kept->getIndex();
+				mPrints[next++] = kept;
+			}
+		}
+	}
+
+	mCellStart[last] = mPrintsStart + next;
+	mDistinct = mPrintsStart + next;
+}
+
+// search all queries of <block> cell by cell and wait for the tasks
+// the queries are sorted by cardinality, so the bounds of their suitable
+// cells do not decrease and the queries that reach a cell are a contiguous range
+
+void Grid1D::searchBlock(QueryResult *result, queryBlockType *block, float minTanimoto) {
+	int lo = 0;
+	int hi = 0;
+
+	// the number of tasks of each query has to be known before the first one completes
+	for (int q = 0; q < block->size; q++) {
+		cellRange(block->cards[q], result->getMeasure(), minTanimoto, &block->first[q], &block->last[q]);
+		block->pool->setPending(block->queries[q], block->last[q] - block->first[q]);
+	}
+
+	// all cells count as skipped until they are searched
+	mCntCells += (long long) mNCells * block->size;
+	mCntPrints += mDistinct * block->size;
+
+	for (int i = 0; i < mNCells; i++) {
+		while ((lo < block->size) && (block->last[lo] <= i)) {
+			lo++;
+		}
+		while ((hi < block->size) && (block->first[hi] <= i)) {
+			hi++;
+		}
+
+		if (lo < hi) {
+			mWorkerPool->searchBlock(this, i, block, lo, hi, result, minTanimoto, mCellNode[i]);
+		}
+	}
+
+	// the block is re-used for the next queries
+	mWorkerPool->wait();
+}
+
+// search all fingerprints of file <in> asynchronously and add the results to <result>
+// queries are numbered by line, queries without id get their line number as id
+// if the grid is blocked, each line holds the blocking key before the print
+// return number of queries
+//
+// if the cells are stored, the queries are read in blocks of one query per slot
+// of the QueryPool and each block is sorted by cardinality, so each cell is
+// mapped once per block; if the results per query are limited, the queries
+// of a block are searched one after another in this order
+
+long long Grid1D::searchFile(QueryResult *result, FILE *in, float minTanimoto) {
+	QueryPool queryPool(QUERY_POOL_SIZE);
+	Fingerprint *queryPrint;
+	char str[STRSIZE];
+	long long fields;
+	long long idx1, end1, idx2, end2;
+	long long i = 0;
+	char idStr[21];
+	lineBufferType line;		// whole line of a blocked query
+	char *blockFields[3];		// id, blocking key and print of a blocked line
+	int count = 0;
+	cellKeyType *keys = NULL;	// queries of the current block with their cardinality
+	queryBlockType block;		// current block sorted by cardinality
+
+	block.size = 0;
+	lineBufferInit(&line);
+
+	if (mStore != NULL) {
+		keys = new cellKeyType[QUERY_POOL_SIZE];
+		block.queries = new Fingerprint*[QUERY_POOL_SIZE];
+		block.cards = new int[QUERY_POOL_SIZE];
+		block.rangeCards = new int[QUERY_POOL_SIZE * MAX_DIMS];
+		block.first = new int[QUERY_POOL_SIZE];
+		block.last = new int[QUERY_POOL_SIZE];
+		block.pool = &queryPool;
+	}
+
+	while (1) {
+		// for each line parse fingerprint
+		if (mBlockKeys != NULL) {
+			count = parseFields(in, &line, blockFields, 3);
+			fields = (count < 0) ? 0 : 1;
+		} else {
+			fields = parseLine(in, str, &idx1, &end1, &idx2, &end2);
+		}
+
+		// search the block if it is complete or the file has ended
+		if ((keys != NULL) && ((block.size == QUERY_POOL_SIZE) || ((fields == 0) && (block.size > 0)))) {
+			qsort(keys, block.size, sizeof(cellKeyType), compareCellKeys);
+
+			if (result->getLimit() > 0) {
+				for (int j = 0; j < block.size; j++) {
+					searchAsync(result, keys[j].print, minTanimoto, &queryPool);
+				}
+			} else {
+				for (int j = 0; j < block.size; j++) {
+					block.queries[j] = keys[j].print;
+					block.cards[j] = (int) keys[j].key;
+					rangeCardinalities(keys[j].print, &block.rangeCards[j * MAX_DIMS]);
+				}
+				searchBlock(result, &block, minTanimoto);
+			}
+			block.size = 0;
+		}
+
+		if (fields == 0) {
+			break;
+		}
+
+		// re-use query fingerprint of a completed query
+		queryPrint = queryPool.acquire(i);
+
+		if (mBlockKeys != NULL) {
+			// a query with an unknown key has no cells to search
+			queryPrint->setBlock(mBlockKeys->find(parseBlockedPrint(blockFields, count, i+1, queryPrint)));
+		} else if (fields == 1) {
+			// if there is only one field, use line as id
+			sprintf(idStr, "%012lld", i+1);
+			queryPrint->copyId(idStr);
+			queryPrint->parse(str+idx1);
+		} else {
+			// if there are two fields, use first string as id
+			queryPrint->copyId(str+idx1);
+			queryPrint->parse(str+idx2);
+		}
+
+		if (keys != NULL) {
+			keys[block.size].block = 0;
+			keys[block.size].key = queryPrint->cardinality();
+			keys[block.size].print = queryPrint;
+			block.size++;
+		} else {
+			// call asychonous search-method
+			searchAsync(result, queryPrint, minTanimoto, &queryPool);
+		}
+		i++;
+	}
+
+	setSizeLastSearch(i);
+
+	// wait for running threads
+	wait();
+	lineBufferFree(&line);
+
+	if (keys != NULL) {
+		delete[] keys;
+		delete[] block.queries;
+		delete[] block.cards;
+		delete[] block.rangeCards;
+		delete[] block.first;
+		delete[] block.last;
+	}
+
+	return i;
 }
@@ -29,7 +29,12 @@
 #include <math.h>
 #include "Fingerprint.h"
 #include "MultibitTree.h"
+#include "BruteForce.h"
+#include "CellStore.h"
+#include "BlockKeys.h"
+#include "RecordTable.h"
 #include "ThreadPool.h"
+#include "QueryPool.h"
 
 // Objects of class Grid1D hold an array of instances of the class MultibitTree.
 // In each MultibitTree all Fingerprints of the same cardinality are stored.
@@ -38,61 +43,372 @@
 // The Grid1D also uses the class ThreadPool for concurrently work on different
 // MultibitTrees.
 //
+// The prints of each cardinality can be split into cells by the cardinalities
+// of <dims> bit ranges. Each cell is searched by its tree or a BruteForce scan,
+// as chosen by a cost model, and may be kept in a CellStore on disk.
+// A grid of a CellStore is built from the partition of the store a few
+// cardinalities at a time, and each cell is written before the next
+// cardinalities are read, so only the RecordTable and the cell arrays
+// stay in memory.
+//
 // The Grid1D data structure is based on the kDGrid described in
 // http://www.almob.org/content/5/1/9
 
+#define MAX_DIMS 4			// maximal number of bit ranges for cells
+#define STATISTICS_SIZE 9		// number of values of getStatistics
+#define BUILD_PRINT_BYTES 192		// estimated heap memory of a print in a tree while
+					// its cell is built, without its bit-vector
+
+// search engines of the cells
+#define ENGINE_AUTO 0			// choose the cheaper engine by the cost model
+#define ENGINE_TREE 1			// search all cells with MultibitTrees
+#define ENGINE_SCAN 2			// search all cells with BruteForce scans
+#define ENGINES 3			// number of engine settings
+
+// names of the engine settings
+static const char * const ENGINE_NAMES[ENGINES] = {"auto", "tree", "scan"};
+
+// cost model, in units of the scan of one 64bit-word without a popcount instruction
+// the constants were fitted to the search times of single cells
+#define PLAN_SAMPLES 16			// sampled queries for the pruning of each tree
+#define COST_TREE_SEARCH 6.0		// search in a tree, without its nodes and leaves
+#define COST_NODE 10.0			// visit of an inner tree node
+#define COST_MATCH_BIT 0.7		// check of one match bit
+#define COST_XOR 3.5			// XOR-hash estimation of a leaf print
+#define COST_TANIMOTO_WORD 1.2		// Tanimoto coefficient, per 32bit-word
+#define COST_SCAN_SEARCH 20.0		// scan of a cell, without its prints
+#define COST_SCAN_PRINT 1.5		// scan of one print, without its words
+#if defined(__GNUC__) && defined(__POPCNT__)
+#define COST_SCAN_WORD 0.5		// scan of one 64bit-word
+#else
+#define COST_SCAN_WORD 1.0		// scan of one 64bit-word
+#endif
+
+// Instances of cellPlanType hold the prediction of the cost model for one cell.
+// Costs are predicted for one query of the cell's cardinality.
+typedef struct cellPlanStruct {
+	int engine;			// ENGINE_TREE or ENGINE_SCAN
+	double matchBitYield;		// average number of match bits per inner node
+	double pruning;			// fraction of prints not checked by the sampled queries
+	double treeCost;		// predicted cost of a search in the tree
+					// the tree values are NAN if no tree was built
+	double scanCost;		// predicted cost of a scan
+} cellPlanType;
+
+// Instances of queryBlockType hold a block of queries sorted by cardinality
+// that is searched cell by cell. The queries that reach a cell are a
+// contiguous range of the block.
+typedef struct queryBlockStruct {
+	Fingerprint **queries;		// queries sorted by cardinality
+	int *cards;			// cardinality of each query
+	int *rangeCards;		// range cardinalities, MAX_DIMS for each query
+	int *first;			// first cell with suitable cardinality for each query
+	int *last;			// end of the suitable cells for each query
+	int size;			// number of queries
+	QueryPool *pool;		// QueryPool that holds the queries
+} queryBlockType;
+
 class Grid1D {
 	private:
 
-	MultibitTree **mBuckets;	// array of MultibitTrees
+	MultibitTree **mBuckets;	// array of MultibitTrees, one for each cell
+					// NULL if the cell is scanned or stored
+	BruteForce **mScans;		// array of BruteForce scans, one for each cell
+					// NULL if the cell is searched by its tree or stored
+	CellStore *mStore;		// files of the stored cells, NULL if all cells are in memory
+	cellPlanType *mPlans;		// cost model prediction of each cell
+	long long *mCellStart;		// first print of each cell in cell order
+	int *mCellCards;		// range cardinalities, <mDims> for each cell
+	int *mCellFirst;		// first cell of each cardinality
+					// cells of cardinality i are mCellFirst[i] to mCellFirst[i+1]-1
+	int *mCellBlock;		// blocking key number of each cell, 0 if not blocked
+	BlockKeys *mBlockKeys;		// blocking keys of the prints, NULL if not blocked
+	int mNCells;			// number of cells
+	int mCellCapacity;		// allocated size of the cell arrays
+	int mDims;			// number of bit ranges for cells
+	int mRangeBounds[MAX_DIMS + 1];	// bit ranges for cells
+	int *mCellNode;			// NUMA node of each cell
+	int mNodes;			// number of NUMA nodes used by the ThreadPool
+	int *mNodeCells;		// number of cells of each NUMA node
+	long long *mNodePrints;		// number of prints of each NUMA node
+	Fingerprint **mPrints;		// distinct Fingerprints owned by this grid in cell order,
+					// a stored grid only holds those of the cells it builds
+	long long mPrintsStart;		// position of mPrints[0] in cell order
+	RecordTable *mRecords;		// ids and duplicates by record number (load order)
 	int mNBits;			// maximal size of Fingerprints
-	long long mSize;		// size of Fingerprint-array used by mBuckets
+	long long mSize;		// number of records, including duplicates
+	long long mDistinct;		// number of distinct prints in the cells
 	long long mSizeLastSearch;	// for statistics
+	long long mCntCells;		// statistic counter for skipped cells
+	long long mCntPrints;		// statistic counter for prints in skipped cells
 	ThreadPool *mWorkerPool;	// ThreadPool for concurrency
-	
+	int mOwnPool;			// flag if mWorkerPool is deleted with this grid
+	int mEngine;			// ENGINE_AUTO, ENGINE_TREE or ENGINE_SCAN
+	float mPlanTanimoto;		// Tanimoto filter of the sampled queries
+	memoryReportType mResultMemory;	// heap memory of the results of the last search
+
+	// set the parameters of the constructors
+	void init(int nBits, int dims, int engine, float planTanimoto, CellStore *store, BlockKeys *blocks);
+
+	// set the bit ranges and allocate the cell arrays
+	void initCells();
+
+	// double the capacity of the cell arrays
+	void growCells();
+
+	// sort <prints> by cardinality, build the MultibitTrees and
+	// choose the search engine of each cell
+	void build(int leafLimit);
+
+	// build and write the cells of the partition of the CellStore batch by batch
+	void buildStored(int leafLimit);
+
+	// sort the prints <start> to <end>-1 of mPrints with cardinality <card> into cells
+	void addCells(int card, long long start, long long end);
+
+	// build the trees of the cells <first> to <last>-1 and choose their engines
+	void buildCells(int first, int last, int leafLimit);
+
+	// keep one print of each set of equal prints in the cells and chain the others to it
+	void collapseDuplicates(int first, int last);
+
+	// write the cells <first> to <last>-1 to the CellStore and delete their trees
+	void writeCells(int first, int last);
+
+	// search all queries of <block> cell by cell and wait for the tasks
+	void searchBlock(QueryResult *result, queryBlockType *block, float minTanimoto);
+
+	// get number of prints of <cell>
+	inline long long cellSize(int cell) {
+		return mCellStart[cell + 1] - mCellStart[cell];
+	}
+
+	// get the blocking key number of <print> that is used for the cells
+	// the keys of the prints are ignored if the grid is not blocked
+	inline int printBlock(Fingerprint *print) {
+		return (mBlockKeys != NULL) ? print->getBlock() : 0;
+	}
+
+	// compute the range cardinalities of <print>
+	inline void rangeCardinalities(Fingerprint *print, int *cards) {
+		for (int d = 0; d < mDims; d++) {
+			cards[d] = print->cardinality(mRangeBounds[d], mRangeBounds[d + 1]);
+		}
+	}
+
+	// check if <cell> may contain prints with a score of <measure> of
+	// at least <minScore> to a query with range cardinalities <cards>
+	// with one range this is the bound of the cardinalities, which is
+	// only needed if <minScore> was raised during the search
+	inline int reachable(int cell, int *cards, const measureType *measure, float minScore) {
+		int common = 0;
+		int total = 0;
+		int cellCard = 0;
+		int *cellCards = &mCellCards[cell * mDims];
+
+		for (int d = 0; d < mDims; d++) {
+			common += MIN(cards[d], cellCards[d]);
+			total += MAX(cards[d], cellCards[d]);
+			cellCard += cellCards[d];
+		}
+
+		if (measure->type != MEASURE_TANIMOTO) {
+			// the scores grow with the common bits, which are at most <common>
+			return (total == 0) || (measureScore(measure, total + common - cellCard, cellCard, common) >= minScore);
+		}
+
+		return (total == 0) || (((float) common) / total >= minScore);
+	}
+
+	// compute the range of cardinalities <min> to <max>-1 that are suitable
+	// for a query with cardinality <card>
+	inline void cardRange(int card, const measureType *measure, float minScore, int *min, int *max) {
+		if (measure->type != MEASURE_TANIMOTO) {
+			measureCardRange(measure, card, minScore, mNBits, min, max);
+			return;
+		}
+
+		*max = MIN((int) (1.0 / minScore * card) + 1, mNBits + 1);
+		*min = MIN((int) ceil((minScore * card)), *max);
+	}
+
+	// compute the range of cells <first> to <last>-1 of cardinality <card>
+	// and blocking key number <block> by a binary search
+	inline void blockCells(int card, int block, int *first, int *last) {
+		int lo = mCellFirst[card];
+		int hi = mCellFirst[card + 1];
+		int mid;
+
+		if (mBlockKeys == NULL) {
+			*first = lo;
+			*last = hi;
+			return;
+		}
+
+		// find the first cell with a key of at least <block>
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (mCellBlock[mid] < block) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		*first = lo;
+
+		// find the first cell with a larger key
+		hi = mCellFirst[card + 1];
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (mCellBlock[mid] <= block) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		*last = lo;
+	}
+
+	// compute the range of cells <first> to <last>-1 with suitable cardinality
+	// for a query with cardinality <card>
+	inline void cellRange(int card, const measureType *measure, float minScore, int *first, int *last) {
+		int min, max;
+
+		cardRange(card, measure, minScore, &min, &max);
+
+		*first = mCellFirst[min];
+		*last = mCellFirst[max];
+	}
+
 	public:
 	
-	// constructor
-	Grid1D(Fingerprint **prints, long long size, int nBits, int threads, int leafLimit);
+	// constructor with a private ThreadPool of <threads> threads
+	// that is NUMA-aware if <numa> is set
+	Grid1D(Fingerprint **prints, long long size, int nBits, int threads, int numa, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks);
+
+	// constructor with a ThreadPool shared by several grids
+	Grid1D(Fingerprint **prints, long long size, int nBits, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks);
+
+	// constructors for the prints in the partition of <store> with the ids in <records>
+	Grid1D(CellStore *store, RecordTable *records, int threads, int numa, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks);
+	Grid1D(CellStore *store, RecordTable *records, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, BlockKeys *blocks);
 
 	// destructor	
 	~Grid1D();
 
 	// perform a search for <query> and <minTanimoto> and add the result to <result>
 	// parallelise by buckets
+	// if the results per query are limited, the whole search is one task
 	inline void search(QueryResult *result, Fingerprint *query, float minTanimoto) {
-		int min, max, card;
+		if (result->getLimit() > 0) {
+			mWorkerPool->searchGrid(this, result, query, minTanimoto, -1, NULL);
+		} else {
+			searchCells(result, query, minTanimoto);
+		}
+
+		// wait for running threads
+		mWorkerPool->wait();
+	}
+
+	// start a task for each cell that <query> can reach with <minTanimoto> and return,
+	// the results are complete after wait()
+	// the results per query must not be limited
+	inline void searchCells(QueryResult *result, Fingerprint *query, float minTanimoto) {
+		int first, last, min, max, card;
+		int cards[MAX_DIMS];
+		long long skippedCells = mNCells;
+		long long skippedPrints = mDistinct;
 
 		card = query->cardinality();
+		rangeCardinalities(query, cards);
 		
-		// search only in MultibitTrees with suitable cardinality
-		min = (int) ceil((minTanimoto * card));
-		max = MIN((int) (1.0 / minTanimoto * card) + 1, mNBits + 1);
-		
-		for (int i = min; i < max; i++) {
-			if (mBuckets[i]) {
-				mWorkerPool->searchMultibitTree(mBuckets[i], result, query, card, minTanimoto);
+		// search only in MultibitTrees with suitable cardinality and blocking key
+		cardRange(card, result->getMeasure(), minTanimoto, &min, &max);
+
+		for (int c = min; c < max; c++) {
+			blockCells(c, printBlock(query), &first, &last);
+
+			for (int i = first; i < last; i++) {
+				if (reachable(i, cards, result->getMeasure(), minTanimoto)) {
+					skippedCells--;
+					skippedPrints -= cellSize(i);
+					mWorkerPool->searchCell(this, i, result, query, card, minTanimoto, mCellNode[i]);
+				}
 			}
 		}
-		
-		// wait for running threads
-		mWorkerPool->wait();
+
+		// update statistics, other threads may search concurrently
+		__sync_fetch_and_add(&mCntCells, skippedCells);
+		__sync_fetch_and_add(&mCntPrints, skippedPrints);
 	}
 
 	// perform a search for <query and <minTanimoto> and add the result to <result>
 	// start search as one thread and return
-	inline void searchAsync(QueryResult *result, Fingerprint *query, float minTanimoto) {
-		int min, max, card;
+	// on NUMA-aware grids start one thread on each node
+	// if <queries> is given, <query> is released to it after the search
+	// if the results per query are limited, the whole search is one task
+	inline void searchAsync(QueryResult *result, Fingerprint *query, float minTanimoto, QueryPool *queries) {
+		if ((mNodes == 1) || (result->getLimit() > 0)) {
+			if (queries != NULL) {
+				queries->setPending(query, 1);
+			}
+			mWorkerPool->searchGrid(this, result, query, minTanimoto, -1, queries);
+		} else {
+			// the number of tasks has to be known before the first one completes
+			if (queries != NULL) {
+				int tasks = 0;
 
-		card = query->cardinality();
-		
-		// search only in MultibitTrees with suitable cardinality
-		min = (int) ceil((minTanimoto * card));
-		max = MIN((int) (1.0 / minTanimoto * card) + 1, mNBits + 1);
-				
-		mWorkerPool->searchMultibitTreeRange(mBuckets, min, max, result, query, card, minTanimoto);
+				for (int node = 0; node < mNodes; node++) {
+					if (mNodeCells[node] > 0) {
+						tasks++;
+					}
+				}
+				queries->setPending(query, tasks);
+			}
+
+			for (int node = 0; node < mNodes; node++) {
+				if (mNodeCells[node] > 0) {
+					mWorkerPool->searchGrid(this, result, query, minTanimoto, node, queries);
+				}
+			}
+		}
+	}
+
+	// perform a search for <query> and <minTanimoto> in the calling thread
+	// in the cells of NUMA <node> or in all cells if <node> is negative
+	// this is called by the ThreadPool for asynchronous searches
+	// return number of results
+	long long searchRange(QueryResult *result, Fingerprint *query, float minTanimoto, int node);
+
+	// perform a search for <query> that has <cardinality> filtered by <minTanimoto>
+	// in <cell> with its engine in the calling thread, return number of results
+	inline long long searchCell(int cell, QueryResult *result, Fingerprint *query, int cardinality, float *minTanimoto) {
+		if (mScans[cell] != NULL) {
+			return mScans[cell]->search(result, query, cardinality, minTanimoto);
+		}
+
+		if (mBuckets[cell] != NULL) {
+			return mBuckets[cell]->search(result, query, cardinality, minTanimoto);
+		}
+
+		return mStore->search(cell, result, query, cardinality, minTanimoto);
 	}
 
+	// perform a search in <cell> for the queries <first> to <last>-1 of <block>
+	// and release each query to the QueryPool of the block
+	// this is called by the ThreadPool for searches in blocks
+	void searchCellBlock(int cell, queryBlockType *block, int first, int last, QueryResult *result, float minTanimoto);
+
+	// predict the costs of both engines for <cell> and keep the chosen one
+	// this is called by the ThreadPool while building
+	void planCell(int cell);
+
+	// search all fingerprints of file <in> asynchronously and add the results to <result>
+	// queries are numbered by line, queries without id get their line number as id
+	// if the grid is blocked, each line holds the blocking key before the print
+	// return number of queries
+	long long searchFile(QueryResult *result, FILE *in, float minTanimoto);
+
 	// wait for running threads();
 	inline void wait() {
 		mWorkerPool->wait();
@@ -100,35 +416,91 @@ class Grid1D {
 
 	// init Statistic Values;
 	inline void initStatistics() {
-		for (int i = 0; i <= mNBits; i++) {
-			if (mBuckets[i]) {
+		for (int i = 0; i < mNCells; i++) {
+			if (mScans[i] != NULL) {
+				mScans[i]->initCntTanimoto();
+			} else if (mBuckets[i] != NULL) {
 				mBuckets[i]->initCntXOR();
 				mBuckets[i]->initCntTanimoto();
-      			}
+			}
     		}
+		if (mStore != NULL) {
+			mStore->initStatistics();
+		}
+		mCntCells = 0;
+		mCntPrints = 0;
 	}
 
 	// get Statistics of last search
+	// values are XOR-checks, Tanimoto-checks, skipped cells, skipped prints and total comparisons
+	// followed by the scanned cells and the predicted costs of a query that searches all cells
+	// with trees, with scans and with the chosen engines, <STATISTICS_SIZE> values in total
+	// the percentages of the costs are relative to the trees
+	// the tree cost is NAN if the grid was built with ENGINE_SCAN
 	inline void getStatistics(double *valuesPtr, double *percentsPtr) {
 		long long cntX = 0;
 		long long cntT = 0;
+		long long scanCells = 0;
+		double treeCost = 0;
+		double scanCost = 0;
+		double cost = 0;
+		double total = (double) mDistinct * mSizeLastSearch;
 
-		for (int i = 0; i <= mNBits; i++) {
-			if (mBuckets[i] != NULL) {
-			  cntX += mBuckets[i]->getCntXOR(); 				
-			  cntT += mBuckets[i]->getCntTanimoto();
-			} 				
+		for (int i = 0; i < mNCells; i++) {
+			if (mScans[i] != NULL) {
+				cntT += mScans[i]->getCntTanimoto();
+			} else if (mBuckets[i] != NULL) {
+				cntX += mBuckets[i]->getCntXOR();
+				cntT += mBuckets[i]->getCntTanimoto();
+			}
+
+			if (mPlans[i].engine == ENGINE_SCAN) {
+				scanCells++;
+			}
+
+			treeCost += mPlans[i].treeCost;
+			scanCost += mPlans[i].scanCost;
+			cost += (mPlans[i].engine == ENGINE_SCAN) ? mPlans[i].scanCost : mPlans[i].treeCost;
+		}
+
+		if (mStore != NULL) {
+			cntX += mStore->getCntXOR();
+			cntT += mStore->getCntTanimoto();
 		}
 
 		valuesPtr[0] = (double)cntX;
 		valuesPtr[1] = (double)cntT;
-		valuesPtr[2] = (double)(mSize * mSizeLastSearch);
+		valuesPtr[2] = (double)mCntCells;
+		valuesPtr[3] = (double)mCntPrints;
+		valuesPtr[4] = total;
     
-		percentsPtr[0] = (double)cntX / (mSize * mSizeLastSearch) * 100;
-		percentsPtr[1] = (double)cntT / (mSize * mSizeLastSearch) * 100;
-		percentsPtr[2] = 100.0;
+		percentsPtr[0] = (double)cntX / total * 100;
+		percentsPtr[1] = (double)cntT / total * 100;
+		percentsPtr[2] = (double)mCntCells / ((double) mNCells * mSizeLastSearch) * 100;
+		percentsPtr[3] = (double)mCntPrints / total * 100;
+		percentsPtr[4] = 100.0;
+
+		valuesPtr[5] = (double)scanCells;
+		valuesPtr[6] = treeCost;
+		valuesPtr[7] = scanCost;
+		valuesPtr[8] = cost;
+
+		percentsPtr[5] = (double)scanCells / mNCells * 100;
+		percentsPtr[6] = 100.0;
+		percentsPtr[7] = scanCost / treeCost * 100;
+		percentsPtr[8] = cost / treeCost * 100;
 	}
 	
+	// count the heap memory of the grid by component in <report>
+	void getMemory(memoryReportType *report);
+
+	// keep the heap memory of <result> for the memory report
+	// call this after a search has been merged or finished
+	inline void setResultMemory(QueryResult *result) {
+		memoryInit(&mResultMemory);
+		result->getMemory(&mResultMemory);
+	}
+
 	// set size of last search;
 	inline void setSizeLastSearch(long long sls) {
 		mSizeLastSearch = sls;
@@ -139,5 +511,49 @@ class Grid1D {
 		return mSizeLastSearch;
 	}
 
+	// get number of Fingerprints
+	inline long long getSize() {
+		return mSize;
+	}
+
+	// get number of distinct Fingerprints, the others are duplicates
+	inline long long getDistinct() {
+		return mDistinct;
+	}
+
+	// get number of cells
+	inline int getCells() {
+		return mNCells;
+	}
+
+	// get cost model prediction of <cell>
+	inline cellPlanType *getCellPlan(int cell) {
+		return &mPlans[cell];
+	}
+
+	// get CellStore of the stored cells, NULL if all cells are in memory
+	inline CellStore *getStore() {
+		return mStore;
+	}
+
+	// get blocking keys of the prints, NULL if the grid is not blocked
+	inline BlockKeys *getBlockKeys() {
+		return mBlockKeys;
+	}
+
+	// get ids and duplicates by record number
+	inline RecordTable *getRecords() {
+		return mRecords;
+	}
+
+	// get number of threads that search this grid
+	inline int getThreads() {
+		return mWorkerPool->getSize();
+	}
+
+	// get ThreadPool that searches this grid
+	inline ThreadPool *getWorkerPool() {
+		return mWorkerPool;
+	}
 };
 #endif
@@ -0,0 +1,144 @@
+// Memory.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+// This file contains helper functions to account the heap memory of the
+// data structures by component. Each allocation is counted with the bytes
+// that hold data and its overhead, which includes unused capacity, the
+// rounding of the allocator and its header. The allocator's block size is
+// queried where the C library supports it and estimated otherwise.
+// Cell files that are mapped by a CellStore are a component of their own.
+
+// components of the memory report
+#define MEMORY_WORDS 0			// bit-vectors of the fingerprints
+#define MEMORY_HASHES 1			// 128bit folded hash-keys of the fingerprints
+#define MEMORY_IDS 2			// id strings of the records
+#define MEMORY_PRINTS 3			// other fields of the fingerprint objects
+#define MEMORY_NODES 4			// node arrays of the MultibitTrees
+#define MEMORY_MATCH_BITS 5		// match-bit lists of the tree nodes
+#define MEMORY_SCANS 6			// packed fingerprints of the BruteForce scans
+#define MEMORY_GRID 7			// cell arrays and fingerprint arrays of the grid
+#define MEMORY_RESULTS 8		// result chunks, merged records and query ids
+#define MEMORY_MAPPED 9			// mapped cell files of a CellStore
+#define MEMORY_COMPONENTS 10		// number of components
+
+// names of the components
+static const char * const MEMORY_NAMES[MEMORY_COMPONENTS] = {
+	"words", "hashes", "ids", "prints", "nodes", "matchBits", "scans", "grid", "results", "mapped"
+};
+
+// Instances of memoryReportType hold the heap memory of each component.
+typedef struct memoryReportStruct {
+	long long bytes[MEMORY_COMPONENTS];		// bytes that hold data
+	long long overhead[MEMORY_COMPONENTS];		// unused capacity and allocator overhead
+	long long allocations[MEMORY_COMPONENTS];	// number of allocations
+} memoryReportType;
+
+// clear all values of <report>
+inline void memoryInit(memoryReportType *report) {
+	for (int c = 0; c < MEMORY_COMPONENTS; c++) {
+		report->bytes[c] = 0;
+		report->overhead[c] = 0;
+		report->allocations[c] = 0;
+	}
+}
+
+// get number of heap bytes used by the allocation of <size> bytes at <ptr>
+inline long long memoryBlockSize(const void *ptr, size_t size) {
+#if defined(__GLIBC__)
+	(void) size;
+	return (long long) (malloc_usable_size((void *) ptr) + sizeof(size_t));
+#elif defined(__APPLE__)
+	(void) size;
+	return (long long) malloc_size(ptr);
+#else
+	// assume a header of one word and an alignment of two words
+	return (long long) ((size + 3 * sizeof(size_t) - 1) / (2 * sizeof(size_t)) * (2 * sizeof(size_t)));
+#endif
+}
+
+// count an allocation of <size> bytes at <ptr> for <component>
+// only <used> bytes hold data, the rest is counted as overhead
+inline void memoryAdd(memoryReportType *report, int component, const void *ptr, size_t size, size_t used) {
+	if (ptr == NULL) {
+		return;
+	}
+
+	report->bytes[component] += used;
+	report->overhead[component] += memoryBlockSize(ptr, size) - used;
+	report->allocations[component]++;
+}
+
+// count an allocation of <size> bytes at <ptr> for <component>
+inline void memoryAdd(memoryReportType *report, int component, const void *ptr, size_t size) {
+	memoryAdd(report, component, ptr, size, size);
+}
+
+// move <bytes> of an allocation counted for component <from> to component <to>,
+// used for fields embedded in an object
+inline void memoryMove(memoryReportType *report, int from, int to, size_t bytes) {
+	report->bytes[from] -= bytes;
+	report->bytes[to] += bytes;
+}
+
+// add all values of <source> to <report>
+inline void memoryMerge(memoryReportType *report, memoryReportType *source) {
+	for (int c = 0; c < MEMORY_COMPONENTS; c++) {
+		report->bytes[c] += source->bytes[c];
+		report->overhead[c] += source->overhead[c];
+		report->allocations[c] += source->allocations[c];
+	}
+}
+
+// return the free memory at the top of the heap and of unused pages of the
+// allocator to the operating system, where the C library supports it
+inline void memoryTrim() {
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+}
+
+// get number of free bytes kept by the allocator, -1 if it is unknown
+// this is the fragmentation of the heap between the allocations
+inline long long memoryHeapFree() {
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+
+	return (long long) info.fordblks;
+#else
+	return -1;
+#endif
+}
+#endif
@@ -30,4 +30,6 @@
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define ABS(x) (((x) >= 0) ? (x) : (-(x)))
 
+#define CACHE_LINE 64			// padding between concurrently written fields
+
 #endif
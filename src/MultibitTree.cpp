@@ -29,9 +29,6 @@
 #include "MultibitTree.h"
 #include "Misc.h"
 
-#define LEAF_BIT 0x8000
-#define BIT_MASK 0x7fff
-
 // constructor
 // create a new MultibitTree from an array of Fingerprints
 // prints		pointer to array of Fingerprints
@@ -62,6 +59,8 @@ MultibitTree::MultibitTree(Fingerprint **prints, long long leafStart, long long
 	mMatchListZeros = new ushort[nBits];
 	usedBits = new Fingerprint(nBits);
 	mNodes = 0;
+	mInnerNodes = 0;
+	mInnerMatchBits = 0;
 	mCntXOR = 0;
 	mCntTanimoto = 0;
 
@@ -86,10 +85,29 @@ MultibitTree::~MultibitTree() {
 	
 	delete[] mMatchBits;
 	delete[] mMatchBitsSize;
+	delete[] mMatchBitsZerosSize;
 	delete[] mLeftChild;
 	delete[] mRightChild;
 }
 
+// count the heap memory of the tree in <report>, without its prints
+// the node arrays are allocated for the largest possible tree,
+// their unused part is counted as overhead
+void MultibitTree::getMemory(memoryReportType *report) {
+	memoryAdd(report, MEMORY_NODES, this, sizeof(MultibitTree));
+	memoryAdd(report, MEMORY_NODES, mMatchBits, mTreeSize * sizeof(ushort*), mNodes * sizeof(ushort*));
+	memoryAdd(report, MEMORY_NODES, mMatchBitsSize, mTreeSize * sizeof(ushort), mNodes * sizeof(ushort));
+	memoryAdd(report, MEMORY_NODES, mMatchBitsZerosSize, mTreeSize * sizeof(ushort), mNodes * sizeof(ushort));
+	memoryAdd(report, MEMORY_NODES, mLeftChild, mTreeSize * sizeof(long long), mNodes * sizeof(long long));
+	memoryAdd(report, MEMORY_NODES, mRightChild, mTreeSize * sizeof(long long), mNodes * sizeof(long long));
+
+	for (long long i = 0; i < mNodes; i++) {
+		if ((mMatchBitsSize[i] & BIT_MASK) != 0) {
+			memoryAdd(report, MEMORY_MATCH_BITS, mMatchBits[i], (mMatchBitsSize[i] & BIT_MASK) * sizeof(ushort));
+		}
+	}
+}
+
 // recursively build MultibitTree nodes and sub-nodes
 void MultibitTree::buildNode(Fingerprint *usedBits, long long leafStart, long long leafEnd) {
 	ushort listCountOnes;		// match bit counter for 1-bits
@@ -149,6 +167,8 @@ void MultibitTree::buildNode(Fingerprint *usedBits, long long leafStart, long lo
 			list[listCountZeros + i] = mMatchListOnes[i];
 		}
 		mMatchBits[thisNode] = list;
+	} else {
+		mMatchBits[thisNode] = NULL;
 	}
 
 	mMatchBitsSize[thisNode] = listCount;
@@ -172,6 +192,8 @@ void MultibitTree::buildNode(Fingerprint *usedBits, long long leafStart, long lo
 		mRightChild[thisNode] = leafEnd;
 	} else {
 		// create inner node
+		mInnerNodes++;
+		mInnerMatchBits += listCount;
 
 		// copy to temporary clone of used bits for left sub-tree
 		clone = new Fingerprint(usedBits);
@@ -249,9 +271,12 @@ long long MultibitTree::splitLeavesHalf(long long leafStart, long long leafEnd)
 	
 // searching
 // traverse the tree and visit only those sub-trees that don't surely underrun the tanimoto filter
-void MultibitTree::internalSearch(QueryResult *result, Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatched, float minTanimoto) {	
+// the threshold of the measure is checked by its equivalent Tanimoto coefficient
+// return number of results
+long long MultibitTree::internalSearch(QueryResult *result, Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatched, scoreFilterType *filter) {	
 	int size;
 	ushort *matchBitIdx;
+	long long hits = 0;
 
 	size = mMatchBitsSize[node];
 
@@ -264,17 +289,18 @@ void MultibitTree::internalSearch(QueryResult *result, Fingerprint *queryPrint,
 			mCntXOR++;
 
 			// check XOR-hash estimation
-			if (queryPrint->tanimotoXOR(leaf, AB) >= minTanimoto) {
+			if (queryPrint->tanimotoXOR(leaf, AB) >= filterTanimoto(filter)) {
 				// increase statistic counter for tanimoto calculation
 				mCntTanimoto++;
 
 				// check exact tanimoto condition and add to results if matches
-				float tanimoto = queryPrint->tanimoto(leaf);
+				float score = filterScoreTanimoto(filter, queryPrint->tanimoto(leaf));
 
-				// check exact tanimoto condition
-				if (tanimoto >= minTanimoto) {
+				// check exact condition of the measure
+				if (score >= *filter->minScore) {
 					// add matching leaf to QueryResult
-					result->add(queryPrint->getId(), leaf, tanimoto);
+					result->add(queryPrint, leaf, score, filter->minScore);
+					hits++;
 				}
 			}
 		}
@@ -303,10 +329,56 @@ void MultibitTree::internalSearch(QueryResult *result, Fingerprint *queryPrint,
 		treeUnmatched -= countZeros;		// subtract 1-bits of tree-bits  covered by match-bits
 
 		// compute and compare minimal tanimoto-coefficient for this sub-tree
-		if (((float) MIN(queryUnmatched, treeUnmatched)) / (commonXOR + MAX(queryUnmatched, treeUnmatched)) >= minTanimoto) {
+		if (((float) MIN(queryUnmatched, treeUnmatched)) / (commonXOR + MAX(queryUnmatched, treeUnmatched)) >= filterTanimoto(filter)) {
 			// analyse sub-trees
-			internalSearch(result, queryPrint, mLeftChild[node], commonXOR, AB, queryUnmatched, treeUnmatched, minTanimoto);
-			internalSearch(result, queryPrint, mRightChild[node], commonXOR, AB, queryUnmatched, treeUnmatched, minTanimoto);
+			hits += internalSearch(result, queryPrint, mLeftChild[node], commonXOR, AB, queryUnmatched, treeUnmatched, filter);
+			hits += internalSearch(result, queryPrint, mRightChild[node], commonXOR, AB, queryUnmatched, treeUnmatched, filter);
+		}
+	}
+
+	return hits;
+}
+
+// probing
+// traverse the tree like internalSearch, but only count visited nodes and checked leaves
+void MultibitTree::internalProbe(Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatched, float minTanimoto, treeProbeType *probe) {
+	int size;
+	ushort *matchBitIdx;
+
+	size = mMatchBitsSize[node];
+
+	if (size & LEAF_BIT) {
+		for (long long i = mLeftChild[node]; i < mRightChild[node]; i++) {
+			probe->checksXOR++;
+
+			if (queryPrint->tanimotoXOR(mLeaves[i], AB) >= minTanimoto) {
+				probe->checksTanimoto++;
+			}
+		}
+	} else {
+		int countOnes = 0;
+		int countZeros = 0;
+
+		int sizeZeros =  mMatchBitsZerosSize[node];
+		matchBitIdx = mMatchBits[node];
+
+		probe->nodes++;
+
+		for (int i = 0; i < sizeZeros; i++) {
+			countOnes += queryPrint->getBit(matchBitIdx[i]);
+		}
+
+		for (int i = sizeZeros; i < size; i++) {
+			countZeros += queryPrint->getBit(matchBitIdx[i]) ^ 1;
+		}
+
+		commonXOR += countZeros + countOnes;
+		queryUnmatched -= countOnes;
+		treeUnmatched -= countZeros;
+
+		if (((float) MIN(queryUnmatched, treeUnmatched)) / (commonXOR + MAX(queryUnmatched, treeUnmatched)) >= minTanimoto) {
+			internalProbe(queryPrint, mLeftChild[node], commonXOR, AB, queryUnmatched, treeUnmatched, minTanimoto, probe);
+			internalProbe(queryPrint, mRightChild[node], commonXOR, AB, queryUnmatched, treeUnmatched, minTanimoto, probe);
 		}
 	}
 }
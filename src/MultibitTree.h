@@ -38,7 +38,24 @@
 
 typedef unsigned short ushort;
 
+#define LEAF_BIT 0x8000			// flag of leaf nodes in the match bits size
+#define BIT_MASK 0x7fff			// mask of the number of match bits
+
+// forward declaration
+class CellStore;
+
+// Instances of treeProbeType count the work of a search
+// without adding results to a QueryResult.
+typedef struct treeProbeStruct {
+	long long nodes;		// visited inner nodes
+	long long checksXOR;		// leaf prints checked by the XOR-hash estimation
+	long long checksTanimoto;	// leaf prints checked by the exact Tanimoto coefficient
+} treeProbeType;
+
 class MultibitTree {
+	// the CellStore writes the node arrays to its cell files
+	friend class CellStore;
+
 	private:
 	
 	int mCardinality;		// common cardinality for this tree
@@ -49,6 +66,8 @@ class MultibitTree {
 	long long mSize;		// length of MultibitTree in the array of Fingerprints
 	long long mTreeSize;		// size of tree data structure
 	long long mNodes;		// count of tree nodes
+	long long mInnerNodes;		// count of inner tree nodes
+	long long mInnerMatchBits;	// total size of match bits of all inner nodes
 	ushort **mMatchBits;		// match-bit-list for each tree node
 	ushort *mMatchBitsSize;		// total size of match bits for each tree node
 	ushort *mMatchBitsZerosSize;	// size of zero match bits for each tree node
@@ -71,8 +90,12 @@ class MultibitTree {
 	// sort sub tree prints by best match bit
 	long long splitLeavesHalf(long long leafStart, long long leafEnd);
 	
-	// recursively search sub tree
-	void internalSearch (QueryResult *result, Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatchedi, float minTanimoto);
+	// recursively search sub tree, return number of results
+	// the threshold of <filter> may be raised by the QueryResult while searching
+	long long internalSearch (QueryResult *result, Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatchedi, scoreFilterType *filter);
+
+	// recursively probe sub tree like internalSearch and count the work in <probe>
+	void internalProbe(Fingerprint *queryPrint, long long node, int commonXOR, int AB, int queryUnmatched, int treeUnmatched, float minTanimoto, treeProbeType *probe);
 
 	public:
 	
@@ -84,11 +107,37 @@ class MultibitTree {
 	~MultibitTree();
 
 	// perform a search for <query> that has <cardinality> filtered by <minTanimoto>
-	// and add the result to <result>
-	inline void search(QueryResult *result, Fingerprint *queryPrint, int cardinality, float minTanimoto) {
-		internalSearch(result, queryPrint, 0, 0, cardinality + mCardinality, cardinality, mCardinality, minTanimoto);
+	// and add the result to <result>, return number of results
+	// <minTanimoto> is a threshold of the measure of <result>
+	// if the number of results per query is limited, <minTanimoto> is
+	// raised to the lowest score that can still enter the result
+	inline long long search(QueryResult *result, Fingerprint *queryPrint, int cardinality, float *minTanimoto) {
+		scoreFilterType filter;
+
+		filterInit(&filter, result->getMeasure(), cardinality, mCardinality, minTanimoto);
+
+		return internalSearch(result, queryPrint, 0, 0, cardinality + mCardinality, cardinality, mCardinality, &filter);
 	}
 	
+	// count the work of a search for <query> that has <cardinality> filtered
+	// by <minTanimoto> in <probe> without adding results or statistics
+	inline void probe(Fingerprint *queryPrint, int cardinality, float minTanimoto, treeProbeType *probe) {
+		internalProbe(queryPrint, 0, 0, cardinality + mCardinality, cardinality, mCardinality, minTanimoto, probe);
+	}
+
+	// count the heap memory of the tree in <report>, without its prints
+	void getMemory(memoryReportType *report);
+
+	// return average number of match bits of the inner nodes
+	inline double getMatchBitYield() {
+		return (mInnerNodes > 0) ? ((double) mInnerMatchBits) / mInnerNodes : 0.0;
+	}
+
+	// return number of inner nodes
+	inline long long getInnerNodes() {
+		return mInnerNodes;
+	}
+
 	// return tree size
 	inline long long getSize() {
 		return mSize;
@@ -0,0 +1,185 @@
+// Numa.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "Numa.h"
+
+#define SYSFS_NODE "/sys/devices/system/node"
+#define LIST_SIZE 4096		// maximal length of a sysfs list
+
+// read a sysfs list file into a new array, return number of ids or -1
+static int readList(const char *filename, int **ids) {
+	char str[LIST_SIZE];
+	FILE *in;
+	int n;
+
+	in = fopen(filename, "r");
+
+	if (in == NULL) {
+		return -1;
+	}
+
+	if (fgets(str, LIST_SIZE, in) == NULL) {
+		fclose(in);
+		return -1;
+	}
+
+	fclose(in);
+
+	n = NumaTopology::parseList(str, NULL, 0);
+	*ids = new int[n > 0 ? n : 1];
+	NumaTopology::parseList(str, *ids, n);
+
+	return n;
+}
+
+// constructor
+// read topology from sysfs
+NumaTopology::NumaTopology() {
+	char filename[256];
+	int *nodeIds;
+	int n;
+
+	mNodes = 0;
+	n = readList(SYSFS_NODE "/online", &nodeIds);
+
+	if (n > 0) {
+		mNodeIds = new int[n];
+		mCpuCount = new int[n];
+		mCpus = new int*[n];
+
+		for (int i = 0; i < n; i++) {
+			snprintf(filename, sizeof(filename), SYSFS_NODE "/node%d/cpulist", nodeIds[i]);
+
+			// ignore nodes without cpus, e.g. memory-only nodes
+			mCpuCount[mNodes] = readList(filename, &mCpus[mNodes]);
+
+			if (mCpuCount[mNodes] > 0) {
+				mNodeIds[mNodes] = nodeIds[i];
+				mNodes++;
+			} else if (mCpuCount[mNodes] == 0) {
+				delete[] mCpus[mNodes];
+			}
+		}
+	}
+
+	if (n >= 0) {
+		delete[] nodeIds;
+	}
+
+	if (mNodes == 0) {
+		// no NUMA information, use all online cpus as one node
+		if (n > 0) {
+			delete[] mNodeIds;
+			delete[] mCpuCount;
+			delete[] mCpus;
+		}
+
+		mNodes = 1;
+		mNodeIds = new int[1];
+		mCpuCount = new int[1];
+		mCpus = new int*[1];
+		mNodeIds[0] = 0;
+		mCpuCount[0] = MAX((int) sysconf(_SC_NPROCESSORS_ONLN), 1);
+		mCpus[0] = new int[mCpuCount[0]];
+
+		for (int i = 0; i < mCpuCount[0]; i++) {
+			mCpus[0][i] = i;
+		}
+	}
+}
+
+// destructor
+NumaTopology::~NumaTopology() {
+	for (int i = 0; i < mNodes; i++) {
+		delete[] mCpus[i];
+	}
+
+	delete[] mNodeIds;
+	delete[] mCpuCount;
+	delete[] mCpus;
+}
+
+// bind the calling thread to <cpu>, return 0 on success
+int NumaTopology::bindThread(int cpu) {
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+#else
+	return -1;
+#endif
+}
+
+// parse a sysfs list like "0-3,8,10-11" into <ids>
+// return number of ids or the required size if <max> is too small
+int NumaTopology::parseList(const char *str, int *ids, int max) {
+	int n = 0;
+	int from, to;
+	char *end;
+
+	while (*str != 0) {
+		from = (int) strtol(str, &end, 10);
+
+		if (end == str) {
+			break;
+		}
+
+		str = end;
+		to = from;
+
+		if (*str == '-') {
+			str++;
+			to = (int) strtol(str, &end, 10);
+			str = end;
+		}
+
+		for (int i = from; i <= to; i++) {
+			if (n < max) {
+				ids[n] = i;
+			}
+			n++;
+		}
+
+		if (*str == ',') {
+			str++;
+		}
+	}
+
+	return n;
+}
@@ -0,0 +1,80 @@
+// Numa.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stdlib.h>
+#include "Misc.h"
+
+// Objects of class NumaTopology describe the NUMA nodes of the machine
+// and the cpus that belong to each node. The topology is read from sysfs.
+// If sysfs is not available, all online cpus are reported as one node.
+
+class NumaTopology {
+	private:
+
+	int mNodes;			// number of NUMA nodes
+	int *mNodeIds;			// sysfs id of each node
+	int *mCpuCount;			// number of cpus of each node
+	int **mCpus;			// cpu ids of each node
+
+	public:
+
+	// constructor
+	// read topology from sysfs
+	NumaTopology();
+
+	// destructor
+	~NumaTopology();
+
+	// get number of nodes
+	inline int getNodes() {
+		return mNodes;
+	}
+
+	// get sysfs id of <node>
+	inline int getNodeId(int node) {
+		return mNodeIds[node];
+	}
+
+	// get number of cpus of <node>
+	inline int getCpuCount(int node) {
+		return mCpuCount[node];
+	}
+
+	// get <i>-th cpu of <node>
+	inline int getCpu(int node, int i) {
+		return mCpus[node][i];
+	}
+
+	// bind the calling thread to <cpu>, return 0 on success
+	static int bindThread(int cpu);
+
+	// parse a sysfs list like "0-3,8,10-11" into <ids>
+	// return number of ids or the required size if <max> is too small
+	static int parseList(const char *str, int *ids, int max);
+};
+#endif
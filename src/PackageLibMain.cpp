@@ -26,6 +26,7 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <string.h>
+#include <limits.h>
 
 #include <R.h>
 #include <Rdefines.h>
@@ -33,246 +34,367 @@
 
 #include "Misc.h"
 #include "Grid1D.h"
+#include "CompositeGrid.h"
+#include "ResultWriter.h"
+#include "Parser.h"
+#include "Tuner.h"
 
 // This file contains the pure c-functions for the R-library-interface.
 // R_init_useCall	register .Call-Methods
+// mbtThreadPoolCall	wrapper for ThreadPool-constructor
 // mbtLoadCall		wrapper for Grid1D-constructor
+// mbtLoadPrintsCall	wrapper for Grid1D-constructor on in-memory prints
 // mbtSearchCall	wrapper for Grid1D::search
 // mbtSearchFileCall	wrapper for Grid1D::searchFile
+// mbtSearchQueriesCall	wrapper for Grid1D::searchAsync on in-memory queries
 // mbtUnloadCall	wrapper for Grid1D-destructor
-// mbtStatistics	wrapper for 
+// mbtStatistics	wrapper for Grid1D::getStatistics
+// mbtIdsCall		return the fingerprint ids of a grid
+// mbtLoadFieldsCall	wrapper for CompositeGrid-constructor on in-memory records
+// mbtSearchFieldsCall	wrapper for CompositeGrid::searchAsync on in-memory records
+//
+// Each loaded Grid1D is passed to R as an external pointer handle.
+// The handle's finalizer deletes the grid when R garbage-collects it,
+// so any number of indexes can stay resident at the same time.
+//
+// Results are returned as 1-based record numbers. The ids of the loaded
+// fingerprints are converted into an R character vector only once per
+// grid, when they are first requested. The vector is kept in the handle
+// and results with ids only copy its cached strings.
 
-// maximal line size = length of ascii representation of fingerprint
-#define STRSIZE 4000
+// fields of the list kept in the protected field of a grid handle
+#define HANDLE_POOL 0		// handle of a shared ThreadPool or NULL
+#define HANDLE_IDS 1		// cached fingerprint ids or NULL
+#define HANDLE_FIELDS 2
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-static Grid1D *grid = NULL;		// static Grid1D as data structure singleton
+// finalizer for grid handles, also used for explicit unloading
+void mbtUnload(SEXP handle) {
+	Grid1D *grid = (Grid1D*) R_ExternalPtrAddr(handle);
 
-// call destructor of static grid datastructure
-void mbtUnload() {
 	if (grid != NULL) {
 		delete grid;
-		grid = NULL;
+		R_ClearExternalPtr(handle);
 	}
 }
 
-// check, if a character is considered to be a white-space or seperator
-int isWS(char c) {
-	return (
-		(c == '"') ||
-		(c == '\'') ||
-		(c == ',') ||
-		(c == ';') ||
-		(c == ' ') ||
-		(c == '\t')
-	);
-}
+// finalizer for composite grid handles, also used for explicit unloading
+void mbtUnloadFields(SEXP handle) {
+	CompositeGrid *grid = (CompositeGrid*) R_ExternalPtrAddr(handle);
 
-// check, if a character is considered to be end of line
-int isEOL(char c) {
-	return (
-		(c == 10) ||
-		(c == 13) ||
-		(c == 0)
-	);
+	if (grid != NULL) {
+		delete grid;
+		R_ClearExternalPtr(handle);
+	}
 }
 
-// parse prints from file, return number of parsed fields
-int parseLine(FILE *in, char *str, long long *idx1, long long *end1, long long *idx2, long long *end2) {
-	// read line from file
-	if (fgets(str, STRSIZE, in) == NULL) {
-		return 0;
+// finalizer for thread pool handles
+void mbtFreeThreadPool(SEXP handle) {
+	ThreadPool *pool = (ThreadPool*) R_ExternalPtrAddr(handle);
+
+	if (pool != NULL) {
+		delete pool;
+		R_ClearExternalPtr(handle);
 	}
-	
-	// parse line
-	
-	// find start of first field
-	*idx1 = 0;
-	while (isWS(str[*idx1]) && (*idx1 < STRSIZE-1)) {
-		(*idx1)++;
+}
+
+// return the Grid1D of a handle or raise an R error
+Grid1D *mbtGetGrid(SEXP handle) {
+	Grid1D *grid;
+
+	if ((TYPEOF(handle) != EXTPTRSXP) || (R_ExternalPtrTag(handle) != install("multibitTree"))) {
+		error("invalid multibitTree handle");
 	}
 
-	// find end of first field
-	*end1 = *idx1;
-	while (!isWS(str[*end1]) && (*end1 < STRSIZE-1) && !isEOL(str[*end1])) {
-		(*end1)++;
+	grid = (Grid1D*) R_ExternalPtrAddr(handle);
+
+	if (grid == NULL) {
+		error("multibitTree handle has been unloaded");
 	}
 
-	if (!isEOL(str[*end1])) {
-		// find start of second field
-		*idx2 = *end1;
-		while (isWS(str[*idx2]) && (*idx2 < STRSIZE-1)) {
-			(*idx2)++;
-		}
-		
-		// find end of second field
-		*end2 = *idx2;
-		while (!isWS(str[*end2]) && (*end2 < STRSIZE-1) && !isEOL(str[*end2])) {
-			(*end2)++;
-		}
-	} else {
-		*idx2 = 0;
-		*end2 = 0;
+	return grid;
+}
+
+// return the CompositeGrid of a handle or raise an R error
+CompositeGrid *mbtGetFieldGrid(SEXP handle) {
+	CompositeGrid *grid;
+
+	if ((TYPEOF(handle) != EXTPTRSXP) || (R_ExternalPtrTag(handle) != install("multibitTreeFields"))) {
+		error("invalid multibitTree fields handle");
 	}
 
-	// cut field 1
-	str[*end1] = 0;
+	grid = (CompositeGrid*) R_ExternalPtrAddr(handle);
 
-	if (*idx2 != *end2) {
-		// if there are two fields, cut field 2
-		str[*end2] = 0;
-		return 2;
+	if (grid == NULL) {
+		error("multibitTree fields handle has been unloaded");
 	}
 
-	return 1;
+	return grid;
 }
 
-// read input file and call constructor for static data structure
-int mbtLoad(const char *filename, int threads, long long size, int leafLimit) {
-	Fingerprint **prints;
-	long long sizePrints;
-	int nBits;
-	int len;
-	char str[STRSIZE];
-	long long fields;
-	long long idx1, end1, idx2, end2;
-	char *idStr;
-	FILE *in;
+// check if <handle> is the handle of a CompositeGrid
+int mbtIsFieldHandle(SEXP handle) {
+	return (TYPEOF(handle) == EXTPTRSXP) && (R_ExternalPtrTag(handle) == install("multibitTreeFields"));
+}
 
-	// initialize Fingerprint data structure (cardinality-map)
-        Fingerprint::init();
+// return the ThreadPool of a handle or raise an R error
+ThreadPool *mbtGetThreadPool(SEXP handle) {
+	ThreadPool *pool;
 
-	// delete an existing grid
-	if (grid != NULL) {
-		mbtUnload();
+	if ((TYPEOF(handle) != EXTPTRSXP) || (R_ExternalPtrTag(handle) != install("multibitTreePool"))) {
+		error("invalid multibitTree thread pool handle");
 	}
 
-	sizePrints = size;
+	pool = (ThreadPool*) R_ExternalPtrAddr(handle);
 
-	// count number of prints in file
-	if (sizePrints == 0) {
-		in = fopen(filename, "r");
+	if (pool == NULL) {
+		error("multibitTree thread pool handle has been released");
+	}
 
-		if (in == NULL) {
-			return(0);
-		}
+	return pool;
+}
+
+// return the ids of all fingerprints of a grid handle in load order,
+// for a composite grid handle the ids of its records
+// the character vector is created on the first call and cached in the handle
+SEXP mbtGetIds(SEXP handle) {
+	SEXP fields;
+	SEXP ids;
+	RecordTable *records;
+	long long size;
+
+	if (mbtIsFieldHandle(handle)) {
+		records = mbtGetFieldGrid(handle)->getRecords();
+		size = mbtGetFieldGrid(handle)->getSize();
+	} else {
+		records = mbtGetGrid(handle)->getRecords();
+		size = mbtGetGrid(handle)->getSize();
+	}
 
-                while (fgets(str, STRSIZE, in)) {
-			sizePrints++;
+	fields = R_ExternalPtrProtected(handle);
+	ids = VECTOR_ELT(fields, HANDLE_IDS);
+
+	if (isNull(ids)) {
+		PROTECT(ids = allocVector(STRSXP, size));
+
+		for (long long i = 0; i < size; i++) {
+			SET_STRING_ELT(ids, i, (records->getId(i) != NULL) ? mkChar(records->getId(i)) : NA_STRING);
 		}
 
-		fclose(in);
+		SET_VECTOR_ELT(fields, HANDLE_IDS, ids);
+		UNPROTECT(1);
 	}
 
-	nBits = 0;
-        in = fopen(filename, "r");
+	return ids;
+}
 
-	if (in == NULL) {
-		return(0);
+// construct a new grid data structure for <sizePrints> prints of at most <nBits> bits
+// if <pool> is NULL, the grid gets its own ThreadPool with <threads> threads
+// that is NUMA-aware if <numa> is set
+// the engine of each cell is <engine> or chosen by the cost model
+// for searches with a Tanimoto filter of <planTanimoto>
+// if <tuner> is given, it chooses <leafLimit> and at most <threads> threads
+// if <blocks> is given, prints are only compared with queries of the same blocking key
+Grid1D *mbtBuildGrid(Fingerprint **prints, long long sizePrints, int nBits, int threads, int numa, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, Tuner *tuner, BlockKeys *blocks) {
+	if (tuner != NULL) {
+		if (pool != NULL) {
+			tuner->tune(prints, sizePrints, nBits, pool);
+		} else {
+			tuner->tune(prints, sizePrints, nBits, threads, numa);
+		}
+		leafLimit = tuner->getLeafLimit();
+		threads = tuner->getThreads();
 	}
 
-	// create array of Fingerprints
-        prints = new Fingerprint*[sizePrints];
+	if (pool != NULL) {
+		return(new Grid1D(prints, sizePrints, nBits, pool, leafLimit, dims, engine, planTanimoto, blocks));
+	}
 
-	// read prints from file
-        for (long long i = 0; i < sizePrints; i++) {
-		// parse line from file
-		fields = parseLine(in, str, &idx1, &end1, &idx2, &end2);
+	return(new Grid1D(prints, sizePrints, nBits, threads, numa, leafLimit, dims, engine, planTanimoto, blocks));
+}
 
-		if (fields == 0) {
-			sizePrints = i;
-			break;
-                }
-		
-		if (fields == 1) {
-			// if there is only one field, use line as id
-			idStr = new char[13];
-			sprintf(idStr, "%012" PRId64, i+1);
-			// create fingerprint
-			prints[i] = new Fingerprint(idStr, str+idx1);
+// construct a new grid data structure from the prints partitioned in <store>
+// and their ids in <records>, the grid keeps its cells in the files of <store>
+// the other arguments are those of mbtBuildGrid
+// if <tuner> is given, it is tuned on a sample read back from the partition
+Grid1D *mbtBuildStoredGrid(CellStore *store, RecordTable *records, int threads, int numa, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, Tuner *tuner, BlockKeys *blocks) {
+	if (tuner != NULL) {
+		Fingerprint **prints = new Fingerprint*[TUNE_SAMPLE_SIZE];
+		long long sizePrints = store->samplePartition(prints, TUNE_SAMPLE_SIZE);
+
+		if (pool != NULL) {
+			tuner->tune(prints, sizePrints, store->getPartitionBits(), pool);
 		} else {
-			// if there are two fields, use first string as id
-			idStr = new char[end1-idx1+1];
-			strcpy(idStr, str+idx1);
-			// create fingerprint
-			prints[i] = new Fingerprint(idStr, str+idx2);
+			tuner->tune(prints, sizePrints, store->getPartitionBits(), threads, numa);
 		}
+		leafLimit = tuner->getLeafLimit();
+		threads = tuner->getThreads();
 
-		// compute maximal length of Fingerprints
-                len = prints[i]->getLength();
-                if (len > nBits) {
-                        nBits = len;
-                }
-        }
-
-        fclose(in);
+		for (long long i = 0; i < sizePrints; i++) {
+			delete prints[i];
+		}
+		delete[] prints;
+	}
 
-	// build Grid1D data structure
-	grid = new Grid1D(prints, sizePrints, nBits, threads, leafLimit);
+	if (pool != NULL) {
+		return(new Grid1D(store, records, pool, leafLimit, dims, engine, planTanimoto, blocks));
+	}
 
-	return(sizePrints);
+	return(new Grid1D(store, records, threads, numa, leafLimit, dims, engine, planTanimoto, blocks));
 }
 
-// recursively copy QueryResults into R vectors for prints and tanimoto coefficients
-void insertQueryResultNodesRec(long long *idx, SEXP prints, double *tanimotosPtr, QueryResultNode *node, long long sizeResult) {
-	if ((node != NULL) && ((*idx) < sizeResult)) {
-		insertQueryResultNodesRec(idx, prints, tanimotosPtr, node->mLeft, sizeResult);
+// read input file and construct a new grid data structure
+// if <pool> is NULL, the grid gets its own ThreadPool with <threads> threads
+// that is NUMA-aware if <numa> is set
+// if <store> is given, the prints are partitioned into its directory
+// and the grid keeps its cells in the files of <store>
+// if <blocked> is set, each line holds a blocking key before the print
+// returns NULL if the file cannot be read
+Grid1D *mbtLoad(const char *filename, int threads, int numa, ThreadPool *pool, long long size, int leafLimit, int dims, int engine, float planTanimoto, Tuner *tuner, CellStore *store, int blocked) {
+	Fingerprint **prints;
+	long long sizePrints;
+	int nBits;
+	BlockKeys *blocks = NULL;
+
+	if (blocked) {
+		blocks = new BlockKeys();
+	}
+
+	if (store != NULL) {
+		RecordTable *records = new RecordTable();
 
-		SET_STRING_ELT(prints, *idx, mkChar(node->mPrint->getId()));
-		tanimotosPtr[*idx] = node->mTanimoto;		// copy tanimoto coefficent
+		if (partitionPrints(filename, size, store, records, &nBits, blocks) < 0) {
+			delete records;
+			delete blocks;
+			return(NULL);
+		}
 
-		(*idx)++;
+		return(mbtBuildStoredGrid(store, records, threads, numa, pool, leafLimit, dims, engine, planTanimoto, tuner, blocks));
+	}
 
-		insertQueryResultNodesRec(idx, prints, tanimotosPtr, node->mRight, sizeResult);
+	if (blocked) {
+		prints = readBlockedPrints(filename, size, &sizePrints, &nBits, blocks);
+	} else {
+		prints = readPrints(filename, size, &sizePrints, &nBits);
 	}
+
+	if (prints == NULL) {
+		delete blocks;
+		return(NULL);
+	}
+
+	return(mbtBuildGrid(prints, sizePrints, nBits, threads, numa, pool, leafLimit, dims, engine, planTanimoto, tuner, blocks));
 }
 
-// copy QueryResults into R vectors for prints and tanimoto coefficients
-void insertQueryResultNodes(long long *idx, SEXP prints, double *tanimotosPtr, QueryResultNode *node, long long sizeResult) {
-	while ((node != NULL) && ((*idx) < sizeResult)) {
+// allocate an R vector for <size> record numbers or, if <ids> is set, ids
+SEXP allocResultVector(long long size, int ids) {
+	return allocVector(ids ? STRSXP : INTSXP, size);
+}
+
+// copy QueryResults into R vectors for prints and scores
+// prints are stored as record numbers or, if <ids> is given, as ids
+// Hamming distances are restored from the negated scores
+void insertQueryResults(SEXP prints, double *tanimotosPtr, QueryResult *queryResult, long long sizeResult, SEXP ids) {
+	resultRecordType *records = queryResult->getRecords();
+	const measureType *measure = queryResult->getMeasure();
 
-		SET_STRING_ELT(prints, *idx, mkChar(node->mPrint->getId()));
-		tanimotosPtr[*idx] = node->mTanimoto;		// copy tanimoto coefficent
+	if (isNull(ids)) {
+		int *printsPtr = INTEGER(prints);
 
-		(*idx)++;
-		node = node->mRight;
+		for (long long i = 0; i < sizeResult; i++) {
+			printsPtr[i] = records[i].print + 1;
+			tanimotosPtr[i] = measureValue(measure, records[i].tanimoto);	// copy score
+		}
+	} else {
+		for (long long i = 0; i < sizeResult; i++) {
+			SET_STRING_ELT(prints, i, STRING_ELT(ids, records[i].print));
+			tanimotosPtr[i] = measureValue(measure, records[i].tanimoto);	// copy score
+		}
 	}
 }
 
-// copy QueryResults into R vectors for queries, prints and tanimoto coefficients
-void insertQueryResultNodesWithId(long long *idx, SEXP queries, SEXP prints, double *tanimotosPtr, QueryResultNode *node, long long sizeResult) {
-	while ((node != NULL) && ((*idx) < sizeResult)) {
-		SET_STRING_ELT(queries, *idx, mkChar(node->mQueryId));
-		SET_STRING_ELT(prints, *idx, mkChar(node->mPrint->getId()));
-		tanimotosPtr[*idx] = node->mTanimoto;		// copy tanimoto coefficent
+// copy QueryResults into R vectors for queries, prints and scores
+// queries and prints are stored as numbers or, if <ids> is given, as ids
+// query ids are taken from <queryIds> if it is given, otherwise the id of each
+// of the <sizeQueries> queries is converted only once
+void insertQueryResultsWithId(SEXP queries, SEXP prints, double *tanimotosPtr, QueryResult *queryResult, long long sizeResult, long long sizeQueries, SEXP ids, SEXP queryIds) {
+	resultRecordType *records = queryResult->getRecords();
+
+	insertQueryResults(prints, tanimotosPtr, queryResult, sizeResult, ids);
 
-		(*idx)++;
-		node = node->mRight;
+	if (isNull(ids)) {
+		int *queriesPtr = INTEGER(queries);
+
+		for (long long i = 0; i < sizeResult; i++) {
+			queriesPtr[i] = records[i].query + 1;
+		}
+		return;
 	}
+
+	if (!isNull(queryIds)) {
+		for (long long i = 0; i < sizeResult; i++) {
+			SET_STRING_ELT(queries, i, STRING_ELT(queryIds, records[i].query));
+		}
+		return;
+	}
+
+	// the ids of queries without results are never converted
+	PROTECT(queryIds = allocVector(STRSXP, sizeQueries));
+
+	for (long long i = 0; i < sizeQueries; i++) {
+		SET_STRING_ELT(queryIds, i, R_BlankString);
+	}
+
+	for (long long i = 0; i < sizeResult; i++) {
+		unsigned query = records[i].query;
+
+		if (STRING_ELT(queryIds, query) == R_BlankString) {
+			char *id = queryResult->getQueryId(query);
+
+			SET_STRING_ELT(queryIds, query, (id != NULL) ? mkChar(id) : NA_STRING);
+		}
+		SET_STRING_ELT(queries, i, STRING_ELT(queryIds, query));
+	}
+
+	UNPROTECT(1);
 }
 
 // call Grid1D::search and store results into vector of vectors
-SEXP mbtSearch(const char *query, double minTanimoto, long long size, int sort) {
+// <block> is the blocking key of the query, NULL if the grid is not blocked
+// <minTanimoto> is the threshold of <measure>, a maximal Hamming distance
+// if <size> is positive, only the <size> best results are kept while searching
+// prints are returned as record numbers or, if <ids> is given, as ids
+SEXP mbtSearch(Grid1D *grid, const char *query, const char *block, double minTanimoto, const measureType *measure, long long size, int sort, SEXP ids) {
 	SEXP result;
 	SEXP names;
 	SEXP prints;
 	SEXP tanimotos;
 	double *tanimotosPtr;
-	QueryResult queryResult(sort, NULL, NULL);
+	QueryResult queryResult(sort ? SORT_TANIMOTO : SORT_NONE, NULL, grid->getRecords(), grid->getThreads());
 	Fingerprint queryPrint(NULL, query);
-	long long idx;
 	long long sizeResult;
 
-	// call search-method
-	if (grid != NULL) {
-		grid->initStatistics();
-		grid->search(&queryResult, &queryPrint, minTanimoto);
-		grid->setSizeLastSearch(1);
+	// the heap for the limited results needs not be larger than the grid
+	if (size > 0) {
+		queryResult.setLimit((int) MIN(MIN(size, grid->getSize()), (long long) INT_MAX));
+	}
+
+	if (block != NULL) {
+		queryPrint.setBlock(grid->getBlockKeys()->find(block));
 	}
 
+	queryResult.setMeasure(measure);
+
+	// call search-method
+	grid->initStatistics();
+	grid->search(&queryResult, &queryPrint, measureValue(measure, minTanimoto));
+	grid->setSizeLastSearch(1);
+
+	queryResult.merge(grid->getWorkerPool());
+	grid->setResultMemory(&queryResult);
 	sizeResult = queryResult.getSize();
 
 	if (size > 0) {
@@ -280,17 +402,12 @@ SEXP mbtSearch(const char *query, double minTanimoto, long long size, int sort)
 	}
 
 	// allocate R data structures for result
-	PROTECT(prints = allocVector(STRSXP, sizeResult));
+	PROTECT(prints = allocResultVector(sizeResult, !isNull(ids)));
 	PROTECT(tanimotos = allocVector(REALSXP, sizeResult));
 	tanimotosPtr = REAL(tanimotos);
 
 	// copy result into R data structures
-	idx = 0;
-	if (sort) {
-		insertQueryResultNodesRec(&idx, prints, tanimotosPtr, queryResult.getRootNode(), sizeResult);
-	} else {
-		insertQueryResultNodes(&idx, prints, tanimotosPtr, queryResult.getRootNode(), sizeResult);
-	}
+	insertQueryResults(prints, tanimotosPtr, &queryResult, sizeResult, ids);
 
 	// allocate vector for the two result vectors
 	PROTECT(result = allocVector(VECSXP, 2));
@@ -302,7 +419,7 @@ SEXP mbtSearch(const char *query, double minTanimoto, long long size, int sort)
 	PROTECT(names = allocVector(STRSXP, 2));
 
 	SET_STRING_ELT(names, 0, mkChar("fingerprint"));
-	SET_STRING_ELT(names, 1, mkChar("tanimoto"));
+	SET_STRING_ELT(names, 1, mkChar(MEASURE_NAMES[measure->type]));
 	setAttrib(result, R_NamesSymbol, names);
 
 	UNPROTECT(4);
@@ -310,118 +427,438 @@ SEXP mbtSearch(const char *query, double minTanimoto, long long size, int sort)
 	return(result);
 }
 
-// call Grid1D::search for each fingerprint in file and store results into vector of vectors
-// if a result file is specified, write the results in to this file and return nothing to the R-function
-SEXP mbtSearchFile(const char *filename, double minTanimoto, const char *resultFile, const char *seperator) {
+// store the merged results of <sizeQueries> queries into vector of vectors
+// queries and prints are returned as numbers or, if <ids> is given, as ids
+// results divided into bands get a fourth vector with the band of each result
+SEXP mbtQueryResultList(QueryResult *queryResult, long long sizeQueries, SEXP ids, SEXP queryIds) {
 	SEXP result;
 	SEXP names;
 	SEXP queries;
 	SEXP prints;
 	SEXP tanimotos;
+	SEXP bands;
 	double *tanimotosPtr;
-	Fingerprint *queryPrint;
-	long long idx;
+	long long sizeResult = queryResult->getSize();
+	const bandsType *resultBands = queryResult->getBands();
+	int columns = (resultBands->count > 1) ? 4 : 3;
+
+	// allocate R data structures for result
+	PROTECT(queries = allocResultVector(sizeResult, !isNull(ids)));
+	PROTECT(prints = allocResultVector(sizeResult, !isNull(ids)));
+	PROTECT(tanimotos = allocVector(REALSXP, sizeResult));
+	tanimotosPtr = REAL(tanimotos);
+
+	// copy result into R data structures
+	insertQueryResultsWithId(queries, prints, tanimotosPtr, queryResult, sizeResult, sizeQueries, ids, queryIds);
+
+	// allocate vector for the result vectors
+	PROTECT(result = allocVector(VECSXP, columns));
+
+	SET_VECTOR_ELT(result, 0, queries);
+	SET_VECTOR_ELT(result, 1, prints);
+	SET_VECTOR_ELT(result, 2, tanimotos);
+
+	// set name attributes for the result vectors
+	PROTECT(names = allocVector(STRSXP, columns));
+
+	SET_STRING_ELT(names, 0, mkChar("query"));
+	SET_STRING_ELT(names, 1, mkChar("fingerprint"));
+	SET_STRING_ELT(names, 2, mkChar(MEASURE_NAMES[queryResult->getMeasure()->type]));
+
+	// bands are numbered in the order of their thresholds
+	if (columns == 4) {
+		resultRecordType *records = queryResult->getRecords();
+		int *bandsPtr;
+
+		bands = allocVector(INTSXP, sizeResult);
+		SET_VECTOR_ELT(result, 3, bands);
+		SET_STRING_ELT(names, 3, mkChar("band"));
+		bandsPtr = INTEGER(bands);
+
+		for (long long i = 0; i < sizeResult; i++) {
+			bandsPtr[i] = resultBands->labels[bandsFind(resultBands, records[i].tanimoto)] + 1;
+		}
+	}
+	setAttrib(result, R_NamesSymbol, names);
+
+	UNPROTECT(5);
+
+	return(result);
+}
+
+// call Grid1D::search for each fingerprint in file and store results into vector of vectors
+// if a result file is specified, write the results in to this file and return nothing to the R-function
+// the results are divided into <bands> of scores of <measure> with their limits per query,
+// the search uses the lowest threshold
+// if <sort> is set, results are ordered by query and descending score,
+// sorted results are collected in memory before they are written to the result file
+// the <files> result files hold all results or those of one band each
+// and are written as csv or in binary <format>
+// queries and prints are returned as line numbers or, if <ids> is given, as ids
+// returns NULL if the result file could not be written
+SEXP mbtSearchFile(Grid1D *grid, const char *filename, const bandsType *bands, const measureType *measure, const char **resultFiles, int files, const char *seperator, int sort, int format, SEXP ids) {
 	long long sizeResult;
 	FILE *in;
-	FILE *out = NULL;
-	char str[STRSIZE];
-	long long fields;
-	long long idx1, end1, idx2, end2;
+	ResultWriter *writer = NULL;
 	long long i;
-	char *idStr;
+	int status;
 
-	if ((resultFile != NULL) && (resultFile[0] != 0) && (seperator != NULL)) {
-		// if specified, open result file
-		out = fopen(resultFile, "w");
-		// print column headers
-		fprintf(out, "query%sfingerprint%stanimoto\n", seperator, seperator);
+	if ((resultFiles[0][0] != 0) && (seperator != NULL)) {
+		// if specified, open result files and write the headers
+		writer = new ResultWriter(resultFiles, files, format, seperator, grid->getRecords(), measure, bands);
+
+		if (!writer->isOpen()) {
+			delete writer;
+			error("could not open result file %s", resultFiles[0]);
+		}
 	}
 
-	QueryResult queryResult(0, out, seperator);
+	QueryResult queryResult(sort ? SORT_QUERY : SORT_NONE, sort ? NULL : writer, grid->getRecords(), grid->getThreads());
 
-	if (grid != NULL) {
-		grid->initStatistics();
-
-		// open input file
-		in = fopen(filename, "r");
-
-		if (in != NULL) {
-			i = 0;
-			while (1) {
-				// for each line parse fingerprint
-				fields = parseLine(in, str, &idx1, &end1, &idx2, &end2);
-				if (fields == 0) {
-					break;
-				}
-				
-				// create query fingerprint
-				if (fields == 1) {
-					// if there is only one field, use line as id
-					idStr = new char[13];
-					sprintf(idStr, "%012" PRId64, i+1);
-					// create fingerprint
-					queryPrint = new Fingerprint(idStr, str+idx1);
-				} else {
-					// if there are two fields, use first string as id
-					idStr = new char[end1-idx1+1];
-					strcpy(idStr, str+idx1);
-					// create fingerprint
-					queryPrint = new Fingerprint(idStr, str+idx2);
-				}
-
-				// call asychonous search-method
-				grid->searchAsync(&queryResult, queryPrint, minTanimoto);
-				i++;
-			}
+	queryResult.setBands(bands);
+	queryResult.setMeasure(measure);
+	grid->initStatistics();
 
-			grid->setSizeLastSearch(i);
-      
-			// wait for running threads
-			grid->wait();
-			fclose(in);
-		}
+	// search all prints of the input file
+	in = fopen(filename, "r");
+
+	i = 0;
+
+	if (in != NULL) {
+		i = grid->searchFile(&queryResult, in, bands->thresholds[0]);
+		fclose(in);
 	}
 
+	queryResult.finish();
+	queryResult.merge(grid->getWorkerPool());
 	sizeResult = queryResult.getSize();
 
-	if (out != NULL) {
+	if (writer != NULL) {
 		// if a result file was specified close it and return NULL
-		fclose(out);
-		return(R_NilValue);
+		if (sort) {
+			writer->submitRecords(&queryResult, queryResult.getRecords(), sizeResult);
+		}
+		status = writer->close();
+		delete writer;
+		grid->setResultMemory(&queryResult);
+
+		return((status == 0) ? R_NilValue : NULL);
 	}
 
-	// allocate R data structures for result
-	PROTECT(queries = allocVector(STRSXP, sizeResult));
-	PROTECT(prints = allocVector(STRSXP, sizeResult));
-	PROTECT(tanimotos = allocVector(REALSXP, sizeResult));
-	tanimotosPtr = REAL(tanimotos);
+	grid->setResultMemory(&queryResult);
 
-	// copy result into R data structures
-	idx = 0;
-	insertQueryResultNodesWithId(&idx, queries, prints, tanimotosPtr, queryResult.getRootNode(), sizeResult);
+	return(mbtQueryResultList(&queryResult, i, ids, R_NilValue));
+}
 
-	// allocate vector for the three result vectors
-	PROTECT(result = allocVector(VECSXP, 3));
+// get number of fingerprints in <prints>, raise an R error if it is neither
+// a character vector nor a raw or logical matrix with one fingerprint per row
+long long mbtCountPrints(SEXP prints) {
+	if (TYPEOF(prints) == STRSXP) {
+		return XLENGTH(prints);
+	}
 
-	SET_VECTOR_ELT(result, 0, queries);
-	SET_VECTOR_ELT(result, 1, prints);
-	SET_VECTOR_ELT(result, 2, tanimotos);
+	if (((TYPEOF(prints) != RAWSXP) && (TYPEOF(prints) != LGLSXP)) || !isMatrix(prints)) {
+		error("fingerprints must be a character vector or a raw or logical matrix");
+	}
 
-	// set name attributes for the two result vectors
-	PROTECT(names = allocVector(STRSXP, 3));
+	return nrows(prints);
+}
 
-	SET_STRING_ELT(names, 0, mkChar("query"));
-	SET_STRING_ELT(names, 1, mkChar("fingerprint"));
-	SET_STRING_ELT(names, 2, mkChar("tanimoto"));
-	setAttrib(result, R_NamesSymbol, names);
+// replace the bits of <print> by fingerprint <i> of <prints>
+// a raw matrix holds 8 bits per byte, lowest bit first,
+// a logical matrix one bit per column
+void mbtCopyPrint(Fingerprint *print, SEXP prints, long long i) {
+	long long rows;
+	int columns;
 
-	UNPROTECT(5);
+	if (TYPEOF(prints) == STRSXP) {
+		print->parse(CHAR(STRING_ELT(prints, i)));
+		return;
+	}
 
-	return(result);
+	// matrices are stored column by column
+	rows = nrows(prints);
+	columns = ncols(prints);
+
+	if (TYPEOF(prints) == RAWSXP) {
+		Rbyte *bytes = RAW(prints) + i;
+
+		print->reset(8 * columns);
+
+		for (int j = 0; j < columns; j++) {
+			if (bytes[j * rows] != 0) {
+				print->setByte(j, bytes[j * rows]);
+			}
+		}
+	} else {
+		int *bits = LOGICAL(prints) + i;
+
+		print->reset(columns);
+
+		for (int j = 0; j < columns; j++) {
+			if (bits[j * rows] == 1) {
+				print->setBit(j);
+			}
+		}
+	}
+
+	print->fold();
+}
+
+// call Grid1D::searchAsync for each fingerprint in <queries> and store results into vector of vectors
+// <queries> is a character vector or a raw or logical matrix
+// <minTanimoto> is the threshold of <measure>, a maximal Hamming distance
+// if <sort> is set, results are ordered by query and descending score
+// if <maxResults> is positive, only the <maxResults> best results of each query are kept while searching
+// queries and prints are returned as numbers or, if <ids> is given, as ids,
+// query ids are taken from <queryIds>, blocking keys from <queryBlocks> if the grid is blocked
+SEXP mbtSearchQueries(Grid1D *grid, SEXP queries, SEXP queryIds, SEXP queryBlocks, double minTanimoto, const measureType *measure, int sort, int maxResults, SEXP ids) {
+	long long sizeQueries = mbtCountPrints(queries);
+	QueryResult queryResult(sort ? SORT_QUERY : SORT_NONE, NULL, grid->getRecords(), grid->getThreads());
+	QueryPool queryPool(QUERY_POOL_SIZE);
+	Fingerprint *queryPrint;
+
+	if (maxResults > 0) {
+		queryResult.setLimit((int) MIN((long long) maxResults, grid->getSize()));
+	}
+
+	queryResult.setMeasure(measure);
+	grid->initStatistics();
+
+	for (long long i = 0; i < sizeQueries; i++) {
+		// re-use query fingerprint of a completed query
+		queryPrint = queryPool.acquire(i);
+		mbtCopyPrint(queryPrint, queries, i);
+
+		if (!isNull(queryBlocks)) {
+			queryPrint->setBlock(grid->getBlockKeys()->find(CHAR(STRING_ELT(queryBlocks, i))));
+		}
+
+		// call asychonous search-method
+		grid->searchAsync(&queryResult, queryPrint, measureValue(measure, minTanimoto), &queryPool);
+	}
+
+	grid->setSizeLastSearch(sizeQueries);
+
+	// wait for running threads
+	grid->wait();
+
+	queryResult.finish();
+	queryResult.merge(grid->getWorkerPool());
+	grid->setResultMemory(&queryResult);
+
+	return(mbtQueryResultList(&queryResult, sizeQueries, ids, queryIds));
+}
+
+// call CompositeGrid::searchAsync for each record of <queries> and store results into vector of vectors
+// <queries> is a list with one character vector or raw or logical matrix per field
+// the queries are searched in blocks, so only a block of them is copied at a time
+// sorting, limits and ids are handled like in mbtSearchQueries
+SEXP mbtSearchFields(CompositeGrid *grid, SEXP queries, SEXP queryIds, double minScore, int sort, int maxResults, SEXP ids) {
+	int nFields = grid->getFields();
+	long long sizeQueries = mbtCountPrints(VECTOR_ELT(queries, 0));
+	QueryResult queryResult(sort ? SORT_QUERY : SORT_NONE, NULL, grid->getRecords(), grid->getThreads());
+	Fingerprint **block = new Fingerprint*[FIELD_BLOCK_SIZE * nFields];
+	long long blockStart;
+	int blockSize;
+
+	if (maxResults > 0) {
+		queryResult.setLimit((int) MIN((long long) maxResults, grid->getSize()));
+	}
+
+	for (int j = 0; j < FIELD_BLOCK_SIZE * nFields; j++) {
+		block[j] = new Fingerprint(0);
+	}
+
+	grid->initStatistics();
+
+	for (blockStart = 0; blockStart < sizeQueries; blockStart += blockSize) {
+		blockSize = (int) MIN((long long) FIELD_BLOCK_SIZE, sizeQueries - blockStart);
+
+		for (int j = 0; j < blockSize; j++) {
+			for (int f = 0; f < nFields; f++) {
+				mbtCopyPrint(block[j * nFields + f], VECTOR_ELT(queries, f), blockStart + j);
+			}
+			block[j * nFields]->setIndex(blockStart + j);
+
+			// call asychonous search-method
+			grid->searchAsync(&queryResult, &block[j * nFields], minScore);
+		}
+
+		// wait for running threads before the block is re-used
+		grid->wait();
+	}
+
+	grid->setSizeLastSearch(sizeQueries);
+
+	for (int j = 0; j < FIELD_BLOCK_SIZE * nFields; j++) {
+		delete block[j];
+	}
+	delete[] block;
+
+	queryResult.finish();
+	queryResult.merge(grid->getWorkerPool());
+
+	return(mbtQueryResultList(&queryResult, sizeQueries, ids, queryIds));
+}
+
+// check that <prints> is a list of 1 to MAX_FIELDS fields with the same number of
+// fingerprints each and return this number, raise an R error otherwise
+long long mbtCountFields(SEXP prints) {
+	long long size;
+
+	if ((TYPEOF(prints) != VECSXP) || (XLENGTH(prints) < 1) || (XLENGTH(prints) > MAX_FIELDS)) {
+		error("fields must be a list of 1 to %d fingerprint vectors or matrices", MAX_FIELDS);
+	}
+
+	size = mbtCountPrints(VECTOR_ELT(prints, 0));
+
+	for (int f = 1; f < XLENGTH(prints); f++) {
+		if (mbtCountPrints(VECTOR_ELT(prints, f)) != size) {
+			error("all fields must have the same number of fingerprints");
+		}
+	}
+
+	return size;
+}
+
+// construct a new composite grid from <prints>, a list with one character vector
+// or raw or logical matrix per field, the ids in <ids> and the field <weights>
+// if <ids> is NULL, records are numbered like the lines of an input file
+CompositeGrid *mbtLoadFields(SEXP prints, SEXP ids, const double *weights, int threads, ThreadPool *pool) {
+	long long sizePrints = mbtCountFields(prints);
+	int nFields = XLENGTH(prints);
+	Fingerprint ***fields = new Fingerprint**[nFields];
+	int nBits[MAX_FIELDS];
+	CompositeGrid *grid;
+	char *idStr;
+
+	// initialize Fingerprint data structure (cardinality-map)
+	Fingerprint::init();
+
+	for (int f = 0; f < nFields; f++) {
+		fields[f] = new Fingerprint*[sizePrints];
+		nBits[f] = 0;
+
+		for (long long i = 0; i < sizePrints; i++) {
+			fields[f][i] = new Fingerprint(0);
+			mbtCopyPrint(fields[f][i], VECTOR_ELT(prints, f), i);
+
+			// compute maximal length of each field
+			nBits[f] = MAX(nBits[f], fields[f][i]->getLength());
+		}
+	}
+
+	// the ids are kept by the first field
+	for (long long i = 0; i < sizePrints; i++) {
+		if (isNull(ids)) {
+			idStr = new char[21];
+			sprintf(idStr, "%012lld", i+1);
+		} else {
+			idStr = new char[strlen(CHAR(STRING_ELT(ids, i))) + 1];
+			strcpy(idStr, CHAR(STRING_ELT(ids, i)));
+		}
+		fields[0][i]->setId(idStr);
+	}
+
+	if (pool != NULL) {
+		grid = new CompositeGrid(fields, nFields, sizePrints, nBits, weights, pool);
+	} else {
+		grid = new CompositeGrid(fields, nFields, sizePrints, nBits, weights, threads);
+	}
+
+	// the grid owns the arrays of the fields
+	delete[] fields;
+
+	return grid;
+}
+
+// construct a new grid data structure from <prints>, a character vector
+// or a raw or logical matrix, and the ids in <ids>
+// if <ids> is NULL, prints are numbered like the lines of an input file
+// if <blocks> is given, it holds the blocking key of each print
+// if <store> is given, the prints are partitioned into its directory
+// and the grid keeps its cells in the files of <store>
+Grid1D *mbtLoadPrints(SEXP prints, SEXP ids, SEXP blocks, int threads, int numa, ThreadPool *pool, int leafLimit, int dims, int engine, float planTanimoto, Tuner *tuner, CellStore *store) {
+	long long sizePrints = mbtCountPrints(prints);
+	BlockKeys *blockKeys = isNull(blocks) ? NULL : new BlockKeys();
+	Fingerprint **printArray;
+	int nBits = 0;
+	char *idStr;
+
+	// initialize Fingerprint data structure (cardinality-map)
+	Fingerprint::init();
+
+	if (store != NULL) {
+		RecordTable *records = new RecordTable();
+		Fingerprint print(0);
+		char number[21];
+		int ok;
+
+		// first pass: ids, blocking keys and the prints of each cardinality
+		for (long long i = 0; i < sizePrints; i++) {
+			mbtCopyPrint(&print, prints, i);
+
+			if (isNull(ids)) {
+				sprintf(number, "%012lld", i+1);
+				records->add(number);
+			} else {
+				records->add(CHAR(STRING_ELT(ids, i)));
+			}
+
+			if (blockKeys != NULL) {
+				blockKeys->add(CHAR(STRING_ELT(blocks, i)));
+			}
+			store->countPrint(&print);
+		}
+
+		// second pass: write each print to the partition
+		ok = store->openPartition();
+
+		for (long long i = 0; ok && (i < sizePrints); i++) {
+			mbtCopyPrint(&print, prints, i);
+			print.setIndex(i);
+			print.setBlock((blockKeys != NULL) ? blockKeys->find(CHAR(STRING_ELT(blocks, i))) : 0);
+			ok = store->partitionPrint(&print);
+		}
+
+		if (!ok) {
+			delete records;
+			delete blockKeys;
+			return(NULL);
+		}
+
+		return(mbtBuildStoredGrid(store, records, threads, numa, pool, leafLimit, dims, engine, planTanimoto, tuner, blockKeys));
+	}
+
+	printArray = new Fingerprint*[sizePrints];
+
+	for (long long i = 0; i < sizePrints; i++) {
+		printArray[i] = new Fingerprint(0);
+		mbtCopyPrint(printArray[i], prints, i);
+
+		if (isNull(ids)) {
+			idStr = new char[21];
+			sprintf(idStr, "%012lld", i+1);
+		} else {
+			idStr = new char[strlen(CHAR(STRING_ELT(ids, i))) + 1];
+			strcpy(idStr, CHAR(STRING_ELT(ids, i)));
+		}
+		printArray[i]->setId(idStr);
+
+		if (blockKeys != NULL) {
+			printArray[i]->setBlock(blockKeys->add(CHAR(STRING_ELT(blocks, i))));
+		}
+
+		// compute maximal length of Fingerprints
+		nBits = MAX(nBits, printArray[i]->getLength());
+	}
+
+	return(mbtBuildGrid(printArray, sizePrints, nBits, threads, numa, pool, leafLimit, dims, engine, planTanimoto, tuner, blockKeys));
 }
 
 // call Grid1D::getStatistics
-SEXP mbtStatistics() {
+SEXP mbtStatistics(Grid1D *grid) {
 	SEXP result;
 	SEXP names;
 	SEXP values;
@@ -431,20 +868,24 @@ SEXP mbtStatistics() {
 	double *valuesPtr;
 	double *percentsPtr;
 
-	PROTECT(params = allocVector(STRSXP, 3));
-	PROTECT(values = allocVector(REALSXP, 3));
-	PROTECT(percents = allocVector(REALSXP, 3));
+	PROTECT(params = allocVector(STRSXP, STATISTICS_SIZE));
+	PROTECT(values = allocVector(REALSXP, STATISTICS_SIZE));
+	PROTECT(percents = allocVector(REALSXP, STATISTICS_SIZE));
 
 	valuesPtr = REAL(values);
 	percentsPtr = REAL(percents);
 
-	if (grid != NULL) {
-		grid->getStatistics(valuesPtr, percentsPtr);
-	}
+	grid->getStatistics(valuesPtr, percentsPtr);
 
 	SET_STRING_ELT(params, 0, mkChar("XOR-Hash"));
 	SET_STRING_ELT(params, 1, mkChar("Tanimoto"));
-	SET_STRING_ELT(params, 2, mkChar("Total"));
+	SET_STRING_ELT(params, 2, mkChar("Skipped cells"));
+	SET_STRING_ELT(params, 3, mkChar("Skipped prints"));
+	SET_STRING_ELT(params, 4, mkChar("Total"));
+	SET_STRING_ELT(params, 5, mkChar("Scanned cells"));
+	SET_STRING_ELT(params, 6, mkChar("Predicted tree cost"));
+	SET_STRING_ELT(params, 7, mkChar("Predicted scan cost"));
+	SET_STRING_ELT(params, 8, mkChar("Predicted cost"));
 
 	PROTECT(result = allocVector(VECSXP, 3));
 
@@ -465,81 +906,639 @@ SEXP mbtStatistics() {
 	return(result);
 }
 
+// call Grid1D::getMemory
+// the free bytes kept by the allocator are returned as attribute "heapFree", NA if unknown
+SEXP mbtMemory(Grid1D *grid) {
+	SEXP result;
+	SEXP names;
+	SEXP components;
+	SEXP bytes;
+	SEXP overhead;
+	SEXP allocations;
+	memoryReportType report;
+	long long heapFree = memoryHeapFree();
+
+	memoryInit(&report);
+	grid->getMemory(&report);
+
+	PROTECT(components = allocVector(STRSXP, MEMORY_COMPONENTS));
+	PROTECT(bytes = allocVector(REALSXP, MEMORY_COMPONENTS));
+	PROTECT(overhead = allocVector(REALSXP, MEMORY_COMPONENTS));
+	PROTECT(allocations = allocVector(REALSXP, MEMORY_COMPONENTS));
+
+	for (int c = 0; c < MEMORY_COMPONENTS; c++) {
+		SET_STRING_ELT(components, c, mkChar(MEMORY_NAMES[c]));
+		REAL(bytes)[c] = (double) report.bytes[c];
+		REAL(overhead)[c] = (double) report.overhead[c];
+		REAL(allocations)[c] = (double) report.allocations[c];
+	}
+
+	PROTECT(result = allocVector(VECSXP, 4));
+
+	SET_VECTOR_ELT(result, 0, components);
+	SET_VECTOR_ELT(result, 1, bytes);
+	SET_VECTOR_ELT(result, 2, overhead);
+	SET_VECTOR_ELT(result, 3, allocations);
+
+	PROTECT(names = allocVector(STRSXP, 4));
+
+	SET_STRING_ELT(names, 0, mkChar("Component"));
+	SET_STRING_ELT(names, 1, mkChar("Bytes"));
+	SET_STRING_ELT(names, 2, mkChar("Overhead"));
+	SET_STRING_ELT(names, 3, mkChar("Allocations"));
+	setAttrib(result, R_NamesSymbol, names);
+
+	setAttrib(result, install("heapFree"), ScalarReal((heapFree >= 0) ? (double) heapFree : NA_REAL));
+	setAttrib(result, install("prints"), ScalarReal((double) grid->getSize()));
+
+	UNPROTECT(6);
+
+	return(result);
+}
+
+// wrapper for R-function mbtThreadPoolCall
+SEXP mbtThreadPoolCall(SEXP threads, SEXP numa) {
+	SEXP result;
+
+	PROTECT(threads = AS_INTEGER(threads));
+	PROTECT(numa = AS_INTEGER(numa));
+
+	if (INTEGER_POINTER(threads)[0] < 1) {
+		error("number of threads must be positive");
+	}
+
+	PROTECT(result = R_MakeExternalPtr(new ThreadPool(INTEGER_POINTER(threads)[0], INTEGER_POINTER(numa)[0]), install("multibitTreePool"), R_NilValue));
+	R_RegisterCFinalizerEx(result, mbtFreeThreadPool, TRUE);
+
+	UNPROTECT(3);
+
+	return(result);
+}
+
+// create a handle for <grid>
+// a shared <pool> is kept in the protected field of the handle,
+// so it cannot be garbage-collected before the grid
+SEXP mbtMakeHandle(Grid1D *grid, SEXP pool) {
+	SEXP result;
+	SEXP sizeAttr;
+	SEXP fields;
+
+	PROTECT(fields = allocVector(VECSXP, HANDLE_FIELDS));
+	SET_VECTOR_ELT(fields, HANDLE_POOL, pool);
+
+	PROTECT(result = R_MakeExternalPtr(grid, install("multibitTree"), fields));
+	R_RegisterCFinalizerEx(result, mbtUnload, TRUE);
+
+	// attach number of loaded prints
+	PROTECT(sizeAttr = ScalarReal((double) grid->getSize()));
+	setAttrib(result, install("size"), sizeAttr);
+
+	UNPROTECT(3);
+
+	return(result);
+}
+
+// attach the parameters chosen by <tuner> and its measurements to <handle>
+void mbtSetTuning(SEXP handle, Tuner *tuner) {
+	SEXP tuning;
+	SEXP measurements;
+	SEXP names;
+	SEXP leafLimits;
+	SEXP threads;
+	SEXP throughput;
+	tuneMeasurementType *measurement = tuner->getMeasurements();
+	int count = tuner->getMeasurementCount();
+
+	PROTECT(leafLimits = allocVector(INTSXP, count));
+	PROTECT(threads = allocVector(INTSXP, count));
+	PROTECT(throughput = allocVector(REALSXP, count));
+
+	for (int i = 0; i < count; i++) {
+		INTEGER(leafLimits)[i] = measurement[i].leafLimit;
+		INTEGER(threads)[i] = measurement[i].threads;
+		REAL(throughput)[i] = measurement[i].queriesPerSecond;
+	}
+
+	PROTECT(measurements = allocVector(VECSXP, 3));
+	SET_VECTOR_ELT(measurements, 0, leafLimits);
+	SET_VECTOR_ELT(measurements, 1, threads);
+	SET_VECTOR_ELT(measurements, 2, throughput);
+
+	PROTECT(names = allocVector(STRSXP, 3));
+	SET_STRING_ELT(names, 0, mkChar("leafLimit"));
+	SET_STRING_ELT(names, 1, mkChar("threads"));
+	SET_STRING_ELT(names, 2, mkChar("queriesPerSecond"));
+	setAttrib(measurements, R_NamesSymbol, names);
+
+	PROTECT(tuning = allocVector(VECSXP, 3));
+	SET_VECTOR_ELT(tuning, 0, ScalarInteger(tuner->getLeafLimit()));
+	SET_VECTOR_ELT(tuning, 1, ScalarInteger(tuner->getThreads()));
+	SET_VECTOR_ELT(tuning, 2, measurements);
+
+	PROTECT(names = allocVector(STRSXP, 3));
+	SET_STRING_ELT(names, 0, mkChar("leafLimit"));
+	SET_STRING_ELT(names, 1, mkChar("threads"));
+	SET_STRING_ELT(names, 2, mkChar("measurements"));
+	setAttrib(tuning, R_NamesSymbol, names);
+
+	setAttrib(handle, install("tuning"), tuning);
+
+	UNPROTECT(7);
+}
+
+// check the load parameters <dims>, <engine>, <planTanimoto> and <threads>
+// and return the ThreadPool of the handle <pool>, NULL if no pool is given
+ThreadPool *mbtCheckLoadParameters(SEXP threads, SEXP pool, SEXP dims, SEXP engine, SEXP planTanimoto) {
+	if ((INTEGER_POINTER(dims)[0] < 1) || (INTEGER_POINTER(dims)[0] > MAX_DIMS)) {
+		error("dims must be between 1 and %d", MAX_DIMS);
+	}
+
+	if ((INTEGER_POINTER(engine)[0] < ENGINE_AUTO) || (INTEGER_POINTER(engine)[0] > ENGINE_SCAN)) {
+		error("engine must be \"auto\", \"tree\" or \"scan\"");
+	}
+
+	if (!(REAL(planTanimoto)[0] > 0) || (REAL(planTanimoto)[0] > 1)) {
+		error("planTanimoto must be greater than 0 and at most 1");
+	}
+
+	if (!isNull(pool)) {
+		return mbtGetThreadPool(pool);
+	}
+
+	if (INTEGER_POINTER(threads)[0] < 1) {
+		error("number of threads must be positive");
+	}
+
+	return NULL;
+}
+
+// raise an R error if <storage> is neither NULL nor a single directory name
+// or <residentMemory> is not positive
+void mbtCheckStorage(SEXP storage, SEXP residentMemory) {
+	if (isNull(storage)) {
+		return;
+	}
+
+	if ((TYPEOF(storage) != STRSXP) || (XLENGTH(storage) != 1)) {
+		error("storage must be a single directory name");
+	}
+
+	if (!(REAL(residentMemory)[0] > 0)) {
+		error("residentMemory must be positive");
+	}
+}
+
+// create the CellStore for a grid below the directory <storage>
+// that maps at most <residentMemory> megabytes of cell files
+// return NULL if <storage> is NULL
+CellStore *mbtMakeStore(SEXP storage, SEXP residentMemory) {
+	CellStore *store;
+
+	if (isNull(storage)) {
+		return NULL;
+	}
+
+	store = new CellStore(CHAR(STRING_ELT(storage, 0)), (long long) (REAL(residentMemory)[0] * (1 << 20)));
+
+	if (!store->isOpen()) {
+		delete store;
+		error("cannot create cell files in '%s'", CHAR(STRING_ELT(storage, 0)));
+	}
+
+	return store;
+}
+
+// raise an R error if prints could not be read back from the partition
+// in <storage> while <grid> was built, <grid> and <tuner> are freed then
+void mbtCheckPartition(Grid1D *grid, Tuner *tuner, SEXP storage) {
+	long long failures = (grid->getStore() != NULL) ? grid->getStore()->getFailures() : 0;
+
+	if (failures > 0) {
+		delete grid;
+		delete tuner;
+		error("%lld reads of the prints in '%s' failed", failures, CHAR(STRING_ELT(storage, 0)));
+	}
+}
+
 // wrapper for R-function mbtLoadCall
-SEXP mbtLoadCall(SEXP filename, SEXP threads, SEXP size, SEXP leafLimit) {
+SEXP mbtLoadCall(SEXP filename, SEXP threads, SEXP size, SEXP leafLimit, SEXP pool, SEXP dims, SEXP numa, SEXP engine, SEXP planTanimoto, SEXP tune, SEXP storage, SEXP residentMemory, SEXP blocked) {
 	SEXP result;
-	int *resultPtr;
+	Grid1D *grid;
+	ThreadPool *threadPool;
+	Tuner *tuner = NULL;
+	CellStore *store;
 
 	PROTECT(filename = AS_CHARACTER(filename));
 	PROTECT(threads = AS_INTEGER(threads));
 	PROTECT(size = AS_INTEGER(size));
 	PROTECT(leafLimit = AS_INTEGER(leafLimit));
+	PROTECT(dims = AS_INTEGER(dims));
+	PROTECT(numa = AS_INTEGER(numa));
+	PROTECT(engine = AS_INTEGER(engine));
+	PROTECT(planTanimoto = AS_NUMERIC(planTanimoto));
+	PROTECT(tune = AS_INTEGER(tune));
+	PROTECT(residentMemory = AS_NUMERIC(residentMemory));
+	PROTECT(blocked = AS_INTEGER(blocked));
+
+	// all arguments are checked before the store and the tuner are allocated,
+	// an R error would leak them
+	threadPool = mbtCheckLoadParameters(threads, pool, dims, engine, planTanimoto);
+	mbtCheckStorage(storage, residentMemory);
+
+	store = mbtMakeStore(storage, residentMemory);
+
+	if (INTEGER_POINTER(tune)[0]) {
+		tuner = new Tuner(INTEGER_POINTER(dims)[0], INTEGER_POINTER(engine)[0], REAL(planTanimoto)[0]);
+	}
+
+	grid = mbtLoad(CHAR(STRING_ELT(filename, 0)), INTEGER_POINTER(threads)[0], INTEGER_POINTER(numa)[0], threadPool, INTEGER_POINTER(size)[0], INTEGER_POINTER(leafLimit)[0], INTEGER_POINTER(dims)[0], INTEGER_POINTER(engine)[0], REAL(planTanimoto)[0], tuner, store, INTEGER_POINTER(blocked)[0]);
 
-	PROTECT(result = NEW_INTEGER(1));
-	resultPtr = INTEGER_POINTER(result);
+	if (grid == NULL) {
+		delete tuner;
+		delete store;
+		error("cannot open file '%s'", CHAR(STRING_ELT(filename, 0)));
+	}
 
-	resultPtr[0] = mbtLoad(CHAR(STRING_ELT(filename, 0)), INTEGER_POINTER(threads)[0], INTEGER_POINTER(size)[0], INTEGER_POINTER(leafLimit)[0]);
+	mbtCheckPartition(grid, tuner, storage);
 
-	UNPROTECT(5);
+	PROTECT(result = mbtMakeHandle(grid, pool));
+
+	if (tuner != NULL) {
+		mbtSetTuning(result, tuner);
+		delete tuner;
+	}
+
+	UNPROTECT(12);
+
+	return(result);
+}
+
+// wrapper for R-function mbtLoadPrintsCall
+SEXP mbtLoadPrintsCall(SEXP prints, SEXP ids, SEXP threads, SEXP leafLimit, SEXP pool, SEXP dims, SEXP numa, SEXP engine, SEXP planTanimoto, SEXP tune, SEXP storage, SEXP residentMemory, SEXP blocks) {
+	SEXP result;
+	Grid1D *grid;
+	ThreadPool *threadPool;
+	Tuner *tuner = NULL;
+	CellStore *store;
+	long long count;
+
+	PROTECT(threads = AS_INTEGER(threads));
+	PROTECT(leafLimit = AS_INTEGER(leafLimit));
+	PROTECT(dims = AS_INTEGER(dims));
+	PROTECT(numa = AS_INTEGER(numa));
+	PROTECT(engine = AS_INTEGER(engine));
+	PROTECT(planTanimoto = AS_NUMERIC(planTanimoto));
+	PROTECT(tune = AS_INTEGER(tune));
+	PROTECT(residentMemory = AS_NUMERIC(residentMemory));
+
+	// all arguments are checked before the store and the tuner are allocated,
+	// an R error would leak them
+	threadPool = mbtCheckLoadParameters(threads, pool, dims, engine, planTanimoto);
+	mbtCheckStorage(storage, residentMemory);
+	count = mbtCountPrints(prints);
+
+	if (!isNull(ids) && ((TYPEOF(ids) != STRSXP) || (XLENGTH(ids) != count))) {
+		error("ids must be a character vector with one id per fingerprint");
+	}
+
+	if (!isNull(blocks) && ((TYPEOF(blocks) != STRSXP) || (XLENGTH(blocks) != count))) {
+		error("blocks must be a character vector with one blocking key per fingerprint");
+	}
+
+	store = mbtMakeStore(storage, residentMemory);
+
+	if (INTEGER_POINTER(tune)[0]) {
+		tuner = new Tuner(INTEGER_POINTER(dims)[0], INTEGER_POINTER(engine)[0], REAL(planTanimoto)[0]);
+	}
+
+	grid = mbtLoadPrints(prints, ids, blocks, INTEGER_POINTER(threads)[0], INTEGER_POINTER(numa)[0], threadPool, INTEGER_POINTER(leafLimit)[0], INTEGER_POINTER(dims)[0], INTEGER_POINTER(engine)[0], REAL(planTanimoto)[0], tuner, store);
+
+	if (grid == NULL) {
+		delete tuner;
+		delete store;
+		error("cannot write the prints to '%s'", CHAR(STRING_ELT(storage, 0)));
+	}
+
+	mbtCheckPartition(grid, tuner, storage);
+	PROTECT(result = mbtMakeHandle(grid, pool));
+
+	if (tuner != NULL) {
+		mbtSetTuning(result, tuner);
+		delete tuner;
+	}
+
+	UNPROTECT(9);
 
 	return(result);
 }
 
+// get number of failed reads of the cell files of <grid>
+long long mbtStoreFailures(Grid1D *grid) {
+	return (grid->getStore() != NULL) ? grid->getStore()->getFailures() : 0;
+}
+
+// raise an R error if searches in cells of <grid> failed since there were <failures>
+// the results of such searches are incomplete
+void mbtCheckStore(Grid1D *grid, long long failures) {
+	failures = mbtStoreFailures(grid) - failures;
+
+	if (failures > 0) {
+		error("%lld searches in cell files failed, the results are incomplete", failures);
+	}
+}
+
+// check that <blocks> holds <size> blocking keys if <grid> is blocked
+// and is NULL otherwise, raise an R error if not
+void mbtCheckBlocks(Grid1D *grid, SEXP blocks, long long size) {
+	if (grid->getBlockKeys() == NULL) {
+		if (!isNull(blocks)) {
+			error("multibitTree has no blocking keys");
+		}
+	} else if ((TYPEOF(blocks) != STRSXP) || (XLENGTH(blocks) != size)) {
+		error("blocking keys must be a character vector with one key per query");
+	}
+}
+
+// read the measure of a search from <measure>, a numeric vector with the number
+// of the measure and the Tversky weights alpha and beta, into <result>
+// and check it together with the threshold <minTanimoto>
+void mbtGetMeasure(SEXP measure, double minTanimoto, measureType *result) {
+	PROTECT(measure = AS_NUMERIC(measure));
+
+	if ((XLENGTH(measure) != 3) || !(REAL(measure)[0] >= 0) || (REAL(measure)[0] >= MEASURES)) {
+		error("measure must be one of tanimoto, dice, tversky or hamming");
+	}
+
+	result->type = (int) REAL(measure)[0];
+	result->alpha = REAL(measure)[1];
+	result->beta = REAL(measure)[2];
+
+	UNPROTECT(1);
+
+	if ((result->type == MEASURE_TVERSKY) && (!(result->alpha >= 0) || !(result->beta >= 0) || !(result->alpha + result->beta > 0))) {
+		error("alpha and beta must not be negative and not both 0");
+	}
+
+	if ((result->type == MEASURE_HAMMING) && !(minTanimoto >= 0)) {
+		error("the maximal Hamming distance must not be negative");
+	}
+}
+
+// read the thresholds <minTanimoto> of the bands of a search with <measure> and
+// the limits per query <maxResults>, one for all or one per band, into <bands>
+// the limits are at most <size>, the measure is read into <result>
+void mbtGetBands(SEXP minTanimoto, SEXP maxResults, SEXP measure, long long size, measureType *result, bandsType *bands) {
+	int count = XLENGTH(minTanimoto);
+	float thresholds[MAX_BANDS];
+	int limits[MAX_BANDS];
+
+	if ((count < 1) || (count > MAX_BANDS)) {
+		error("minTanimoto must hold 1 to %d thresholds", MAX_BANDS);
+	}
+
+	if ((XLENGTH(maxResults) != 1) && (XLENGTH(maxResults) != count)) {
+		error("maxResultsPerQuery must be one limit or one per threshold");
+	}
+
+	for (int i = 0; i < count; i++) {
+		int limit = INTEGER(maxResults)[(XLENGTH(maxResults) == 1) ? 0 : i];
+
+		mbtGetMeasure(measure, REAL(minTanimoto)[i], result);
+		thresholds[i] = measureValue(result, REAL(minTanimoto)[i]);
+		limits[i] = (limit > 0) ? (int) MIN((long long) limit, size) : 0;
+	}
+
+	bandsInit(bands, count, thresholds, limits);
+}
+
 // wrapper for R-function mbtSearchCall
-SEXP mbtSearchCall(SEXP query, SEXP minTanimoto, SEXP size, SEXP sort) {
+SEXP mbtSearchCall(SEXP handle, SEXP query, SEXP minTanimoto, SEXP size, SEXP sort, SEXP ids, SEXP block, SEXP measure) {
 	SEXP result;
+	Grid1D *grid = mbtGetGrid(handle);
+	long long failures = mbtStoreFailures(grid);
+	measureType searchMeasure;
+
+	mbtCheckBlocks(grid, block, 1);
 
 	PROTECT(query = AS_CHARACTER(query));
 	PROTECT(minTanimoto = AS_NUMERIC(minTanimoto));
+	mbtGetMeasure(measure, REAL(minTanimoto)[0], &searchMeasure);
 	PROTECT(size = AS_INTEGER(size));
 	PROTECT(sort = AS_INTEGER(sort));
+	PROTECT(ids = AS_INTEGER(ids));
 
-	result = mbtSearch(CHAR(STRING_ELT(query, 0)), REAL(minTanimoto)[0], INTEGER_POINTER(size)[0], INTEGER_POINTER(sort)[0]);
+	result = mbtSearch(grid, CHAR(STRING_ELT(query, 0)), isNull(block) ? NULL : CHAR(STRING_ELT(block, 0)), REAL(minTanimoto)[0], &searchMeasure, INTEGER_POINTER(size)[0], INTEGER_POINTER(sort)[0], INTEGER_POINTER(ids)[0] ? mbtGetIds(handle) : R_NilValue);
 	
-	UNPROTECT(4);
+	mbtCheckStore(grid, failures);
+
+	UNPROTECT(5);
 
 	return(result);
 }
 
 // wrapper for R-function mbtSearchFileCall
-SEXP mbtSearchFileCall(SEXP filename, SEXP minTanimoto, SEXP resultFile, SEXP seperator) {
+SEXP mbtSearchFileCall(SEXP handle, SEXP filename, SEXP minTanimoto, SEXP resultFile, SEXP seperator, SEXP sort, SEXP maxResults, SEXP binary, SEXP ids, SEXP measure) {
 	SEXP result;
+	Grid1D *grid = mbtGetGrid(handle);
+	long long failures = mbtStoreFailures(grid);
+	measureType searchMeasure;
+	bandsType bands;
+	const char *resultFiles[MAX_BANDS];
+	int files;
 
 	PROTECT(filename = AS_CHARACTER(filename));
 	PROTECT(minTanimoto = AS_NUMERIC(minTanimoto));
 	PROTECT(resultFile = AS_CHARACTER(resultFile));
 	PROTECT(seperator = AS_CHARACTER(seperator));
+	PROTECT(sort = AS_INTEGER(sort));
+	PROTECT(maxResults = AS_INTEGER(maxResults));
+	PROTECT(binary = AS_INTEGER(binary));
+	PROTECT(ids = AS_INTEGER(ids));
+
+	mbtGetBands(minTanimoto, maxResults, measure, grid->getSize(), &searchMeasure, &bands);
+
+	files = XLENGTH(resultFile);
+	if ((files != 1) && (files != bands.count)) {
+		error("resultFile must be one file name or one per threshold");
+	}
+	for (int i = 0; i < files; i++) {
+		resultFiles[i] = CHAR(STRING_ELT(resultFile, i));
+	}
 
-	result = mbtSearchFile(CHAR(STRING_ELT(filename, 0)), REAL(minTanimoto)[0], CHAR(STRING_ELT(resultFile, 0)), CHAR(STRING_ELT(seperator, 0)));
+	result = mbtSearchFile(grid, CHAR(STRING_ELT(filename, 0)), &bands, &searchMeasure, resultFiles, files, CHAR(STRING_ELT(seperator, 0)), INTEGER_POINTER(sort)[0], INTEGER_POINTER(binary)[0] ? FORMAT_BINARY : FORMAT_CSV, INTEGER_POINTER(ids)[0] ? mbtGetIds(handle) : R_NilValue);
+
+	if (result == NULL) {
+		error("could not write result file %s", CHAR(STRING_ELT(resultFile, 0)));
+	}
 	
+	mbtCheckStore(grid, failures);
+
+	UNPROTECT(8);
+
+	return(result);
+}
+
+// wrapper for R-function mbtSearchQueriesCall
+SEXP mbtSearchQueriesCall(SEXP handle, SEXP queries, SEXP queryIds, SEXP minTanimoto, SEXP sort, SEXP maxResults, SEXP ids, SEXP queryBlocks, SEXP measure) {
+	SEXP result;
+	Grid1D *grid = mbtGetGrid(handle);
+	long long failures = mbtStoreFailures(grid);
+	measureType searchMeasure;
+
+	PROTECT(minTanimoto = AS_NUMERIC(minTanimoto));
+	mbtGetMeasure(measure, REAL(minTanimoto)[0], &searchMeasure);
+	PROTECT(sort = AS_INTEGER(sort));
+	PROTECT(maxResults = AS_INTEGER(maxResults));
+	PROTECT(ids = AS_INTEGER(ids));
+
+	if (!isNull(queryIds) && ((TYPEOF(queryIds) != STRSXP) || (XLENGTH(queryIds) != mbtCountPrints(queries)))) {
+		error("queryIds must be a character vector with one id per query");
+	}
+
+	mbtCheckBlocks(grid, queryBlocks, mbtCountPrints(queries));
+
+	result = mbtSearchQueries(grid, queries, queryIds, queryBlocks, REAL(minTanimoto)[0], &searchMeasure, INTEGER_POINTER(sort)[0], INTEGER_POINTER(maxResults)[0], INTEGER_POINTER(ids)[0] ? mbtGetIds(handle) : R_NilValue);
+
+	mbtCheckStore(grid, failures);
+
+	UNPROTECT(4);
+
+	return(result);
+}
+
+// wrapper for R-function mbtLoadFieldsCall
+SEXP mbtLoadFieldsCall(SEXP prints, SEXP ids, SEXP weights, SEXP threads, SEXP pool) {
+	SEXP result;
+	SEXP sizeAttr;
+	SEXP fields;
+	ThreadPool *threadPool = NULL;
+	CompositeGrid *grid;
+	int nFields;
+	double sum = 0;
+
+	PROTECT(weights = AS_NUMERIC(weights));
+	PROTECT(threads = AS_INTEGER(threads));
+
+	nFields = (TYPEOF(prints) == VECSXP) ? XLENGTH(prints) : 0;
+
+	if (XLENGTH(weights) != nFields) {
+		error("weights must have one value per field");
+	}
+
+	for (int f = 0; f < nFields; f++) {
+		if (!R_FINITE(REAL(weights)[f]) || (REAL(weights)[f] < 0)) {
+			error("weights must be non-negative");
+		}
+		sum += REAL(weights)[f];
+	}
+
+	if (sum <= 0) {
+		error("at least one weight must be positive");
+	}
+
+	if (!isNull(pool)) {
+		threadPool = mbtGetThreadPool(pool);
+	} else if (INTEGER_POINTER(threads)[0] < 1) {
+		error("number of threads must be positive");
+	}
+
+	if (!isNull(ids) && ((TYPEOF(ids) != STRSXP) || (XLENGTH(ids) != mbtCountFields(prints)))) {
+		error("ids must be a character vector with one id per record");
+	}
+
+	grid = mbtLoadFields(prints, ids, REAL(weights), INTEGER_POINTER(threads)[0], threadPool);
+
+	// a shared pool is kept in the handle like for grid handles
+	PROTECT(fields = allocVector(VECSXP, HANDLE_FIELDS));
+	SET_VECTOR_ELT(fields, HANDLE_POOL, pool);
+
+	PROTECT(result = R_MakeExternalPtr(grid, install("multibitTreeFields"), fields));
+	R_RegisterCFinalizerEx(result, mbtUnloadFields, TRUE);
+
+	// attach number of loaded records
+	PROTECT(sizeAttr = ScalarReal((double) grid->getSize()));
+	setAttrib(result, install("size"), sizeAttr);
+
+	UNPROTECT(5);
+
+	return(result);
+}
+
+// wrapper for R-function mbtSearchFieldsCall
+SEXP mbtSearchFieldsCall(SEXP handle, SEXP queries, SEXP queryIds, SEXP minScore, SEXP sort, SEXP maxResults, SEXP ids) {
+	SEXP result;
+	CompositeGrid *grid = mbtGetFieldGrid(handle);
+	long long sizeQueries;
+
+	PROTECT(minScore = AS_NUMERIC(minScore));
+	PROTECT(sort = AS_INTEGER(sort));
+	PROTECT(maxResults = AS_INTEGER(maxResults));
+	PROTECT(ids = AS_INTEGER(ids));
+
+	sizeQueries = mbtCountFields(queries);
+
+	if (XLENGTH(queries) != grid->getFields()) {
+		error("queries must have one field per field of the index");
+	}
+
+	if (!isNull(queryIds) && ((TYPEOF(queryIds) != STRSXP) || (XLENGTH(queryIds) != sizeQueries))) {
+		error("queryIds must be a character vector with one id per query");
+	}
+
+	result = mbtSearchFields(grid, queries, queryIds, REAL(minScore)[0], INTEGER_POINTER(sort)[0], INTEGER_POINTER(maxResults)[0], INTEGER_POINTER(ids)[0] ? mbtGetIds(handle) : R_NilValue);
+
 	UNPROTECT(4);
 
 	return(result);
 }
 
 // wrapper for R-function mbtUnloadCall
-SEXP mbtUnloadCall() {
-	mbtUnload();
+SEXP mbtUnloadCall(SEXP handle) {
+	if (mbtIsFieldHandle(handle)) {
+		mbtGetFieldGrid(handle);
+		mbtUnloadFields(handle);
+	} else {
+		mbtGetGrid(handle);
+		mbtUnload(handle);
+	}
 
 	return(R_NilValue);
 }
 
-SEXP mbtStatisticsCall() {
+// wrapper for R-function mbtStatisticsCall
+SEXP mbtStatisticsCall(SEXP handle) {
 	SEXP result;
 
-	result = mbtStatistics();
+	result = mbtStatistics(mbtGetGrid(handle));
   
 	return(result);
 }
 
+// wrapper for R-function mbtMemoryCall
+SEXP mbtMemoryCall(SEXP handle) {
+	return(mbtMemory(mbtGetGrid(handle)));
+}
+
+// wrapper for R-function mbtIdsCall
+SEXP mbtIdsCall(SEXP handle) {
+	return(mbtGetIds(handle));
+}
+
 // register wrapper-functions
 void R_init_useCall(DllInfo *info) {
 	R_CallMethodDef callMethods[]  = {
-	  {"mbtLoadCall", (DL_FUNC) &mbtLoadCall, 4},
-	  {"mbtSearchCall", (DL_FUNC) &mbtSearchCall, 4},
-	  {"mbtSearchFileCall", (DL_FUNC) &mbtSearchFileCall, 4},
-	  {"mbtUnloadCall", (DL_FUNC) &mbtUnloadCall, 0},
-	  {"mbtStatisticsCall", (DL_FUNC) &mbtStatisticsCall, 0},
+	  {"mbtThreadPoolCall", (DL_FUNC) &mbtThreadPoolCall, 2},
+	  {"mbtLoadCall", (DL_FUNC) &mbtLoadCall, 13},
+	  {"mbtLoadPrintsCall", (DL_FUNC) &mbtLoadPrintsCall, 13},
+	  {"mbtSearchCall", (DL_FUNC) &mbtSearchCall, 8},
+	  {"mbtSearchFileCall", (DL_FUNC) &mbtSearchFileCall, 10},
+	  {"mbtSearchQueriesCall", (DL_FUNC) &mbtSearchQueriesCall, 9},
+	  {"mbtUnloadCall", (DL_FUNC) &mbtUnloadCall, 1},
+	  {"mbtStatisticsCall", (DL_FUNC) &mbtStatisticsCall, 1},
+	  {"mbtIdsCall", (DL_FUNC) &mbtIdsCall, 1},
+	  {"mbtMemoryCall", (DL_FUNC) &mbtMemoryCall, 1},
+	  {"mbtLoadFieldsCall", (DL_FUNC) &mbtLoadFieldsCall, 5},
+	  {"mbtSearchFieldsCall", (DL_FUNC) &mbtSearchFieldsCall, 7},
 	  {NULL, NULL, 0}
 	};
 	
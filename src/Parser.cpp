@@ -0,0 +1,523 @@
+// Parser.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "Parser.h"
+
+// check, if a character is considered to be a white-space or seperator
+int isWS(char c) {
+	return (
+		(c == '"') ||
+		(c == '\'') ||
+		(c == ',') ||
+		(c == ';') ||
+		(c == ' ') ||
+		(c == '\t')
+	);
+}
+
+// check, if a character is considered to be end of line
+int isEOL(char c) {
+	return (
+		(c == 10) ||
+		(c == 13) ||
+		(c == 0)
+	);
+}
+
+// parse prints from file, return number of parsed fields
+int parseLine(FILE *in, char *str, long long *idx1, long long *end1, long long *idx2, long long *end2) {
+	// read line from file
+	if (fgets(str, STRSIZE, in) == NULL) {
+		return 0;
+	}
+	
+	// parse line
+	
+	// find start of first field
+	*idx1 = 0;
+	while (isWS(str[*idx1]) && (*idx1 < STRSIZE-1)) {
+		(*idx1)++;
+	}
+
+	// find end of first field
+	*end1 = *idx1;
+	while (!isWS(str[*end1]) && (*end1 < STRSIZE-1) && !isEOL(str[*end1])) {
+		(*end1)++;
+	}
+
+	if (!isEOL(str[*end1])) {
+		// find start of second field
+		*idx2 = *end1;
+		while (isWS(str[*idx2]) && (*idx2 < STRSIZE-1)) {
+			(*idx2)++;
+		}
+		
+		// find end of second field
+		*end2 = *idx2;
+		while (!isWS(str[*end2]) && (*end2 < STRSIZE-1) && !isEOL(str[*end2])) {
+			(*end2)++;
+		}
+	} else {
+		*idx2 = 0;
+		*end2 = 0;
+	}
+
+	// cut field 1
+	str[*end1] = 0;
+
+	if (*idx2 != *end2) {
+		// if there are two fields, cut field 2
+		str[*end2] = 0;
+		return 2;
+	}
+
+	return 1;
+}
+
+// read the first <maxSize> prints from file <filename>, all if <maxSize> is 0
+// <size> gets the number of prints and <nBits> their maximal length
+// returns NULL if the file cannot be read
+Fingerprint **readPrints(const char *filename, long long maxSize, long long *size, int *nBits) {
+	Fingerprint **prints;
+	long long sizePrints;
+	int len;
+	char str[STRSIZE];
+	long long fields;
+	long long idx1, end1, idx2, end2;
+	char *idStr;
+	FILE *in;
+
+	// initialize Fingerprint data structure (cardinality-map)
+        Fingerprint::init();
+
+	sizePrints = maxSize;
+
+	// count number of prints in file
+	if (sizePrints == 0) {
+		in = fopen(filename, "r");
+
+		if (in == NULL) {
+			return(NULL);
+		}
+
+                while (fgets(str, STRSIZE, in)) {
+			sizePrints++;
+		}
+
+		fclose(in);
+	}
+
+	*nBits = 0;
+        in = fopen(filename, "r");
+
+	if (in == NULL) {
+		return(NULL);
+	}
+
+	// create array of Fingerprints
+        prints = new Fingerprint*[sizePrints];
+
+	// read prints from file
+        for (long long i = 0; i < sizePrints; i++) {
+		// parse line from file
+		fields = parseLine(in, str, &idx1, &end1, &idx2, &end2);
+
+		if (fields == 0) {
+			sizePrints = i;
+			break;
+                }
+		
+		if (fields == 1) {
+			// if there is only one field, use line as id
+			idStr = new char[21];
+			sprintf(idStr, "%012lld", i+1);
+			// create fingerprint
+			prints[i] = new Fingerprint(idStr, str+idx1);
+		} else {
+			// if there are two fields, use first string as id
+			idStr = new char[end1-idx1+1];
+			strcpy(idStr, str+idx1);
+			// create fingerprint
+			prints[i] = new Fingerprint(idStr, str+idx2);
+		}
+
+		// compute maximal length of Fingerprints
+                len = prints[i]->getLength();
+                if (len > *nBits) {
+                        *nBits = len;
+                }
+        }
+
+        fclose(in);
+
+	*size = sizePrints;
+
+	return(prints);
+}
+
+// split <str> into up to <maxFields> fields, which are cut in place
+// <fields> gets the start of each field, return number of fields
+static int splitFields(char *str, char **fields, int maxFields) {
+	int count = 0;
+	long long i = 0;
+
+	while (count < maxFields) {
+		// find start of field
+		while (isWS(str[i])) {
+			i++;
+		}
+
+		if (isEOL(str[i])) {
+			break;
+		}
+
+		fields[count++] = str + i;
+
+		// find end of field
+		while (!isWS(str[i]) && !isEOL(str[i])) {
+			i++;
+		}
+
+		// cut field
+		if (isEOL(str[i])) {
+			str[i] = 0;
+			break;
+		}
+		str[i++] = 0;
+	}
+
+	return count;
+}
+
+// count the lines of file <filename>, -1 if it cannot be read
+long long countLines(const char *filename) {
+	lineBufferType line;
+	long long count = 0;
+	FILE *in = fopen(filename, "r");
+
+	if (in == NULL) {
+		return -1;
+	}
+
+	lineBufferInit(&line);
+	while (getline(&line.str, &line.capacity, in) >= 0) {
+		count++;
+	}
+	lineBufferFree(&line);
+	fclose(in);
+
+	return count;
+}
+
+// parse the next line with up to <maxFields> fields from file into <line>
+// <fields> gets the start of each field, return number of parsed fields
+// or -1 at the end of the file
+int parseFields(FILE *in, lineBufferType *line, char **fields, int maxFields) {
+	if (getline(&line->str, &line->capacity, in) < 0) {
+		return -1;
+	}
+
+	return splitFields(line->str, fields, maxFields);
+}
+
+// parse the fields of a record with <nFields> prints from <fields>
+// a record with more than <nFields> fields starts with its id, otherwise it gets
+// <line> as id, missing prints are empty; the id is stored in the first print
+void parseRecord(char **fields, int count, int nFields, long long line, Fingerprint **prints) {
+	char idStr[21];
+	int first = 0;
+
+	if (count > nFields) {
+		// use first string as id
+		prints[0]->copyId(fields[0]);
+		first = 1;
+	} else {
+		// use line as id
+		sprintf(idStr, "%012lld", line);
+		prints[0]->copyId(idStr);
+	}
+
+	for (int f = 0; f < nFields; f++) {
+		prints[f]->parse((first + f < count) ? fields[first + f] : "");
+	}
+}
+
+// read the first <maxSize> records with <nFields> prints each from file <filename>,
+// all if <maxSize> is 0, and return an array of prints for each field
+// <size> gets the number of records and <nBits> the maximal length of each field
+// returns NULL if the file cannot be read
+Fingerprint ***readFields(const char *filename, int nFields, long long maxSize, long long *size, int *nBits) {
+	Fingerprint ***prints;
+	Fingerprint *record[nFields];
+	long long sizePrints;
+	lineBufferType line;
+	char *fields[nFields + 1];
+	int count;
+	FILE *in;
+
+	// initialize Fingerprint data structure (cardinality-map)
+	Fingerprint::init();
+
+	sizePrints = maxSize;
+
+	// count number of records in file
+	if (sizePrints == 0) {
+		sizePrints = countLines(filename);
+
+		if (sizePrints < 0) {
+			return(NULL);
+		}
+	}
+
+	in = fopen(filename, "r");
+
+	if (in == NULL) {
+		return(NULL);
+	}
+
+	// create one array of Fingerprints per field
+	prints = new Fingerprint**[nFields];
+
+	for (int f = 0; f < nFields; f++) {
+		prints[f] = new Fingerprint*[sizePrints];
+		nBits[f] = 0;
+	}
+
+	// read records from file, each line is read whole
+	lineBufferInit(&line);
+	for (long long i = 0; i < sizePrints; i++) {
+		count = parseFields(in, &line, fields, nFields + 1);
+
+		if (count < 0) {
+			sizePrints = i;
+			break;
+		}
+
+		for (int f = 0; f < nFields; f++) {
+			record[f] = new Fingerprint(0);
+			prints[f][i] = record[f];
+		}
+		parseRecord(fields, count, nFields, i+1, record);
+
+		// compute maximal length of each field
+		for (int f = 0; f < nFields; f++) {
+			nBits[f] = MAX(nBits[f], record[f]->getLength());
+		}
+	}
+	lineBufferFree(&line);
+
+	fclose(in);
+
+	*size = sizePrints;
+
+	return(prints);
+}
+
+// parse the fields of a print with a blocking key from <fields>
+// a line with three fields starts with its id, otherwise it gets <line> as id
+// the id and the bits are stored in <print>, return the key
+const char *parseBlockedPrint(char **fields, int count, long long line, Fingerprint *print) {
+	char idStr[21];
+	int first = 0;
+
+	if (count > 2) {
+		// use first string as id
+		print->copyId(fields[0]);
+		first = 1;
+	} else {
+		// use line as id
+		sprintf(idStr, "%012lld", line);
+		print->copyId(idStr);
+	}
+
+	print->parse((first + 1 < count) ? fields[first + 1] : "");
+
+	return (first < count) ? fields[first] : "";
+}
+
+// read the first <maxSize> prints with a blocking key before each print from file
+// <filename>, all if <maxSize> is 0, the keys are added to <keys> and their
+// numbers are set as blocks of the prints
+// <size> gets the number of prints and <nBits> their maximal length
+// returns NULL if the file cannot be read
+Fingerprint **readBlockedPrints(const char *filename, long long maxSize, long long *size, int *nBits, BlockKeys *keys) {
+	Fingerprint **prints;
+	long long sizePrints;
+	lineBufferType line;
+	char *fields[3];
+	int count;
+	FILE *in;
+
+	// initialize Fingerprint data structure (cardinality-map)
+	Fingerprint::init();
+
+	sizePrints = maxSize;
+
+	// count number of prints in file
+	if (sizePrints == 0) {
+		sizePrints = countLines(filename);
+
+		if (sizePrints < 0) {
+			return(NULL);
+		}
+	}
+
+	*nBits = 0;
+	in = fopen(filename, "r");
+
+	if (in == NULL) {
+		return(NULL);
+	}
+
+	// create array of Fingerprints
+	prints = new Fingerprint*[sizePrints];
+
+	// read prints from file, each line is read whole
+	lineBufferInit(&line);
+	for (long long i = 0; i < sizePrints; i++) {
+		count = parseFields(in, &line, fields, 3);
+
+		if (count < 0) {
+			sizePrints = i;
+			break;
+		}
+
+		prints[i] = new Fingerprint(0);
+		prints[i]->setBlock(keys->add(parseBlockedPrint(fields, count, i+1, prints[i])));
+
+		// compute maximal length of Fingerprints
+		*nBits = MAX(*nBits, prints[i]->getLength());
+	}
+	lineBufferFree(&line);
+
+	fclose(in);
+
+	*size = sizePrints;
+
+	return(prints);
+}
+
+// parse the next line of <in> into <print>, the line is read into <str>
+// or, if <blocked> is set, into <line> and holds a blocking key before the print
+// a line without id gets <number> as id
+// return the blocking key, "" if not <blocked>, or NULL at the end of the file
+static const char *parseNextPrint(FILE *in, lineBufferType *line, char *str, int blocked, long long number, Fingerprint *print) {
+	char *fields[3];
+	long long idx1, end1, idx2, end2;
+	char idStr[21];
+	int count;
+
+	if (blocked) {
+		count = parseFields(in, line, fields, 3);
+		return (count < 0) ? NULL : parseBlockedPrint(fields, count, number, print);
+	}
+
+	count = parseLine(in, str, &idx1, &end1, &idx2, &end2);
+
+	if (count == 0) {
+		return NULL;
+	}
+
+	if (count == 1) {
+		// if there is only one field, use line as id
+		sprintf(idStr, "%012lld", number);
+		print->copyId(idStr);
+		print->parse(str+idx1);
+	} else {
+		// if there are two fields, use first string as id
+		print->copyId(str+idx1);
+		print->parse(str+idx2);
+	}
+
+	return "";
+}
+
+// read the first <maxSize> prints from file <filename>, all if <maxSize> is 0,
+// into the partition of <store> and their ids into <records> in two passes
+// if <keys> is given, each line holds a blocking key before the print,
+// the keys are added to <keys> and their numbers are set as blocks
+// <nBits> gets the maximal length of the prints
+// return the number of prints, -1 if the file cannot be read or partitioned
+//
+// the first pass keeps the ids and counts the prints of each cardinality,
+// so the second pass can write each print to its slot of the partition
+// and only one print is in memory at a time
+long long partitionPrints(const char *filename, long long maxSize, CellStore *store, RecordTable *records, int *nBits, BlockKeys *keys) {
+	Fingerprint print(0);
+	lineBufferType line;
+	char str[STRSIZE];
+	long long size = 0;
+	const char *key;
+	int ok;
+	FILE *in;
+
+	// initialize Fingerprint data structure (cardinality-map)
+	Fingerprint::init();
+
+	in = fopen(filename, "r");
+
+	if (in == NULL) {
+		return -1;
+	}
+
+	// first pass: ids, blocking keys and the prints of each cardinality
+	lineBufferInit(&line);
+	while ((maxSize == 0) || (size < maxSize)) {
+		key = parseNextPrint(in, &line, str, keys != NULL, size+1, &print);
+
+		if (key == NULL) {
+			break;
+		}
+
+		records->add(print.getId());
+		if (keys != NULL) {
+			keys->add(key);
+		}
+		store->countPrint(&print);
+		size++;
+	}
+
+	// second pass: write each print to the partition
+	rewind(in);
+	ok = store->openPartition();
+
+	for (long long i = 0; ok && (i < size); i++) {
+		key = parseNextPrint(in, &line, str, keys != NULL, i+1, &print);
+		ok = (key != NULL);
+
+		if (ok) {
+			print.setIndex(i);
+			print.setBlock((keys != NULL) ? keys->find(key) : 0);
+			ok = store->partitionPrint(&print);
+		}
+	}
+	lineBufferFree(&line);
+
+	fclose(in);
+	*nBits = store->getPartitionBits();
+
+	return ok ? size : -1;
+}
@@ -0,0 +1,117 @@
+// Parser.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Fingerprint.h"
+#include "BlockKeys.h"
+#include "CellStore.h"
+#include "RecordTable.h"
+
+// maximal line size = length of ascii representation of fingerprint
+#define STRSIZE 4000
+
+// This file contains the functions for reading fingerprint files.
+// Each line holds a fingerprint as string of "0" and "1", optionally
+// preceded by an id. Fields are seperated by white-space, commas,
+// semicolons or quotes. Fingerprints without id are numbered by line.
+
+// Instances of lineBufferType hold the last line read from a file.
+// The buffer grows with the lines, so lines of any length are read whole.
+typedef struct lineBufferStruct {
+	char *str;			// the line, allocated by getline()
+	size_t capacity;		// allocated size of str
+} lineBufferType;
+
+// initialize an empty line buffer
+inline void lineBufferInit(lineBufferType *line) {
+	line->str = NULL;
+	line->capacity = 0;
+}
+
+// release the buffer of <line>
+inline void lineBufferFree(lineBufferType *line) {
+	free(line->str);
+	line->str = NULL;
+	line->capacity = 0;
+}
+
+// check, if a character is considered to be a white-space or seperator
+int isWS(char c);
+
+// check, if a character is considered to be end of line
+int isEOL(char c);
+
+// parse prints from file, return number of parsed fields
+int parseLine(FILE *in, char *str, long long *idx1, long long *end1, long long *idx2, long long *end2);
+
+// read the first <maxSize> prints from file <filename>, all if <maxSize> is 0
+// <size> gets the number of prints and <nBits> their maximal length
+// returns NULL if the file cannot be read
+Fingerprint **readPrints(const char *filename, long long maxSize, long long *size, int *nBits);
+
+// parse the fields of a print with a blocking key from <fields>
+// a line with three fields starts with its id, otherwise it gets <line> as id
+// the id and the bits are stored in <print>, return the key
+const char *parseBlockedPrint(char **fields, int count, long long line, Fingerprint *print);
+
+// read the first <maxSize> prints with a blocking key before each print from file
+// <filename>, all if <maxSize> is 0, the keys are added to <keys> and their
+// numbers are set as blocks of the prints
+// <size> gets the number of prints and <nBits> their maximal length
+// returns NULL if the file cannot be read
+Fingerprint **readBlockedPrints(const char *filename, long long maxSize, long long *size, int *nBits, BlockKeys *keys);
+
+// read the first <maxSize> prints from file <filename>, all if <maxSize> is 0,
+// into the partition of <store> and their ids into <records> in two passes
+// if <keys> is given, each line holds a blocking key before the print,
+// the keys are added to <keys> and their numbers are set as blocks
+// <nBits> gets the maximal length of the prints
+// return the number of prints, -1 if the file cannot be read or partitioned
+long long partitionPrints(const char *filename, long long maxSize, CellStore *store, RecordTable *records, int *nBits, BlockKeys *keys);
+
+// count the lines of file <filename>, -1 if it cannot be read
+long long countLines(const char *filename);
+
+// parse the next line with up to <maxFields> fields from file into <line>
+// <fields> gets the start of each field, return number of parsed fields
+// or -1 at the end of the file
+int parseFields(FILE *in, lineBufferType *line, char **fields, int maxFields);
+
+// parse the fields of a record with <nFields> prints from <fields>
+// a record with more than <nFields> fields starts with its id, otherwise it gets
+// <line> as id, missing prints are empty; the id is stored in the first print
+void parseRecord(char **fields, int count, int nFields, long long line, Fingerprint **prints);
+
+// read the first <maxSize> records with <nFields> prints each from file <filename>,
+// all if <maxSize> is 0, and return an array of prints for each field
+// <size> gets the number of records and <nBits> the maximal length of each field
+// returns NULL if the file cannot be read
+Fingerprint ***readFields(const char *filename, int nFields, long long maxSize, long long *size, int *nBits);
+#endif
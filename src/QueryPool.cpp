@@ -0,0 +1,112 @@
+// QueryPool.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <sched.h>
+#include "QueryPool.h"
+
+// constructor
+// create a pool with <size> slots
+QueryPool::QueryPool(int size) {
+	mSize = size;
+	mPrints = new Fingerprint*[size];
+	mPending = new int[size];
+	mHits = new long long[size];
+	mFree = new int[size];
+
+	for (int i = 0; i < size; i++) {
+		mPrints[i] = NULL;
+		mPending[i] = 0;
+		mHits[i] = 0;
+		mFree[i] = 1;
+	}
+}
+
+// destructor
+// all tasks have to be completed
+QueryPool::~QueryPool() {
+	for (int i = 0; i < mSize; i++) {
+		if (mPrints[i] != NULL) {
+			delete mPrints[i];
+		}
+	}
+
+	delete[] mPrints;
+	delete[] mPending;
+	delete[] mHits;
+	delete[] mFree;
+}
+
+// get the query Fingerprint for query number <index>
+// wait until the previous query of the slot has completed
+Fingerprint *QueryPool::acquire(long long index) {
+	int slot = index % mSize;
+
+	while (!__atomic_load_n(&mFree[slot], __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+
+	mFree[slot] = 0;
+	mHits[slot] = 0;
+
+	// allocate Fingerprints on first use
+	if (mPrints[slot] == NULL) {
+		mPrints[slot] = new Fingerprint(0);
+	}
+
+	mPrints[slot]->setIndex(index);
+
+	return mPrints[slot];
+}
+
+// set number of tasks that search for <query>
+// a slot without tasks is freed immediately
+void QueryPool::setPending(Fingerprint *query, int tasks) {
+	int slot = query->getIndex() % mSize;
+
+	if (tasks == 0) {
+		__atomic_store_n(&mFree[slot], 1, __ATOMIC_RELEASE);
+	} else {
+		__atomic_store_n(&mPending[slot], tasks, __ATOMIC_RELEASE);
+	}
+}
+
+// count a completed task for <query> that found <hits> results
+void QueryPool::release(Fingerprint *query, QueryResult *result, long long hits) {
+	int slot = query->getIndex() % mSize;
+
+	if (hits > 0) {
+		__atomic_add_fetch(&mHits[slot], hits, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_sub_fetch(&mPending[slot], 1, __ATOMIC_ACQ_REL) == 0) {
+		// last task of the query, the id is still valid here
+		if (mHits[slot] > 0) {
+			result->addQueryId(query->getIndex(), query->getId());
+		}
+
+		__atomic_store_n(&mFree[slot], 1, __ATOMIC_RELEASE);
+	}
+}
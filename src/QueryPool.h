@@ -0,0 +1,76 @@
+// QueryPool.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef QUERYPOOL_H
+#define QUERYPOOL_H
+
+#include "Fingerprint.h"
+#include "QueryResult.h"
+
+#define QUERY_POOL_SIZE 8192		// number of query slots, twice the shared task queue
+
+// Objects of class QueryPool hold the query Fingerprints of an
+// asynchronous search. Query i is stored in slot i modulo the pool
+// size, so a slot and its Fingerprint are re-used once all tasks
+// for the previous query of the slot have completed. The memory used
+// for queries is bounded by the number of slots, no matter how many
+// queries are searched.
+//
+// The search tasks of a query call release() when they are done.
+// The last task registers the query id with the QueryResult if the
+// query had any results and frees the slot.
+
+class QueryPool {
+	private:
+
+	Fingerprint **mPrints;		// query Fingerprint of each slot
+	int *mPending;			// number of uncompleted tasks of each slot
+	long long *mHits;		// number of results of each slot
+	int *mFree;			// flag if a slot can be re-used
+	int mSize;			// number of slots
+
+	public:
+
+	// constructor
+	// create a pool with <size> slots
+	QueryPool(int size);
+
+	// destructor
+	// all tasks have to be completed
+	~QueryPool();
+
+	// get the query Fingerprint for query number <index>
+	// wait until the previous query of the slot has completed
+	Fingerprint *acquire(long long index);
+
+	// set number of tasks that search for <query>
+	// a slot without tasks is freed immediately
+	void setPending(Fingerprint *query, int tasks);
+
+	// count a completed task for <query> that found <hits> results
+	void release(Fingerprint *query, QueryResult *result, long long hits);
+};
+#endif
@@ -24,109 +24,407 @@
 // along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
 
 #include "QueryResult.h"
+#include "RadixSort.h"
+#include "ResultWriter.h"
+
+__thread int QueryResult::sThreadSlot = -1;
+
+// compare function for sorting query ids by number
+static int compareQueryIds(const void *a, const void *b) {
+	long long indexA = ((const queryIdType *) a)->index;
+	long long indexB = ((const queryIdType *) b)->index;
+
+	return (indexA > indexB) - (indexA < indexB);
+}
 
 // constructor
-QueryResult::QueryResult(int sort, FILE *resultFile, const char *seperator) {
+QueryResult::QueryResult(int sort, ResultWriter *writer, RecordTable *records, int threads) {
+	mThreads = threads;
+	mBuffers = new resultBufferType[threads + 1];
+
+	for (int i = 0; i <= threads; i++) {
+		mBuffers[i].first = NULL;
+		mBuffers[i].last = NULL;
+		mBuffers[i].size = 0;
+		mBuffers[i].heap = NULL;
+		memset(mBuffers[i].heapSize, 0, sizeof(mBuffers[i].heapSize));
+		mBuffers[i].block = NULL;
+	}
+
+	mFreeChunks = NULL;
+	mRecords = NULL;
 	mSize = 0;
-	mRootNode = NULL;
 	mSort = sort;
-	mResultFile = resultFile;
-	mSeperator = seperator;
+	mLimit = 0;
+	mBands.count = 1;
+	mBands.thresholds[0] = 0;
+	mBands.limits[0] = 0;
+	mBands.labels[0] = 0;
+	mHeapStart[0] = 0;
+	mHeapStart[1] = 0;
+	measureInit(&mMeasure);
+	mRecordTable = records;
+	mWriter = writer;
+	mQueryIds = NULL;
+	mQueryIdCount = 0;
+	mQueryIdCapacity = 0;
+	mQueryIdsSorted = 1;
 
-	pthread_mutex_init(&mAddMutex, NULL);
+	pthread_mutex_init(&mChunkMutex, NULL);
+	pthread_mutex_init(&mIdMutex, NULL);
 }
 
 // destructor
 QueryResult::~QueryResult() {
-	QueryResultNode *node, *nextNode;
-	if (mSort) {
-		deleteNode(mRootNode);		// discard the whole result set recursivly
-	} else {
-		// discard the whole result iteratively for large scale results
-		node = mRootNode;
-		while (node != NULL) {
-			if (node->mQueryId != NULL) {
-				delete[] node->mQueryId;
+	resultChunkType *chunk, *nextChunk;
+
+	for (int i = 0; i <= mThreads; i++) {
+		freeChunks(mBuffers[i].first);
+		if (mBuffers[i].heap != NULL) {
+			delete[] mBuffers[i].heap;
+		}
+	}
+
+	chunk = mFreeChunks;
+	while (chunk != NULL) {
+		nextChunk = chunk->next;
+		delete chunk;
+		chunk = nextChunk;
+	}
+
+	delete[] mBuffers;
+
+	if (mRecords != NULL) {
+		delete[] mRecords;
+	}
+
+	for (long long i = 0; i < mQueryIdCount; i++) {
+		delete[] mQueryIds[i].id;
+	}
+	if (mQueryIds != NULL) {
+		delete[] mQueryIds;
+	}
+
+	pthread_mutex_destroy(&mChunkMutex);
+	pthread_mutex_destroy(&mIdMutex);
+}
+
+// set worker slot of the calling thread
+void QueryResult::setThreadSlot(int slot) {
+	sThreadSlot = slot;
+}
+
+// take a chunk from the free list or allocate one
+resultChunkType *QueryResult::getChunk() {
+	resultChunkType *chunk;
+
+	pthread_mutex_lock(&mChunkMutex);
+	chunk = mFreeChunks;
+	if (chunk != NULL) {
+		mFreeChunks = chunk->next;
+	}
+	pthread_mutex_unlock(&mChunkMutex);
+
+	if (chunk == NULL) {
+		chunk = new resultChunkType;
+	}
+
+	chunk->size = 0;
+	chunk->next = NULL;
+
+	return chunk;
+}
+
+// return a list of chunks to the free list
+void QueryResult::freeChunks(resultChunkType *chunk) {
+	resultChunkType *last = chunk;
+
+	if (chunk == NULL) {
+		return;
+	}
+
+	while (last->next != NULL) {
+		last = last->next;
+	}
+
+	pthread_mutex_lock(&mChunkMutex);
+	last->next = mFreeChunks;
+	mFreeChunks = chunk;
+	pthread_mutex_unlock(&mChunkMutex);
+}
+
+// set maximal number of results per query of each band, 0 for no limit
+// must be called before searching
+void QueryResult::setLimit(int limit) {
+	for (int b = 0; b < mBands.count; b++) {
+		mBands.limits[b] = limit;
+	}
+
+	setBands(&mBands);
+}
+
+// divide the results into <bands>, which also sets their limits
+// must be called before searching
+void QueryResult::setBands(const bandsType *bands) {
+	mBands = *bands;
+
+	// the heaps of all bands are kept in one array
+	for (int b = 0; b < mBands.count; b++) {
+		mHeapStart[b + 1] = mHeapStart[b] + mBands.limits[b];
+	}
+	mLimit = mHeapStart[mBands.count];
+}
+
+// keep a record in the heap of its band in <buffer> if it is among the best
+// and raise <minTanimoto> once the heap of the lowest band is full
+// records of bands without limit are appended
+void QueryResult::addLimited(resultBufferType *buffer, unsigned int query, unsigned int print, float tanimoto, float *minTanimoto) {
+	int band = bandsFind(&mBands, tanimoto);
+	int limit = mBands.limits[band];
+	resultRecordType *heap;
+	int i, child;
+
+	if (limit == 0) {
+		append(buffer, query, print, tanimoto);
+		return;
+	}
+
+	if (buffer->heap == NULL) {
+		buffer->heap = new resultRecordType[mLimit];
+	}
+	heap = &buffer->heap[mHeapStart[band]];
+
+	if (buffer->heapSize[band] < limit) {
+		// move new record up from the end of the heap
+		i = buffer->heapSize[band]++;
+		while ((i > 0) && (heap[(i - 1) / 2].tanimoto > tanimoto)) {
+			heap[i] = heap[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	} else if (tanimoto > heap[0].tanimoto) {
+		// replace lowest record and move new record down
+		i = 0;
+		while ((child = 2 * i + 1) < limit) {
+			if ((child + 1 < limit) && (heap[child + 1].tanimoto < heap[child].tanimoto)) {
+				child++;
+			}
+			if (heap[child].tanimoto >= tanimoto) {
+				break;
 			}
-			nextNode = node->mRight;
-			delete node;
-			node = nextNode;
+			heap[i] = heap[child];
+			i = child;
 		}
+	} else {
+		return;
+	}
+
+	heap[i].query = query;
+	heap[i].print = print;
+	heap[i].tanimoto = tanimoto;
+
+	// only records above the lowest one can enter the full heap,
+	// records of higher bands do not depend on the lowest band
+	if ((band == 0) && (buffer->heapSize[0] == limit) && (heap[0].tanimoto > *minTanimoto)) {
+		*minTanimoto = heap[0].tanimoto;
 	}
 }
 
-// delete a node and all its subnodes recursively
-void QueryResult::deleteNode(QueryResultNode *node) {
-	if (node != NULL) {
-		if (node->mQueryId != NULL) {
-			delete[] node->mQueryId;
+// called when the calling thread completed a task for <query>
+// hand the thread's results over to the ResultWriter if there are enough
+// all new results in the thread's buffer belong to <query>
+void QueryResult::flush(Fingerprint *query) {
+	resultBufferType *buffer = getBuffer();
+	long long count;
+
+	// the heaps hold the best results of the completed query
+	for (int b = 0; b < mBands.count; b++) {
+		for (int i = mHeapStart[b]; i < mHeapStart[b] + buffer->heapSize[b]; i++) {
+			append(buffer, buffer->heap[i].query, buffer->heap[i].print, buffer->heap[i].tanimoto);
 		}
-		deleteNode(node->mLeft);
-		deleteNode(node->mRight);
-		delete node;
-	}
-}
-
-// add a Fingerprint and the corresponding Tanimoto coefficient to the query result
-void QueryResult::add(char *queryId, Fingerprint *print, float tanimoto) {
-	// lock mutex
-	pthread_mutex_lock(&mAddMutex);	
-
-	// check if a results file is specified
-	if (mResultFile == NULL) {
-		// if not, collect results in memory
-		QueryResultNode *newNode;
-		QueryResultNode **nextNodePtr;
-	
-		// create new node
-		newNode = new QueryResultNode;
-
-		// copy query id, print pointer and tanimoto
-		if (queryId != NULL) {
-			newNode->mQueryId = new char[strlen(queryId) + 1];
-			strcpy(newNode->mQueryId, queryId);
-		} else {
-			newNode->mQueryId = NULL;
+		buffer->heapSize[b] = 0;
+	}
+
+	// results in memory are merged when the search is complete
+	if (mWriter == NULL) {
+		return;
+	}
+
+	count = buffer->size - ((buffer->block != NULL) ? buffer->block->size : 0);
+
+	if (count == 0) {
+		return;
+	}
+
+	// the query's id is copied, since the query is re-used after its search
+	if (buffer->block == NULL) {
+		buffer->block = mWriter->newBlock(this);
+	}
+	mWriter->addQuery(buffer->block, query->getId(), count);
+
+	if (buffer->size >= WRITER_BLOCK_SIZE) {
+		submitBuffer(buffer);
+	}
+}
+
+// hand the records of <buffer> over to the ResultWriter
+void QueryResult::submitBuffer(resultBufferType *buffer) {
+	buffer->block->first = buffer->first;
+	__sync_fetch_and_add(&mSize, buffer->size);
+
+	mWriter->submit(buffer->block);
+
+	buffer->first = NULL;
+	buffer->last = NULL;
+	buffer->size = 0;
+	buffer->block = NULL;
+}
+
+// hand the remaining results of all threads over to the ResultWriter
+// all threads have to be completed
+void QueryResult::finish() {
+	for (int i = 0; i <= mThreads; i++) {
+		if (mBuffers[i].block != NULL) {
+			submitBuffer(&mBuffers[i]);
 		}
+	}
+}
 
-		newNode->mPrint = print;
-		newNode->mTanimoto = tanimoto;
-		newNode->mLeft = NULL;
-		newNode->mRight = NULL;
-
-		if (mSort) {
-			// if query results have to be sorted, find the right location
-			// to insert the new node
-			nextNodePtr = &mRootNode;
-
-			while (*nextNodePtr != NULL) {
-				if ((*nextNodePtr)->mTanimoto >= tanimoto) {
-					nextNodePtr = &((*nextNodePtr)->mRight);
-				} else {
-					nextNodePtr = &((*nextNodePtr)->mLeft);
-				}
-			}
+// merge the results of all threads into one array and sort it,
+// the sort uses <pool> if given
+// all threads have to be completed
+void QueryResult::merge(ThreadPool *pool) {
+	resultRecordType *records;
+	long long size = getSize();
+	long long idx = mSize;
 
-			// insert new node
-			*nextNodePtr = newNode;
-		} else {
-			// if query results need not to be sorted
-			// insert at end of list
-			if (mRootNode == NULL) {
-				mRootNode = newNode;
-			} else {
-				mRootNode->mLeft->mRight = newNode;
+	if (size == mSize) {
+		return;
+	}
+
+	records = new resultRecordType[size];
+
+	// keep records of earlier merges
+	for (long long i = 0; i < mSize; i++) {
+		records[i] = mRecords[i];
+	}
+	if (mRecords != NULL) {
+		delete[] mRecords;
+	}
+
+	for (int i = 0; i <= mThreads; i++) {
+		for (resultChunkType *chunk = mBuffers[i].first; chunk != NULL; chunk = chunk->next) {
+			for (int j = 0; j < chunk->size; j++) {
+				records[idx++] = chunk->records[j];
 			}
+		}
+
+		freeChunks(mBuffers[i].first);
+		mBuffers[i].first = NULL;
+		mBuffers[i].last = NULL;
+		mBuffers[i].size = 0;
+	}
+
+	if (mSort == SORT_TANIMOTO) {
+		records = radixSort(records, size, RADIX_PASSES_TANIMOTO, pool);
+	} else if (mSort == SORT_QUERY) {
+		records = radixSort(records, size, RADIX_PASSES_QUERY, pool);
+	}
+
+	mRecords = records;
+	mSize = size;
+}
+
+// count the heap memory of the results in <report>
+// chunks that are kept for re-use are counted as overhead
+// all threads have to be completed
+void QueryResult::getMemory(memoryReportType *report) {
+	memoryAdd(report, MEMORY_RESULTS, mBuffers, (mThreads + 1) * sizeof(resultBufferType));
 
-			mRootNode->mLeft = newNode; // use mLeft as pointer to end node
+	for (int i = 0; i <= mThreads; i++) {
+		for (resultChunkType *chunk = mBuffers[i].first; chunk != NULL; chunk = chunk->next) {
+			memoryAdd(report, MEMORY_RESULTS, chunk, sizeof(resultChunkType), chunk->size * sizeof(resultRecordType));
+		}
+		long long heapSize = 0;
+
+		for (int b = 0; b < mBands.count; b++) {
+			heapSize += mBuffers[i].heapSize[b];
+		}
+		memoryAdd(report, MEMORY_RESULTS, mBuffers[i].heap, mLimit * sizeof(resultRecordType), heapSize * sizeof(resultRecordType));
+	}
+
+	for (resultChunkType *chunk = mFreeChunks; chunk != NULL; chunk = chunk->next) {
+		memoryAdd(report, MEMORY_RESULTS, chunk, sizeof(resultChunkType), 0);
+	}
+
+	memoryAdd(report, MEMORY_RESULTS, mRecords, mSize * sizeof(resultRecordType));
+	memoryAdd(report, MEMORY_RESULTS, mQueryIds, mQueryIdCapacity * sizeof(queryIdType), mQueryIdCount * sizeof(queryIdType));
+
+	for (long long i = 0; i < mQueryIdCount; i++) {
+		memoryAdd(report, MEMORY_RESULTS, mQueryIds[i].id, strlen(mQueryIds[i].id) + 1);
+	}
+}
+
+// register the id of query number <index>, called once per query with results
+void QueryResult::addQueryId(long long index, const char *id) {
+	// ids are written directly into the result file
+	if ((mWriter != NULL) || (id == NULL)) {
+		return;
+	}
+
+	pthread_mutex_lock(&mIdMutex);
+
+	// grow array if necessary
+	if (mQueryIdCount == mQueryIdCapacity) {
+		queryIdType *queryIds;
+
+		mQueryIdCapacity = MAX(2 * mQueryIdCapacity, 1024);
+		queryIds = new queryIdType[mQueryIdCapacity];
+
+		for (long long i = 0; i < mQueryIdCount; i++) {
+			queryIds[i] = mQueryIds[i];
+		}
+		if (mQueryIds != NULL) {
+			delete[] mQueryIds;
+		}
+		mQueryIds = queryIds;
+	}
+
+	// queries complete almost in order
+	if ((mQueryIdCount > 0) && (mQueryIds[mQueryIdCount - 1].index > index)) {
+		mQueryIdsSorted = 0;
+	}
+
+	mQueryIds[mQueryIdCount].index = index;
+	mQueryIds[mQueryIdCount].id = new char[strlen(id) + 1];
+	strcpy(mQueryIds[mQueryIdCount].id, id);
+	mQueryIdCount++;
+
+	pthread_mutex_unlock(&mIdMutex);
+}
+
+// get the id of query number <index>, NULL if it is not registered
+// must not be called while queries are added
+char *QueryResult::getQueryId(long long index) {
+	long long low = 0;
+	long long high = mQueryIdCount - 1;
+
+	if (!mQueryIdsSorted) {
+		qsort(mQueryIds, mQueryIdCount, sizeof(queryIdType), compareQueryIds);
+		mQueryIdsSorted = 1;
+	}
+
+	// binary search
+	while (low <= high) {
+		long long mid = (low + high) / 2;
+
+		if (mQueryIds[mid].index < index) {
+			low = mid + 1;
+		} else if (mQueryIds[mid].index > index) {
+			high = mid - 1;
+		} else {
+			return mQueryIds[mid].id;
 		}
-	} else {
-		// write results to file
-		fprintf(mResultFile, "%s%s%s%s%.7f\n", queryId, mSeperator, print->getId(), mSeperator, tanimoto);
 	}
-	
-	mSize++;
 
-	// unlock mutex
-	pthread_mutex_unlock(&mAddMutex);
+	return NULL;
 }
@@ -28,61 +28,300 @@
 
 #include <pthread.h>
 #include "Fingerprint.h"
+#include "RecordTable.h"
+#include "Similarity.h"
 
-// Instances of QueryResultNode store one Fingerprint and
-// the corresponding Tanimoto coefficient within a sorted
-// tree. If sorting is disabled, QueryResultNodes are simply
-// used as nodes of a linked list.
- 
-typedef struct QueryResultNodeStruct {
-	char *mQueryId;				// ID of query Fingerprint
-	Fingerprint *mPrint;			// pointer to matching Fingerprint
-	float mTanimoto;			// corresponding Tanimoto coefficient
-	struct QueryResultNodeStruct *mLeft;	// left subtree (higher Tanimoto coeffs)
-	struct QueryResultNodeStruct *mRight;	// right subtree (lower Tanimoto coeffs)
-} QueryResultNode;
+#define RESULT_CHUNK_SIZE 4096			// number of records per chunk
+#define MAX_BANDS 8				// maximal number of score bands
+
+// result orders
+#define SORT_NONE 0				// order of completion
+#define SORT_TANIMOTO 1				// descending Tanimoto coefficient
+#define SORT_QUERY 2				// ascending query, then descending Tanimoto coefficient
+
+// forward declaration
+class ThreadPool;
+class ResultWriter;
+struct writerBlockStruct;
+
+// Instances of resultRecordType store one search result.
+// Query and matching Fingerprint are referred to by number.
+
+typedef struct resultRecordStruct {
+	unsigned int query;			// number of query Fingerprint
+	unsigned int print;			// record number of matching Fingerprint
+	float tanimoto;				// corresponding score, the Tanimoto coefficient by default
+} resultRecordType;
+
+// Instances of bandsType divide the results into bands of scores.
+// A result belongs to the band with the highest threshold that it
+// reaches, the search only needs the lowest threshold. The bands are
+// ordered by ascending threshold, the labels number them in the order
+// the thresholds were given.
+
+typedef struct bandsStruct {
+	int count;				// number of bands, 1 without bands
+	float thresholds[MAX_BANDS];		// lowest score of each band
+	int limits[MAX_BANDS];			// maximal number of results per query of each band, 0 for no limit
+	int labels[MAX_BANDS];			// number of each band in the order given
+} bandsType;
+
+// initialize <bands> with <count> <thresholds> and <limits> in any order
+inline void bandsInit(bandsType *bands, int count, const float *thresholds, const int *limits) {
+	bands->count = count;
+
+	// insertion sort by threshold
+	for (int i = 0; i < count; i++) {
+		int j = i;
+
+		while ((j > 0) && (bands->thresholds[j - 1] > thresholds[i])) {
+			bands->thresholds[j] = bands->thresholds[j - 1];
+			bands->limits[j] = bands->limits[j - 1];
+			bands->labels[j] = bands->labels[j - 1];
+			j--;
+		}
+
+		bands->thresholds[j] = thresholds[i];
+		bands->limits[j] = limits[i];
+		bands->labels[j] = i;
+	}
+}
+
+// get the band of a result with <score>, which reaches the lowest threshold
+inline int bandsFind(const bandsType *bands, float score) {
+	int band = bands->count - 1;
+
+	while ((band > 0) && !(score >= bands->thresholds[band])) {
+		band--;
+	}
+
+	return band;
+}
+
+// Instances of resultChunkType hold a fixed number of
+// records and are linked to lists.
+
+typedef struct resultChunkStruct {
+	resultRecordType records[RESULT_CHUNK_SIZE];	// stored records
+	int size;					// number of used records
+	struct resultChunkStruct *next;			// next chunk of the list
+} resultChunkType;
+
+// Instances of resultBufferType hold the records added by
+// one thread. If the results per query are limited, the
+// records of the current task are kept in a min-heap first.
+// Buffers of different threads do not share a cache line.
+
+typedef struct resultBufferStruct {
+	resultChunkType *first;			// first chunk of list
+	resultChunkType *last;			// chunk that records are appended to
+	long long size;				// number of records in all chunks
+	resultRecordType *heap;			// best records of the current task, one heap per band
+	int heapSize[MAX_BANDS];		// number of records in the heap of each band
+	struct writerBlockStruct *block;	// block for the ResultWriter, NULL if none
+	char pad[CACHE_LINE];			// padding to next buffer
+} resultBufferType;
+
+// Instances of queryIdType map a query number to
+// a copy of the query's id.
+
+typedef struct queryIdStruct {
+	long long index;			// number of query Fingerprint
+	char *id;				// copy of ID of query Fingerprint
+} queryIdType;
 
 // Objects of class QueryResult store search results,
-// which consist of a Fingerprint and the computed
-// Tanimoto coefficient. The QueryResult is designed as
-// a sorted tree. On construction the QueryResult can be
-// flagged to sort the results while collecting them by
-// the Tanimoto coefficient or not. 
-// if a result file is specified the search results
-// will be stored directly into this file without
-// using internal memory
+// which consist of a query, a Fingerprint and the computed
+// Tanimoto coefficient.
+//
+// Each thread appends its results to its own buffer without
+// locking. A buffer is a list of chunks that are taken from a
+// shared free list. If a ResultWriter is given, a thread hands
+// its buffer over to the writer whenever the buffer is large
+// enough after a task and the writer returns the chunks after
+// writing them. Otherwise the buffers of all threads are merged
+// into one array when the search is complete. The array is
+// optionally sorted by a parallel radix sort.
+//
+// Results refer to their query by number, the ids of
+// queries with results are registered once per query.
+//
+// The number of results per query can be limited. Each
+// query is then searched by a single task, which keeps the
+// best results in a bounded heap. Once the heap is full, its
+// lowest score is the threshold for the rest of the search.
+//
+// Results can be divided into bands of scores, which are
+// limited separately. Each band has a heap of its own, only
+// the heap of the lowest band raises the threshold.
 
 class QueryResult {
 	private:
 	
-	QueryResultNode *mRootNode;		// root node of sorted tree or linked list
-	int mSize;				// size of result set
-	int mSort;				// flag if the query results have ro be sorted
-	pthread_mutex_t mAddMutex;		// thread save insertion mutex
-	FILE *mResultFile;			// file descriptor for the optional result file
-	const char *mSeperator;			// column seperator for csv output
+	resultBufferType *mBuffers;		// one buffer per thread and one for other threads
+	int mThreads;				// number of worker threads
+	resultChunkType *mFreeChunks;		// list of chunks for re-use
+	pthread_mutex_t mChunkMutex;		// mutex for the list of free chunks
+	resultRecordType *mRecords;		// merged records
+	long long mSize;			// number of merged or written records
+	int mSort;				// order of merged results, SORT_NONE, SORT_TANIMOTO or SORT_QUERY
+	int mLimit;				// maximal number of results per query of all bands, 0 for no limit
+	bandsType mBands;			// bands of the scores
+	int mHeapStart[MAX_BANDS + 1];		// first record of the heap of each band
+	measureType mMeasure;			// similarity measure of the scores
+	RecordTable *mRecordTable;		// ids and duplicates by record number
+	ResultWriter *mWriter;			// writer for the optional result file
+	queryIdType *mQueryIds;			// ids of queries with results
+	long long mQueryIdCount;		// number of registered query ids
+	long long mQueryIdCapacity;		// allocated size of mQueryIds
+	int mQueryIdsSorted;			// flag if mQueryIds is sorted by number
+	pthread_mutex_t mIdMutex;		// mutex for registering query ids
+
+	static __thread int sThreadSlot;	// worker slot of the calling thread, -1 for other threads
+
+	resultChunkType *getChunk();		// take a chunk from the free list or allocate one
+
+	// get buffer of the calling thread
+	inline resultBufferType *getBuffer() {
+		return &mBuffers[(sThreadSlot < 0) ? mThreads : sThreadSlot];
+	}
+
+	// append a record to <buffer>
+	inline void append(resultBufferType *buffer, unsigned int query, unsigned int print, float tanimoto) {
+		resultChunkType *chunk = buffer->last;
+		resultRecordType *record;
 
-	void deleteNode(QueryResultNode *node);	// delete a node and all its subnodes
+		if ((chunk == NULL) || (chunk->size == RESULT_CHUNK_SIZE)) {
+			// append a new chunk
+			chunk = getChunk();
+			if (buffer->last == NULL) {
+				buffer->first = chunk;
+			} else {
+				buffer->last->next = chunk;
+			}
+			buffer->last = chunk;
+		}
+
+		record = &(chunk->records[chunk->size++]);
+		record->query = query;
+		record->print = print;
+		record->tanimoto = tanimoto;
+		buffer->size++;
+	}
+
+	// keep a record in the heap of <buffer> if it is among the best
+	// and raise <minTanimoto> once the heap is full
+	void addLimited(resultBufferType *buffer, unsigned int query, unsigned int print, float tanimoto, float *minTanimoto);
+
+	// hand the records of <buffer> over to the ResultWriter
+	void submitBuffer(resultBufferType *buffer);
 
 	public:
 
 	// constructor
-	QueryResult(int sort, FILE *resultFile, const char *seperator);
+	// <writer> receives the results if given, otherwise they are kept in memory
+	// <records> chains the duplicates of the records, NULL if there are none
+	// <threads> is the number of worker threads that add results
+	QueryResult(int sort, ResultWriter *writer, RecordTable *records, int threads);
 
 	// destructor
 	~QueryResult();
+
+	// set worker slot of the calling thread
+	static void setThreadSlot(int slot);
 	
-	// add a Fingerprint and the corresponding Tanimoto coefficient to the query result
-	void add(char *queryId, Fingerprint *print, float tanimoto);
-	
-	// return root node for reading
-	inline QueryResultNode *getRootNode() {
-		return mRootNode;
+	// set maximal number of results per query of each band, 0 for no limit
+	// must be called before searching
+	void setLimit(int limit);
+
+	// get maximal number of results per query of all bands, 0 for no limit
+	inline int getLimit() {
+		return mLimit;
+	}
+
+	// divide the results into <bands>, which also sets their limits
+	// must be called before searching
+	void setBands(const bandsType *bands);
+
+	// get the bands of the results
+	inline const bandsType *getBands() {
+		return &mBands;
+	}
+
+	// set the similarity measure of the scores, the Tanimoto coefficient by default
+	// must be called before searching
+	inline void setMeasure(const measureType *measure) {
+		mMeasure = *measure;
+	}
+
+	// get the similarity measure of the scores
+	inline const measureType *getMeasure() {
+		return &mMeasure;
+	}
+
+	// add a Fingerprint and the corresponding score to the query result
+	// if the results per query are limited, the threshold <minTanimoto> may be raised
+	// only one thread that is no worker may add results at a time
+	inline void add(Fingerprint *query, Fingerprint *print, float tanimoto, float *minTanimoto) {
+		addRecord(query, (unsigned int) print->getIndex(), tanimoto, minTanimoto);
+	}
+
+	// add the Fingerprint with record number <print> like add()
+	// the duplicates chained to the record get a record each
+	inline void addRecord(Fingerprint *query, unsigned int print, float tanimoto, float *minTanimoto) {
+		while (print != NO_RECORD) {
+			if (mLimit > 0) {
+				addLimited(getBuffer(), query->getIndex(), print, tanimoto, minTanimoto);
+			} else {
+				append(getBuffer(), query->getIndex(), print, tanimoto);
+			}
+
+			print = (mRecordTable != NULL) ? mRecordTable->getDuplicate(print) : NO_RECORD;
+		}
+	}
+
+	// called when the calling thread completed a task for <query>
+	// hand the thread's results over to the ResultWriter if there are enough
+	void flush(Fingerprint *query);
+
+	// hand the remaining results of all threads over to the ResultWriter
+	// all threads have to be completed
+	void finish();
+
+	// return a list of chunks to the free list
+	void freeChunks(resultChunkType *chunk);
+
+	// merge the results of all threads into one array and sort it,
+	// the sort uses <pool> if given
+	// all threads have to be completed
+	void merge(ThreadPool *pool);
+
+	// register the id of query number <index>, called once per query with results
+	void addQueryId(long long index, const char *id);
+
+	// get the id of query number <index>, NULL if it is not registered
+	char *getQueryId(long long index);
+
+	// count the heap memory of the results in <report>
+	// chunks that are kept for re-use are counted as overhead
+	// all threads have to be completed
+	void getMemory(memoryReportType *report);
+
+	// return merged records
+	inline resultRecordType *getRecords() {
+		return mRecords;
 	}
 
 	// return size of result set
-	inline int getSize() {
-		return mSize;
+	// all threads have to be completed
+	inline long long getSize() {
+		long long size = mSize;
+
+		for (int i = 0; i <= mThreads; i++) {
+			size += mBuffers[i].size;
+		}
+
+		return size;
 	}
 };
 #endif
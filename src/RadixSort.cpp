@@ -0,0 +1,145 @@
+// RadixSort.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "RadixSort.h"
+#include "ThreadPool.h"
+
+// get first record of <block>
+static inline long long blockStart(radixSortType *sort, int block) {
+	return sort->size * block / sort->blocks;
+}
+
+// count digits of <block> for the current pass
+void radixCount(radixSortType *sort, int block) {
+	long long *counts = sort->counts[block];
+	long long end = blockStart(sort, block + 1);
+
+	for (int d = 0; d < RADIX_SIZE; d++) {
+		counts[d] = 0;
+	}
+
+	for (long long i = blockStart(sort, block); i < end; i++) {
+		counts[radixDigit(&(sort->src[i]), sort->pass)]++;
+	}
+}
+
+// scatter <block> to the offsets of the current pass
+void radixScatter(radixSortType *sort, int block) {
+	long long *offsets = sort->counts[block];
+	long long end = blockStart(sort, block + 1);
+
+	for (long long i = blockStart(sort, block); i < end; i++) {
+		sort->dst[offsets[radixDigit(&(sort->src[i]), sort->pass)]++] = sort->src[i];
+	}
+}
+
+// turn the digit counts of all blocks into offsets
+// return 0 if all records have the same digit and the pass can be skipped
+static int radixOffsets(radixSortType *sort) {
+	long long offset = 0;
+
+	for (int d = 0; d < RADIX_SIZE; d++) {
+		long long total = 0;
+
+		for (int b = 0; b < sort->blocks; b++) {
+			total += sort->counts[b][d];
+		}
+
+		if (total == sort->size) {
+			return 0;
+		}
+	}
+
+	// records of lower blocks precede records of higher blocks
+	// with the same digit, so each pass is stable
+	for (int d = 0; d < RADIX_SIZE; d++) {
+		for (int b = 0; b < sort->blocks; b++) {
+			long long count = sort->counts[b][d];
+
+			sort->counts[b][d] = offset;
+			offset += count;
+		}
+	}
+
+	return 1;
+}
+
+// sort <size> <records> stable with <passes> passes, using <pool> if given
+// return the sorted array, which is either <records> or a new array,
+// the other one is deleted
+resultRecordType *radixSort(resultRecordType *records, long long size, int passes, ThreadPool *pool) {
+	radixSortType sort;
+	resultRecordType *swap;
+
+	if (size < 2) {
+		return records;
+	}
+
+	sort.src = records;
+	sort.dst = new resultRecordType[size];
+	sort.size = size;
+	sort.blocks = 1;
+
+	// small arrays are sorted by the calling thread
+	if (pool != NULL) {
+		sort.blocks = MAX(1, MIN((long long) pool->getSize(), size / RADIX_BLOCK));
+	}
+
+	sort.counts = new long long[sort.blocks][RADIX_SIZE];
+
+	for (sort.pass = 0; sort.pass < passes; sort.pass++) {
+		if (sort.blocks == 1) {
+			radixCount(&sort, 0);
+		} else {
+			for (int b = 0; b < sort.blocks; b++) {
+				pool->countRadix(&sort, b);
+			}
+			pool->wait();
+		}
+
+		if (!radixOffsets(&sort)) {
+			continue;
+		}
+
+		if (sort.blocks == 1) {
+			radixScatter(&sort, 0);
+		} else {
+			for (int b = 0; b < sort.blocks; b++) {
+				pool->scatterRadix(&sort, b);
+			}
+			pool->wait();
+		}
+
+		swap = sort.src;
+		sort.src = sort.dst;
+		sort.dst = swap;
+	}
+
+	delete[] sort.dst;
+	delete[] sort.counts;
+
+	return sort.src;
+}
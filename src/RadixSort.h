@@ -0,0 +1,86 @@
+// RadixSort.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include "QueryResult.h"
+
+// forward declaration
+class ThreadPool;
+
+#define RADIX_BITS 8			// bits per digit
+#define RADIX_SIZE 256			// number of digit values
+#define RADIX_BLOCK 65536		// minimal number of records per parallel block
+
+#define RADIX_PASSES_TANIMOTO 4		// passes for sorting by Tanimoto coefficient
+#define RADIX_PASSES_QUERY 8		// passes for sorting by query and Tanimoto coefficient
+
+// Instances of radixSortType hold the state of one pass of a
+// parallel LSD radix sort of result records. The records are split
+// into blocks. Each block's digits are counted by one task, then
+// each block is scattered by one task to the offsets computed from
+// all counts. Passes 0 to 3 sort by descending Tanimoto coefficient,
+// passes 4 to 7 by ascending query number.
+typedef struct radixSortStruct {
+	resultRecordType *src;		// records to scatter
+	resultRecordType *dst;		// destination of scattered records
+	long long size;			// number of records
+	int blocks;			// number of blocks
+	int pass;			// current pass
+	long long (*counts)[RADIX_SIZE];	// digit counts, then offsets of each block
+} radixSortType;
+
+// get digit of <record> for <pass>
+inline unsigned int radixDigit(resultRecordType *record, int pass) {
+	unsigned int key;
+
+	if (pass < 4) {
+		// floats compare like their bit patterns with the sign bit set for
+		// non-negative and all bits inverted for negative values, such as
+		// negated Hamming distances; inverting them gives a descending order
+		memcpy(&key, &(record->tanimoto), sizeof(key));
+		key = (key & 0x80000000u) ? key : ~(key | 0x80000000u);
+	} else {
+		key = record->query;
+		pass -= 4;
+	}
+
+	return (key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+}
+
+// count digits of <block> for the current pass
+void radixCount(radixSortType *sort, int block);
+
+// scatter <block> to the offsets of the current pass
+void radixScatter(radixSortType *sort, int block);
+
+// sort <size> <records> stable with <passes> passes, using <pool> if given
+// return the sorted array, which is either <records> or a new array,
+// the other one is deleted
+resultRecordType *radixSort(resultRecordType *records, long long size, int passes, ThreadPool *pool);
+
+#endif
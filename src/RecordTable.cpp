@@ -0,0 +1,98 @@
+// RecordTable.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "RecordTable.h"
+
+// constructor
+RecordTable::RecordTable() {
+	mSize = 0;
+	mCapacity = RECORD_TABLE_CAPACITY;
+	mIdStart = new long long[mCapacity];
+	mDuplicates = new unsigned int[mCapacity];
+	mIdBytes = 0;
+	mIdCapacity = 16 * RECORD_TABLE_CAPACITY;
+	mIds = new char[mIdCapacity];
+}
+
+// destructor
+RecordTable::~RecordTable() {
+	delete[] mIds;
+	delete[] mIdStart;
+	delete[] mDuplicates;
+}
+
+// add a record with a copy of <id>, which may be NULL
+// return its record number
+// the arrays are doubled when they are full
+long long RecordTable::add(const char *id) {
+	long long length = (id != NULL) ? strlen(id) + 1 : 0;
+
+	if (mSize == mCapacity) {
+		long long *idStart = new long long[2 * mCapacity];
+		unsigned int *duplicates = new unsigned int[2 * mCapacity];
+
+		memcpy(idStart, mIdStart, mSize * sizeof(long long));
+		memcpy(duplicates, mDuplicates, mSize * sizeof(unsigned int));
+		delete[] mIdStart;
+		delete[] mDuplicates;
+		mIdStart = idStart;
+		mDuplicates = duplicates;
+		mCapacity *= 2;
+	}
+
+	if (mIdBytes + length > mIdCapacity) {
+		char *ids;
+
+		while (mIdBytes + length > mIdCapacity) {
+			mIdCapacity *= 2;
+		}
+
+		ids = new char[mIdCapacity];
+		memcpy(ids, mIds, mIdBytes);
+		delete[] mIds;
+		mIds = ids;
+	}
+
+	if (id != NULL) {
+		memcpy(&mIds[mIdBytes], id, length);
+		mIdStart[mSize] = mIdBytes;
+		mIdBytes += length;
+	} else {
+		mIdStart[mSize] = -1;
+	}
+
+	mDuplicates[mSize] = NO_RECORD;
+
+	return mSize++;
+}
+
+// count the heap memory of the table in <report>
+// unused capacity is counted as overhead
+void RecordTable::getMemory(memoryReportType *report) {
+	memoryAdd(report, MEMORY_IDS, mIds, mIdCapacity, mIdBytes);
+	memoryAdd(report, MEMORY_IDS, mIdStart, mCapacity * sizeof(long long), mSize * sizeof(long long));
+	memoryAdd(report, MEMORY_GRID, mDuplicates, mCapacity * sizeof(unsigned int), mSize * sizeof(unsigned int));
+}
@@ -0,0 +1,88 @@
+// RecordTable.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RECORDTABLE_H
+#define RECORDTABLE_H
+
+#include "Memory.h"
+
+#define RECORD_TABLE_CAPACITY 1024	// initial number of records
+#define NO_RECORD 0xFFFFFFFFu		// end of a chain of duplicates
+
+// Objects of class RecordTable hold the ids of the records of a grid by
+// record number and chain the records with equal bits. The results refer
+// to records by number, so the fingerprints of a grid are not needed to
+// write them and a grid whose cells are stored only keeps this table.
+//
+// The ids are packed into one array, a record costs its id, an offset
+// and the number of its next duplicate.
+
+class RecordTable {
+	private:
+
+	char *mIds;			// null-terminated ids of all records
+	long long mIdBytes;		// used size of mIds
+	long long mIdCapacity;		// allocated size of mIds
+	long long *mIdStart;		// start of each id in mIds, -1 if the record has none
+	unsigned int *mDuplicates;	// next record with the same bits, NO_RECORD if none
+	long long mSize;		// number of records
+	long long mCapacity;		// allocated size of mIdStart and mDuplicates
+
+	public:
+
+	// constructor
+	RecordTable();
+
+	// destructor
+	~RecordTable();
+
+	// add a record with a copy of <id>, which may be NULL
+	// return its record number
+	long long add(const char *id);
+
+	// get id of <record>, NULL if it has none
+	inline const char *getId(long long record) {
+		return (mIdStart[record] >= 0) ? &mIds[mIdStart[record]] : NULL;
+	}
+
+	// get the next record with the same bits as <record>, NO_RECORD if there is none
+	inline unsigned int getDuplicate(unsigned int record) {
+		return mDuplicates[record];
+	}
+
+	// chain <duplicate> to <record>, which has the same bits
+	inline void setDuplicate(unsigned int record, unsigned int duplicate) {
+		mDuplicates[record] = duplicate;
+	}
+
+	// get number of records
+	inline long long getSize() {
+		return mSize;
+	}
+
+	// count the heap memory of the table in <report>
+	void getMemory(memoryReportType *report);
+};
+#endif
@@ -0,0 +1,461 @@
+// ResultWriter.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "ResultWriter.h"
+
+// thread start function
+static void *writerWrapper(void *p) {
+	((ResultWriter*) p)->writer();
+
+	return NULL;
+}
+
+// format <integer> into <str> like "%llu", return number of characters
+static int formatInteger(char *str, unsigned long long integer) {
+	char digits[20];
+	int n = 0;
+	int len = 0;
+
+	do {
+		digits[n++] = '0' + (integer % 10);
+		integer /= 10;
+	} while (integer > 0);
+
+	while (n > 0) {
+		str[len++] = digits[--n];
+	}
+
+	return len;
+}
+
+// format non-negative <value> with 7 decimals into <str> like "%.7f"
+// return number of characters
+static int formatTanimoto(char *str, float value) {
+	// the product is exact in double precision, so ties are rounded to
+	// even like printf does
+	double exact = (double) value * 10000000.0;
+	unsigned long long scaled = (unsigned long long) exact;
+	double fraction = exact - (double) scaled;
+	int len;
+
+	if ((fraction > 0.5) || ((fraction == 0.5) && (scaled & 1))) {
+		scaled++;
+	}
+
+	// integer part
+	len = formatInteger(str, scaled / 10000000);
+
+	// decimals
+	str[len++] = '.';
+	scaled %= 10000000;
+	for (int i = len + 6; i >= len; i--) {
+		str[i] = '0' + (scaled % 10);
+		scaled /= 10;
+	}
+
+	return len + 7;
+}
+
+// constructor
+// open <files> result files and write the headers, check with isOpen()
+// the results of all bands are written to <filenames>[0] if <files> is 1,
+// otherwise the results of each band to the file of its label
+// the filename "-" writes to the standard output
+// the score column is named after <measure> or, if it is NULL, "score" for
+// the weighted mean Tanimoto coefficients of composite records; <bands> may be NULL
+ResultWriter::ResultWriter(const char **filenames, int files, int format, const char *seperator, RecordTable *records, const measureType *measure, const bandsType *bands) {
+	mFormat = format;
+	mMeasure = (measure != NULL) ? measure->type : MEASURE_TANIMOTO;
+	mScoreName = (measure != NULL) ? MEASURE_NAMES[mMeasure] : "score";
+	mSeperator = seperator;
+	mSeperatorLength = strlen(seperator);
+	mRecords = records;
+	mOutputCount = files;
+	mFirst = NULL;
+	mLast = NULL;
+	mQueued = 0;
+	mClosing = 0;
+
+	if (bands != NULL) {
+		mBands = *bands;
+	} else {
+		mBands.count = 1;
+		mBands.labels[0] = 0;
+	}
+
+	// a single file of several bands has a column for the band
+	mBandColumn = (files == 1) && (mBands.count > 1);
+
+	for (int i = 0; i < mOutputCount; i++) {
+		const char *filename = filenames[(files == 1) ? 0 : mBands.labels[i]];
+		writerOutputType *out = &mOutputs[i];
+
+		out->buffer = new char[WRITER_BUFFER_SIZE];
+		out->bufferSize = 0;
+
+		if (strcmp(filename, "-") == 0) {
+			out->file = stdout;
+		} else {
+			out->file = fopen(filename, (format == FORMAT_BINARY) ? "wb" : "w");
+		}
+	}
+
+	for (int i = 0; i < mOutputCount; i++) {
+		if (mOutputs[i].file == NULL) {
+			// close the other files, isOpen() fails
+			for (int j = 0; j < mOutputCount; j++) {
+				if ((mOutputs[j].file != NULL) && (mOutputs[j].file != stdout)) {
+					fclose(mOutputs[j].file);
+				}
+				mOutputs[j].file = NULL;
+			}
+			return;
+		}
+	}
+
+	// write headers
+	for (int i = 0; i < mOutputCount; i++) {
+		writerOutputType *out = &mOutputs[i];
+
+		if (format == FORMAT_BINARY) {
+			unsigned int header[3] = {BINARY_VERSION, BINARY_ENDIAN, sizeof(resultRecordType)};
+
+			output(out, BINARY_MAGIC, 4);
+			output(out, (const char*) header, sizeof(header));
+		} else {
+			output(out, "query", 5);
+			output(out, mSeperator, mSeperatorLength);
+			output(out, "fingerprint", 11);
+			output(out, mSeperator, mSeperatorLength);
+			output(out, mScoreName, strlen(mScoreName));
+			if (mBandColumn) {
+				output(out, mSeperator, mSeperatorLength);
+				output(out, "band", 4);
+			}
+			output(out, "\n", 1);
+		}
+	}
+
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mNotEmpty, NULL);
+	pthread_cond_init(&mNotFull, NULL);
+	pthread_create(&mThread, NULL, writerWrapper, (void*) this);
+}
+
+// destructor
+// close() has to be called before
+ResultWriter::~ResultWriter() {
+	for (int i = 0; i < mOutputCount; i++) {
+		delete[] mOutputs[i].buffer;
+	}
+}
+
+// write <size> bytes through the output buffer of <out>
+void ResultWriter::output(writerOutputType *out, const char *data, int size) {
+	if (out->bufferSize + size > WRITER_BUFFER_SIZE) {
+		outputBuffer(out);
+	}
+
+	// write large data directly
+	if (size > WRITER_BUFFER_SIZE) {
+		fwrite(data, 1, size, out->file);
+		return;
+	}
+
+	memcpy(out->buffer + out->bufferSize, data, size);
+	out->bufferSize += size;
+}
+
+// write output buffer of <out> to its file
+void ResultWriter::outputBuffer(writerOutputType *out) {
+	if (out->bufferSize > 0) {
+		fwrite(out->buffer, 1, out->bufferSize, out->file);
+		out->bufferSize = 0;
+	}
+}
+
+// write <size> records in binary format
+// with a file per band, each record goes to the file of its band
+void ResultWriter::outputBinary(resultRecordType *records, long long size) {
+	if (mOutputCount == 1) {
+		for (long long i = 0; i < size; i += WRITER_BLOCK_SIZE) {
+			output(&mOutputs[0], (const char*) &records[i], MIN((long long) WRITER_BLOCK_SIZE, size - i) * sizeof(resultRecordType));
+		}
+		return;
+	}
+
+	for (long long i = 0; i < size; i++) {
+		output(&mOutputs[bandsFind(&mBands, records[i].tanimoto)], (const char*) &records[i], sizeof(resultRecordType));
+	}
+}
+
+// write one record in csv format
+void ResultWriter::outputCsv(const char *queryId, resultRecordType *record) {
+	const char *printId = mRecords->getId(record->print);
+	int queryLength = strlen(queryId);
+	int printLength = strlen(printId);
+	int band = (mOutputCount > 1) || mBandColumn ? bandsFind(&mBands, record->tanimoto) : 0;
+	writerOutputType *out = &mOutputs[(mOutputCount > 1) ? band : 0];
+	char *str;
+
+	if (out->bufferSize + queryLength + printLength + 3 * mSeperatorLength + 48 > WRITER_BUFFER_SIZE) {
+		outputBuffer(out);
+	}
+
+	str = out->buffer + out->bufferSize;
+
+	memcpy(str, queryId, queryLength);
+	str += queryLength;
+	memcpy(str, mSeperator, mSeperatorLength);
+	str += mSeperatorLength;
+	memcpy(str, printId, printLength);
+	str += printLength;
+	memcpy(str, mSeperator, mSeperatorLength);
+	str += mSeperatorLength;
+	if (mMeasure == MEASURE_HAMMING) {
+		// distances are stored negated
+		str += formatInteger(str, (unsigned long long) -record->tanimoto);
+	} else {
+		str += formatTanimoto(str, record->tanimoto);
+	}
+	if (mBandColumn) {
+		memcpy(str, mSeperator, mSeperatorLength);
+		str += mSeperatorLength;
+		str += formatInteger(str, mBands.labels[band] + 1);
+	}
+	*(str++) = '\n';
+
+	out->bufferSize = str - out->buffer;
+}
+
+// write a block
+void ResultWriter::writeBlock(writerBlockType *block) {
+	if (block->first == NULL) {
+		// merged records
+		if (mFormat == FORMAT_BINARY) {
+			outputBinary(block->records, block->size);
+		} else {
+			for (long long i = 0; i < block->size; i++) {
+				outputCsv(block->result->getQueryId(block->records[i].query), &(block->records[i]));
+			}
+		}
+	} else {
+		// chunks of a thread's buffer
+		if (mFormat == FORMAT_BINARY) {
+			for (resultChunkType *chunk = block->first; chunk != NULL; chunk = chunk->next) {
+				outputBinary(chunk->records, chunk->size);
+			}
+		} else {
+			const char *id = block->ids;
+			int query = 0;
+			long long remaining = (block->queries > 0) ? block->counts[0] : 0;
+
+			for (resultChunkType *chunk = block->first; chunk != NULL; chunk = chunk->next) {
+				for (int i = 0; i < chunk->size; i++) {
+					// records are grouped by query
+					while (remaining == 0) {
+						id += strlen(id) + 1;
+						query++;
+						remaining = block->counts[query];
+					}
+
+					outputCsv(id, &(chunk->records[i]));
+					remaining--;
+				}
+			}
+		}
+
+		block->result->freeChunks(block->first);
+	}
+
+	if (block->ids != NULL) {
+		delete[] block->ids;
+		delete[] block->counts;
+	}
+	delete block;
+}
+
+// writing thread main loop
+void ResultWriter::writer() {
+	writerBlockType *block;
+
+	while (1) {
+		pthread_mutex_lock(&mMutex);
+
+		while ((mFirst == NULL) && !mClosing) {
+			pthread_cond_wait(&mNotEmpty, &mMutex);
+		}
+
+		block = mFirst;
+		if (block != NULL) {
+			mFirst = block->next;
+			if (mFirst == NULL) {
+				mLast = NULL;
+			}
+			mQueued--;
+			pthread_cond_signal(&mNotFull);
+		}
+
+		pthread_mutex_unlock(&mMutex);
+
+		if (block == NULL) {
+			// closing and queue is empty
+			break;
+		}
+
+		writeBlock(block);
+	}
+
+	for (int i = 0; i < mOutputCount; i++) {
+		outputBuffer(&mOutputs[i]);
+	}
+}
+
+// create an empty block for <result>
+writerBlockType *ResultWriter::newBlock(QueryResult *result) {
+	writerBlockType *block = new writerBlockType;
+
+	block->first = NULL;
+	block->records = NULL;
+	block->size = 0;
+	block->ids = NULL;
+	block->idsSize = 0;
+	block->idsCapacity = 0;
+	block->counts = NULL;
+	block->queries = 0;
+	block->queriesCapacity = 0;
+	block->result = result;
+	block->next = NULL;
+
+	return block;
+}
+
+// register <count> records of the query with <id> in <block>
+void ResultWriter::addQuery(writerBlockType *block, const char *id, long long count) {
+	int length = strlen(id) + 1;
+
+	block->size += count;
+
+	// binary output needs no ids
+	if (mFormat == FORMAT_BINARY) {
+		return;
+	}
+
+	// grow arrays if necessary
+	if (block->idsSize + length > block->idsCapacity) {
+		char *ids;
+
+		block->idsCapacity = MAX(2 * block->idsCapacity, block->idsSize + length + 1024);
+		ids = new char[block->idsCapacity];
+		if (block->ids != NULL) {
+			memcpy(ids, block->ids, block->idsSize);
+			delete[] block->ids;
+		}
+		block->ids = ids;
+	}
+
+	if (block->queries == block->queriesCapacity) {
+		long long *counts;
+
+		block->queriesCapacity = MAX(2 * block->queriesCapacity, 64);
+		counts = new long long[block->queriesCapacity];
+		if (block->counts != NULL) {
+			memcpy(counts, block->counts, block->queries * sizeof(long long));
+			delete[] block->counts;
+		}
+		block->counts = counts;
+	}
+
+	memcpy(block->ids + block->idsSize, id, length);
+	block->idsSize += length;
+	block->counts[block->queries++] = count;
+}
+
+// queue <block> for writing, wait if the queue is full
+void ResultWriter::submit(writerBlockType *block) {
+	pthread_mutex_lock(&mMutex);
+
+	while (mQueued >= WRITER_QUEUE_SIZE) {
+		pthread_cond_wait(&mNotFull, &mMutex);
+	}
+
+	block->next = NULL;
+	if (mLast == NULL) {
+		mFirst = block;
+	} else {
+		mLast->next = block;
+	}
+	mLast = block;
+	mQueued++;
+
+	pthread_cond_signal(&mNotEmpty);
+	pthread_mutex_unlock(&mMutex);
+}
+
+// queue <size> merged <records> of <result> for writing
+// the records must stay valid until close() returns
+void ResultWriter::submitRecords(QueryResult *result, resultRecordType *records, long long size) {
+	writerBlockType *block = newBlock(result);
+
+	block->records = records;
+	block->size = size;
+
+	submit(block);
+}
+
+// write all queued blocks and close the files
+// return 0 if all data has been written, -1 otherwise
+int ResultWriter::close() {
+	int status = 1;
+
+	if (!isOpen()) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&mMutex);
+	mClosing = 1;
+	pthread_cond_signal(&mNotEmpty);
+	pthread_mutex_unlock(&mMutex);
+
+	pthread_join(mThread, NULL);
+
+	pthread_mutex_destroy(&mMutex);
+	pthread_cond_destroy(&mNotEmpty);
+	pthread_cond_destroy(&mNotFull);
+
+	for (int i = 0; i < mOutputCount; i++) {
+		FILE *file = mOutputs[i].file;
+
+		status = (fflush(file) == 0) && !ferror(file) && status;
+
+		if (file != stdout) {
+			status = (fclose(file) == 0) && status;
+		}
+		mOutputs[i].file = NULL;
+	}
+
+	return status ? 0 : -1;
+}
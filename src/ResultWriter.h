@@ -0,0 +1,171 @@
+// ResultWriter.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include "QueryResult.h"
+#include "Fingerprint.h"
+#include "RecordTable.h"
+
+#define WRITER_BLOCK_SIZE (16 * RESULT_CHUNK_SIZE)	// records per block handed to the writer
+#define WRITER_QUEUE_SIZE 64				// maximal number of queued blocks
+#define WRITER_BUFFER_SIZE (1 << 20)			// size of output buffer in bytes
+
+// result file formats
+#define FORMAT_CSV 0		// text with query id, Fingerprint id and score
+#define FORMAT_BINARY 1		// header followed by the raw result records
+
+// header of binary result files
+#define BINARY_MAGIC "MBTR"	// file type
+#define BINARY_VERSION 1	// format version
+#define BINARY_ENDIAN 0x01020304	// byte order check
+
+// Instances of writerBlockType hold results that are handed to a
+// ResultWriter. The records are either a list of chunks of one
+// thread's buffer or an array of merged records. For csv output,
+// a block of chunks holds the ids of its queries, since the query
+// Fingerprints are re-used before the block is written.
+
+typedef struct writerBlockStruct {
+	resultChunkType *first;		// list of chunks, NULL for an array
+	resultRecordType *records;	// array of merged records
+	long long size;			// number of records
+	char *ids;			// ids of the queries, one after the other
+	int idsSize;			// used size of ids
+	int idsCapacity;		// allocated size of ids
+	long long *counts;		// number of records of each query
+	int queries;			// number of queries
+	int queriesCapacity;		// allocated size of counts
+	QueryResult *result;		// QueryResult that receives the chunks back
+	struct writerBlockStruct *next;	// next block in queue
+} writerBlockType;
+
+// Instances of writerOutputType hold a result file and its output buffer.
+
+typedef struct writerOutputStruct {
+	FILE *file;			// result file
+	char *buffer;			// output buffer
+	int bufferSize;			// used size of buffer
+} writerOutputType;
+
+// Objects of class ResultWriter write search results to a file in
+// a thread of their own. Worker threads hand over large blocks of
+// records, so they neither format nor wait for the file. Numbers are
+// formatted without printf into a large output buffer.
+//
+// The binary format starts with a 16 byte header: the magic string
+// "MBTR", the version, the number 0x01020304 to check the byte order
+// and the record size. It is followed by the records, each holding
+// the query number, the record number of the matching Fingerprint
+// (both 32 bit unsigned integers, starting with 0) and the score as
+// 32 bit float. Scores are the Tanimoto coefficient by default, Hamming
+// distances are stored negated in binary files.
+//
+// Results that are divided into bands of scores are either written to
+// one file with a column for the band or to one file per band. Binary
+// files have no band column, the band follows from the score.
+
+class ResultWriter {
+	private:
+
+	writerOutputType mOutputs[MAX_BANDS];	// result files, one per band or a single one
+	int mOutputCount;		// number of result files
+	bandsType mBands;		// bands of the scores
+	int mBandColumn;		// flag if csv output has a column for the band
+	int mFormat;			// FORMAT_CSV or FORMAT_BINARY
+	int mMeasure;			// measure of the scores, MEASURE_TANIMOTO by default
+	const char *mScoreName;		// name of the score column
+	const char *mSeperator;		// column seperator for csv output
+	int mSeperatorLength;		// length of mSeperator
+	RecordTable *mRecords;		// ids by record number
+	writerBlockType *mFirst;	// first queued block
+	writerBlockType *mLast;		// last queued block
+	int mQueued;			// number of queued blocks
+	int mClosing;			// flag if no more blocks are submitted
+	pthread_t mThread;		// writing thread
+	pthread_mutex_t mMutex;		// mutex for the queue
+	pthread_cond_t mNotEmpty;	// signalled when a block is queued
+	pthread_cond_t mNotFull;	// signalled when a block is taken
+
+	// write <size> bytes through the output buffer of <out>
+	void output(writerOutputType *out, const char *data, int size);
+
+	// write output buffer of <out> to its file
+	void outputBuffer(writerOutputType *out);
+
+	// write <size> records in binary format
+	void outputBinary(resultRecordType *records, long long size);
+
+	// write one record in csv format
+	void outputCsv(const char *queryId, resultRecordType *record);
+
+	// write a block
+	void writeBlock(writerBlockType *block);
+
+	public:
+
+	// constructor
+	// open <files> result files and write the headers, check with isOpen()
+	// the results of all bands are written to <filenames>[0] if <files> is 1,
+	// otherwise the results of each band to the file of its label
+	// the filename "-" writes to the standard output
+	// the score column is named after <measure> or, if it is NULL, "score" for
+	// the weighted mean Tanimoto coefficients of composite records; <bands> may be NULL
+	ResultWriter(const char **filenames, int files, int format, const char *seperator, RecordTable *records, const measureType *measure, const bandsType *bands);
+
+	// destructor
+	// close() has to be called before
+	~ResultWriter();
+
+	// check if the files could be opened
+	inline int isOpen() {
+		return mOutputs[0].file != NULL;
+	}
+
+	// writing thread main loop
+	void writer();
+
+	// create an empty block for <result>
+	writerBlockType *newBlock(QueryResult *result);
+
+	// register <count> records of the query with <id> in <block>
+	void addQuery(writerBlockType *block, const char *id, long long count);
+
+	// queue <block> for writing, wait if the queue is full
+	void submit(writerBlockType *block);
+
+	// queue <size> merged <records> of <result> for writing
+	// the records must stay valid until close() returns
+	void submitRecords(QueryResult *result, resultRecordType *records, long long size);
+
+	// write all queued blocks and close the files
+	// return 0 if all data has been written, -1 otherwise
+	int close();
+};
+#endif
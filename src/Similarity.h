@@ -0,0 +1,252 @@
+// Similarity.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "Misc.h"
+
+// This file contains the similarity measures of a search. A query with
+// cardinality a and a print with cardinality b that have c common bits score
+//
+//	Tanimoto	c / (a + b - c)
+//	Dice		2c / (a + b)
+//	Tversky		c / (c + alpha (a - c) + beta (b - c))
+//	Hamming		-(a + b - 2c), the negated distance
+//
+// Scores are compared by "higher is better" everywhere, so a Hamming search
+// with a maximal distance d uses the threshold -d, and the distance is only
+// restored for the output.
+//
+// For fixed cardinalities all scores grow with the number of common bits.
+// The threshold of a measure is therefore equivalent to a minimal Tanimoto
+// coefficient for each pair of cardinalities, and the trees and scans filter
+// by this coefficient with their Tanimoto bounds. This is exact: a print is
+// only scored if it reaches the threshold of the measure.
+
+#define MEASURE_TANIMOTO 0		// Tanimoto coefficient
+#define MEASURE_DICE 1			// Dice coefficient
+#define MEASURE_TVERSKY 2		// Tversky index with weights alpha and beta
+#define MEASURE_HAMMING 3		// negated Hamming distance
+#define MEASURES 4			// number of measures
+
+// names of the measures
+static const char * const MEASURE_NAMES[MEASURES] = {"tanimoto", "dice", "tversky", "hamming"};
+
+// Instances of measureType describe the similarity measure of a search.
+typedef struct measureStruct {
+	int type;			// MEASURE_TANIMOTO, MEASURE_DICE, MEASURE_TVERSKY or MEASURE_HAMMING
+	float alpha;			// Tversky weight of the bits only set in the query
+	float beta;			// Tversky weight of the bits only set in the print
+} measureType;
+
+// Instances of scoreFilterType hold the threshold of a search for a query with
+// cardinality <queryCard> in prints with cardinality <printCard>. The threshold
+// can be raised during the search if the results per query are limited, the
+// equivalent Tanimoto coefficient is then computed again.
+typedef struct scoreFilterStruct {
+	const measureType *measure;	// measure of the scores
+	int queryCard;			// cardinality of the query
+	int printCard;			// cardinality of the prints
+	float *minScore;		// threshold of the scores
+	float lastScore;		// threshold that minTanimoto was computed for
+	float minTanimoto;		// equivalent Tanimoto coefficient
+} scoreFilterType;
+
+// set <measure> to the Tanimoto coefficient
+inline void measureInit(measureType *measure) {
+	measure->type = MEASURE_TANIMOTO;
+	measure->alpha = 1;
+	measure->beta = 1;
+}
+
+// parse a measure from <name>: "tanimoto", "dice", "hamming" or "tversky:alpha,beta"
+// return 0 if the name or the weights are invalid
+inline int measureParse(const char *name, measureType *measure) {
+	char *end;
+
+	measureInit(measure);
+
+	for (int i = 0; i < MEASURES; i++) {
+		if ((i != MEASURE_TVERSKY) && (strcmp(name, MEASURE_NAMES[i]) == 0)) {
+			measure->type = i;
+			return 1;
+		}
+	}
+
+	if (strncmp(name, "tversky:", 8) != 0) {
+		return 0;
+	}
+
+	measure->type = MEASURE_TVERSKY;
+	measure->alpha = strtod(name + 8, &end);
+
+	if (*end != ',') {
+		return 0;
+	}
+
+	measure->beta = strtod(end + 1, &end);
+
+	return (*end == 0) && (measure->alpha >= 0) && (measure->beta >= 0) && (measure->alpha + measure->beta > 0);
+}
+
+// compute the score of a query with cardinality <a> and a print with cardinality <b>
+// that have <c> common bits, the Tanimoto coefficient is computed like Fingerprint::tanimoto
+inline float measureScore(const measureType *measure, int a, int b, int c) {
+	switch (measure->type) {
+		case MEASURE_DICE:
+			return ((float) (2 * c)) / (a + b);
+		case MEASURE_TVERSKY:
+			return ((float) c) / (c + measure->alpha * (a - c) + measure->beta * (b - c));
+		case MEASURE_HAMMING:
+			return (float) -(a + b - 2 * c);
+		default:
+			return ((float) c) / (a + b - c);
+	}
+}
+
+// convert a threshold or score of <measure> between the user's and the internal scale,
+// a Hamming distance is negated, the other scores are kept
+inline float measureValue(const measureType *measure, float value) {
+	return (measure->type == MEASURE_HAMMING) ? -value : value;
+}
+
+// compute the range of print cardinalities <min> to <max>-1 up to <nBits> that
+// can reach <minScore> with a query of cardinality <card>
+// the best score of a print with cardinality b has min(card, b) common bits,
+// it grows with b up to <card> and falls beyond
+inline void measureCardRange(const measureType *measure, int card, float minScore, int nBits, int *min, int *max) {
+	int lo, hi, mid;
+
+	if (!(measureScore(measure, card, card, card) >= minScore)) {
+		*min = MIN(card, nBits + 1);
+		*max = *min;
+		return;
+	}
+
+	// smallest cardinality below the query's that can reach the threshold
+	lo = 0;
+	hi = MIN(card, nBits);
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (measureScore(measure, card, mid, mid) >= minScore) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	*min = lo;
+
+	// largest cardinality above the query's that can reach the threshold
+	lo = MIN(card, nBits);
+	hi = nBits;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (measureScore(measure, card, mid, card) >= minScore) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	*max = lo + 1;
+}
+
+// compute the minimal Tanimoto coefficient of a query with cardinality <a> and a print
+// with cardinality <b> that reach <minScore>, larger than 1 if they cannot reach it
+inline float measureTanimoto(const measureType *measure, int a, int b, float minScore) {
+	int lo = 0;
+	int hi = MIN(a, b);
+	int mid;
+
+	if (!(measureScore(measure, a, b, hi) >= minScore)) {
+		return 2.0f;
+	}
+
+	// fewest common bits that reach the threshold
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (measureScore(measure, a, b, mid) >= minScore) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	return ((float) lo) / (a + b - lo);
+}
+
+// compute a Tanimoto coefficient for planning the engines of a grid that is
+// searched by <measure> and <minScore>, for prints with cardinality <card>
+inline float measurePlanTanimoto(const measureType *measure, int card, float minScore) {
+	float tanimoto = (measure->type == MEASURE_TANIMOTO) ? minScore : measureTanimoto(measure, card, card, minScore);
+
+	return MAX(MIN(tanimoto, 1.0f), 0.01f);
+}
+
+// initialize <filter> for a query with cardinality <queryCard> and prints
+// with cardinality <printCard> and the threshold at <minScore>
+inline void filterInit(scoreFilterType *filter, const measureType *measure, int queryCard, int printCard, float *minScore) {
+	filter->measure = measure;
+	filter->queryCard = queryCard;
+	filter->printCard = printCard;
+	filter->minScore = minScore;
+	filter->lastScore = *minScore;
+	filter->minTanimoto = (measure->type == MEASURE_TANIMOTO) ? *minScore : measureTanimoto(measure, queryCard, printCard, *minScore);
+}
+
+// get the minimal Tanimoto coefficient of <filter>
+inline float filterTanimoto(scoreFilterType *filter) {
+	if (filter->measure->type == MEASURE_TANIMOTO) {
+		return *filter->minScore;
+	}
+
+	if (*filter->minScore != filter->lastScore) {
+		filter->lastScore = *filter->minScore;
+		filter->minTanimoto = measureTanimoto(filter->measure, filter->queryCard, filter->printCard, filter->lastScore);
+	}
+
+	return filter->minTanimoto;
+}
+
+// get the score of a print with <common> bits in common with the query
+inline float filterScore(scoreFilterType *filter, int common) {
+	return measureScore(filter->measure, filter->queryCard, filter->printCard, common);
+}
+
+// get the score of a print with the Tanimoto coefficient <tanimoto>
+// the number of common bits is restored from the coefficient, which is exact
+// as the coefficients of consecutive numbers differ by more than the rounding
+inline float filterScoreTanimoto(scoreFilterType *filter, float tanimoto) {
+	int total = filter->queryCard + filter->printCard;
+
+	if (filter->measure->type == MEASURE_TANIMOTO) {
+		return tanimoto;
+	}
+
+	return filterScore(filter, (int) (tanimoto * total / (1 + tanimoto) + 0.5f));
+}
+#endif
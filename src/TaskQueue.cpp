@@ -0,0 +1,53 @@
+// TaskQueue.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#include "TaskQueue.h"
+
+// constructor
+// create a queue for at least <capacity> tasks
+TaskQueue::TaskQueue(int capacity) {
+	unsigned long size = 2;
+
+	// round capacity up to a power of two
+	while (size < (unsigned long) capacity) {
+		size *= 2;
+	}
+
+	mCells = new taskCellType[size];
+	mMask = size - 1;
+
+	// cell i is free for the producer at position i
+	for (unsigned long i = 0; i < size; i++) {
+		mCells[i].sequence = i;
+	}
+
+	mEnqueuePos = 0;
+	mDequeuePos = 0;
+}
+
+// destructor
+TaskQueue::~TaskQueue() {
+	delete[] mCells;
+}
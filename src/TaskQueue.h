@@ -0,0 +1,242 @@
+// TaskQueue.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TASKQUEUE_H
+#define TASKQUEUE_H
+
+#include "QueryResult.h"
+#include "Fingerprint.h"
+#include "MultibitTree.h"
+#include "RadixSort.h"
+
+// forward declaration
+class Grid1D;
+class CompositeGrid;
+class QueryPool;
+typedef struct queryBlockStruct queryBlockType;
+
+// task types
+#define TASK_CREATE		1	// create a MultibitTree
+#define TASK_SEARCH		2	// search in a cell of a Grid1D
+#define TASK_SEARCH_RANGE	4	// search in all suitable MultibitTrees of a Grid1D
+#define TASK_RADIX_COUNT	8	// count digits of a block of result records
+#define TASK_RADIX_SCATTER	16	// scatter a block of result records
+#define TASK_PLAN		32	// choose the search engine of a cell of a Grid1D
+#define TASK_SEARCH_BLOCK	64	// search in a cell of a Grid1D for a block of queries
+#define TASK_SEARCH_COMPOSITE	128	// search in a CompositeGrid
+
+// Instances of createArgumentsType hold the parameters
+// for performing the creation of a MultibitTree.
+typedef struct createArgumentsStruct {
+        MultibitTree **tree;		// address where to store the new MultibitTree pointer
+        Fingerprint **prints;		// pointer to array of Fingerprints
+        int leafStart;			// cluster starting position in prints
+        int leafEnd;			// end of cluster
+        int nBits;			// maximal size of Fingerprint in bits
+        int cardinality;		// cluster cardinality
+        int leafLimit;			// leaf limit for MultibitTree creation
+        int copyPrints;			// flag if the cluster's prints are copied to local memory
+} createArgumentsType;
+
+// Instances of searchArgumentsType hold the parameters
+// for searching in a cell of a Grid1D.
+typedef struct searchArgumentsStruct {
+        Grid1D *grid;			// pointer to the Grid1D to search
+        int cell;			// cell to search
+        QueryResult *result;		// QueryResult for storing the results
+        Fingerprint *query;		// query Fingerprint to search for
+        int cardinality;		// cardinality of query
+        float minTanimoto;		// filter criteria
+} searchArgumentsType;
+
+// Instances of searchRangeArgumentsType hold the parameters
+// for searching in all suitable MultibitTrees of a Grid1D.
+typedef struct searchRangeArgumentsStruct {
+        Grid1D *grid;			// pointer to the Grid1D to search
+        QueryResult *result;		// QueryResult for storing the results
+        Fingerprint *query;		// query Fingerprint to search for
+        float minTanimoto;		// filter criteria
+        int node;			// NUMA node whose MultibitTrees are searched, -1 for all
+        QueryPool *queries;		// QueryPool that holds query, NULL if not pooled
+} searchRangeArgumentsType;
+
+// Instances of searchBlockArgumentsType hold the parameters
+// for searching in a cell of a Grid1D for a range of queries of a block.
+typedef struct searchBlockArgumentsStruct {
+        Grid1D *grid;			// pointer to the Grid1D to search
+        int cell;			// cell to search
+        queryBlockType *block;		// block of queries sorted by cardinality
+        int first;			// first query of the block to search for
+        int last;			// end of the range of queries
+        QueryResult *result;		// QueryResult for storing the results
+        float minTanimoto;		// filter criteria
+} searchBlockArgumentsType;
+
+// Instances of searchCompositeArgumentsType hold the parameters
+// for searching in a CompositeGrid.
+typedef struct searchCompositeArgumentsStruct {
+        CompositeGrid *grid;		// pointer to the CompositeGrid to search
+        QueryResult *result;		// QueryResult for storing the results
+        Fingerprint **query;		// query with one Fingerprint per field
+        float minScore;			// filter criteria
+} searchCompositeArgumentsType;
+
+// Instances of planArgumentsType hold the parameters
+// for choosing the search engine of a cell of a Grid1D.
+typedef struct planArgumentsStruct {
+        Grid1D *grid;			// pointer to the Grid1D
+        int cell;			// cell to plan
+} planArgumentsType;
+
+// Instances of radixArgumentsType hold the parameters
+// for one block of a radix sort pass.
+typedef struct radixArgumentsStruct {
+        radixSortType *sort;		// state of the radix sort
+        int block;			// block to count or scatter
+} radixArgumentsType;
+
+// Instances of taskType hold one task of any type
+// together with its parameters.
+typedef struct taskStruct {
+	int type;				// task type
+	union {
+		createArgumentsType create;		// parameters for TASK_CREATE
+		searchArgumentsType search;		// parameters for TASK_SEARCH
+		searchRangeArgumentsType searchRange;	// parameters for TASK_SEARCH_RANGE
+		radixArgumentsType radix;		// parameters for TASK_RADIX_COUNT and TASK_RADIX_SCATTER
+		planArgumentsType plan;			// parameters for TASK_PLAN
+		searchBlockArgumentsType searchBlock;	// parameters for TASK_SEARCH_BLOCK
+		searchCompositeArgumentsType searchComposite;	// parameters for TASK_SEARCH_COMPOSITE
+	} args;
+} taskType;
+
+// Instances of taskCellType hold one entry of a TaskQueue.
+// The sequence number tells producers and consumers whether
+// the cell is free or filled in the current round.
+typedef struct taskCellStruct {
+	unsigned long sequence;		// sequence number of cell
+	taskType task;			// stored task
+} taskCellType;
+
+// Objects of class TaskQueue are bounded lock-free queues for tasks
+// that can be used by any number of producer and consumer threads.
+// Each cell carries a sequence number, so a producer or consumer only
+// needs a single compare-and-swap on the queue position to claim a cell.
+//
+// The algorithm is the bounded MPMC queue by Dmitry Vyukov, see
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+class TaskQueue {
+	private:
+
+	taskCellType *mCells;		// ring buffer of cells
+	unsigned long mMask;		// capacity - 1, capacity is a power of two
+	char mPad0[CACHE_LINE];
+	unsigned long mEnqueuePos;	// next position to write
+	char mPad1[CACHE_LINE];
+	unsigned long mDequeuePos;	// next position to read
+	char mPad2[CACHE_LINE];
+
+	public:
+
+	// constructor
+	// create a queue for at least <capacity> tasks
+	TaskQueue(int capacity);
+
+	// destructor
+	~TaskQueue();
+
+	// append <task> to the queue, return 0 if the queue is full
+	inline int push(taskType *task) {
+		taskCellType *cell;
+		unsigned long pos;
+		long diff;
+
+		pos = __atomic_load_n(&mEnqueuePos, __ATOMIC_RELAXED);
+
+		while (1) {
+			cell = &mCells[pos & mMask];
+			diff = (long) __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (long) pos;
+
+			if (diff == 0) {
+				// cell is free, try to claim it
+				if (__atomic_compare_exchange_n(&mEnqueuePos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+					break;
+				}
+			} else if (diff < 0) {
+				// cell of the previous round is not yet consumed
+				return 0;
+			} else {
+				// another producer was faster
+				pos = __atomic_load_n(&mEnqueuePos, __ATOMIC_RELAXED);
+			}
+		}
+
+		cell->task = *task;
+		__atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+		return 1;
+	}
+
+	// remove the first task from the queue into <task>, return 0 if the queue is empty
+	inline int pop(taskType *task) {
+		taskCellType *cell;
+		unsigned long pos;
+		long diff;
+
+		pos = __atomic_load_n(&mDequeuePos, __ATOMIC_RELAXED);
+
+		while (1) {
+			cell = &mCells[pos & mMask];
+			diff = (long) __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - (long) (pos + 1);
+
+			if (diff == 0) {
+				// cell is filled, try to claim it
+				if (__atomic_compare_exchange_n(&mDequeuePos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+					break;
+				}
+			} else if (diff < 0) {
+				// cell is not yet filled
+				return 0;
+			} else {
+				// another consumer was faster
+				pos = __atomic_load_n(&mDequeuePos, __ATOMIC_RELAXED);
+			}
+		}
+
+		*task = cell->task;
+		__atomic_store_n(&cell->sequence, pos + mMask + 1, __ATOMIC_RELEASE);
+
+		return 1;
+	}
+
+	// check if the queue is empty, the result may be outdated immediately
+	inline int isEmpty() {
+		unsigned long pos = __atomic_load_n(&mDequeuePos, __ATOMIC_ACQUIRE);
+
+		return __atomic_load_n(&mCells[pos & mMask].sequence, __ATOMIC_ACQUIRE) != pos + 1;
+	}
+};
+#endif
@@ -24,7 +24,11 @@
 // along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
 
 #include <assert.h>
+#include <sched.h>
 #include "ThreadPool.h"
+#include "Grid1D.h"
+#include "CompositeGrid.h"
+#include "QueryPool.h"
 
 // thread wrapper that is compatible to pthread-API and calls the
 // worker member function of ThreadPool after thread creation
@@ -39,233 +43,461 @@ void *threadWrapper(void *p) {
 
 // thread main loop for retrieving and performing tasks
 void ThreadPool::worker(int slot) {
-	int running = true;
-	int *task = &(mThreadData[slot].task);
-	pthread_mutex_t *mutex = &(mThreadData[slot].mutex);
-	pthread_cond_t *condition = &(mThreadData[slot].condition);
+	threadDataType *threadData = &(mThreadData[slot]);
+	taskType task;
+	int idle = 0;
+
+	// bind thread to its cpu
+	if (threadData->cpu >= 0) {
+		NumaTopology::bindThread(threadData->cpu);
+	}
+
+	// results of this thread go to its own buffer
+	QueryResult::setThreadSlot(slot);
 	
-	while (running) {
-		// wait for task
+	while (1) {
+		if (!getTask(slot, &task)) {
+			if (!__atomic_load_n(&mRunning, __ATOMIC_SEQ_CST)) {
+				// stop thread
+				break;
+			}
+
+			idle++;
+
+			if (idle < SPIN_COUNT) {
+				sched_yield();
+				continue;
+			}
 
-		pthread_mutex_lock(mutex);
+			// wait for task
+			// the sleeping flag is set before checking the queues again,
+			// so a dispatching thread either sees the flag or the thread
+			// sees the new task
+			pthread_mutex_lock(&(threadData->mutex));
+			__atomic_store_n(&(threadData->sleeping), 1, __ATOMIC_SEQ_CST);
 
-		while (*task == 0) {
-			pthread_cond_wait(condition, mutex);
+			if (hasTask(slot) || !__atomic_load_n(&mRunning, __ATOMIC_SEQ_CST)) {
+				threadData->sleeping = 0;
+			}
+
+			while (threadData->sleeping) {
+				pthread_cond_wait(&(threadData->condition), &(threadData->mutex));
+			}
+
+			pthread_mutex_unlock(&(threadData->mutex));
+			idle = 0;
+			continue;
 		}
-		
-		pthread_mutex_unlock(mutex);
+
+		idle = 0;
 		
 		// perform task
 
-		if (*task == 1) {
+		if (task.type == TASK_CREATE) {
 			// create a new MultibitTree
-			createArgumentsType *args = &(mCreateArgs[slot]);
+			createArgumentsType *args = &(task.args.create);
+
+			// replace prints by copies allocated from this thread's node
+			if (args->copyPrints) {
+				for (int i = args->leafStart; i < args->leafEnd; i++) {
+					Fingerprint *copy = new Fingerprint(args->prints[i]);
+					delete args->prints[i];
+					args->prints[i] = copy;
+				}
+			}
+
 			*(args->tree) = new MultibitTree(args->prints, args->leafStart, args->leafEnd, args->nBits, args->cardinality, args->leafLimit);
-		} else if (*task == 2) {
-			// search in a MultibitTree
-			searchArgumentsType *args = &(mSearchArgs[slot]);
-			args->tree->search(args->result, args->query, args->cardinality, args->minTanimoto);
-		} else if (*task == 4) {
-			// search in an array of MultibitTrees
-			searchRangeArgumentsType *args = &(mSearchRangeArgs[slot]);
-			for (int i = args->min; i < args->max; i++) {
-				if (args->trees[i]) {
-					args->trees[i]->search(args->result, args->query, args->cardinality, args->minTanimoto);
+		} else if (task.type == TASK_SEARCH) {
+			// search in a cell of a Grid1D
+			searchArgumentsType *args = &(task.args.search);
+			float threshold = args->minTanimoto;
+
+			args->grid->searchCell(args->cell, args->result, args->query, args->cardinality, &threshold);
+			args->result->flush(args->query);
+		} else if (task.type == TASK_SEARCH_RANGE) {
+			// search in all suitable MultibitTrees of a Grid1D
+			searchRangeArgumentsType *args = &(task.args.searchRange);
+			long long hits = args->grid->searchRange(args->result, args->query, args->minTanimoto, args->node);
+			args->result->flush(args->query);
+
+			// the query may be re-used after its last task
+			if (args->queries != NULL) {
+				args->queries->release(args->query, args->result, hits);
+			}
+		} else if (task.type == TASK_SEARCH_BLOCK) {
+			// search in a cell of a Grid1D for a range of queries
+			searchBlockArgumentsType *args = &(task.args.searchBlock);
+			args->grid->searchCellBlock(args->cell, args->block, args->first, args->last, args->result, args->minTanimoto);
+		} else if (task.type == TASK_SEARCH_COMPOSITE) {
+			// search in a CompositeGrid
+			searchCompositeArgumentsType *args = &(task.args.searchComposite);
+			Fingerprint *query = args->query[0];
+			long long hits = args->grid->search(args->result, args->query, args->minScore);
+			args->result->flush(query);
+
+			if (hits > 0) {
+				args->result->addQueryId(query->getIndex(), query->getId());
+			}
+		} else if (task.type == TASK_RADIX_COUNT) {
+			// count digits of a block of result records
+			radixCount(task.args.radix.sort, task.args.radix.block);
+		} else if (task.type == TASK_RADIX_SCATTER) {
+			// scatter a block of result records
+			radixScatter(task.args.radix.sort, task.args.radix.block);
+		} else if (task.type == TASK_PLAN) {
+			// choose the search engine of a cell of a Grid1D
+			task.args.plan.grid->planCell(task.args.plan.cell);
+		}
+
+		completeTask();
+	}
+}
+
+// take the next task for thread <slot>
+// try the local queue first, then the shared queue and
+// finally the local queues of the other threads of the same node
+int ThreadPool::getTask(int slot, taskType *task) {
+	int node = mThreadData[slot].node;
+
+	if (mThreadData[slot].queue->pop(task) || mQueue->pop(task)) {
+		return 1;
+	}
+
+	for (int i = 0; i < mNodeThreadCount[node]; i++) {
+		if (mThreadData[mNodeThreads[node][i]].queue->pop(task)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// check if there is a task for thread <slot>
+int ThreadPool::hasTask(int slot) {
+	int node = mThreadData[slot].node;
+
+	if (!mQueue->isEmpty()) {
+		return 1;
+	}
+
+	for (int i = 0; i < mNodeThreadCount[node]; i++) {
+		if (!mThreadData[mNodeThreads[node][i]].queue->isEmpty()) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// wake thread <slot> if it is sleeping
+void ThreadPool::wake(int slot) {
+	threadDataType *threadData = &(mThreadData[slot]);
+
+	pthread_mutex_lock(&(threadData->mutex));
+
+	if (threadData->sleeping) {
+		threadData->sleeping = 0;
+		pthread_cond_signal(&(threadData->condition));
+	}
+
+	pthread_mutex_unlock(&(threadData->mutex));
+}
+
+// queue task for a thread of <node>, for any thread if <node> < 0
+// if the queues are full, wait until a thread has taken a task
+void ThreadPool::dispatch(taskType *task, int node) {
+	int target = -1;
+	unsigned int next;
+
+	__atomic_add_fetch(&mPending, 1, __ATOMIC_SEQ_CST);
+
+	if ((node < 0) || (mNodes == 1)) {
+		// put task into shared queue
+		while (!mQueue->push(task)) {
+			sched_yield();
+		}
+
+		node = -1;
+	} else {
+		// put task into local queue of the next thread of the node
+		// that has space left
+		next = __atomic_fetch_add(&mNodeNext[node], 1, __ATOMIC_RELAXED);
+
+		while (target < 0) {
+			for (int i = 0; i < mNodeThreadCount[node]; i++) {
+				int slot = mNodeThreads[node][(next + i) % mNodeThreadCount[node]];
+
+				if (mThreadData[slot].queue->push(task)) {
+					target = slot;
+					break;
 				}
 			}
-		} else if (*task == 3) {
-			// stop thread
-			running = false;
+
+			if (target < 0) {
+				sched_yield();
+			}
 		}
+	}
+
+	// make the task visible before checking the sleeping flags
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
 
-		// signal the thread to be ready for a new task
-		releaseSlot(slot);
+	if ((target >= 0) && __atomic_load_n(&(mThreadData[target].sleeping), __ATOMIC_SEQ_CST)) {
+		wake(target);
+		return;
+	}
+
+	// wake any sleeping thread that can take the task
+	for (int i = 0; i < mPoolSize; i++) {
+		if (((node < 0) || (mThreadData[i].node == node)) && __atomic_load_n(&(mThreadData[i].sleeping), __ATOMIC_SEQ_CST)) {
+			wake(i);
+			return;
+		}
+	}
+}
+
+// count a completed task and signal wait() if no task is left
+void ThreadPool::completeTask() {
+	if (__atomic_sub_fetch(&mPending, 1, __ATOMIC_SEQ_CST) == 0) {
+		pthread_mutex_lock(&mWaitMutex);
+		pthread_cond_broadcast(&mWaitCondition);
+		pthread_mutex_unlock(&mWaitMutex);
 	}
 }
 
 // constructor
 // create a new ThreadPool with size threads
-ThreadPool::ThreadPool(int size) {
-	pthread_attr_t pthreadAttr;
+// if <numa> is set, distribute threads over NUMA nodes and bind them to cpus
+ThreadPool::ThreadPool(int size, int numa) {
+	NumaTopology *topology = NULL;
 
 	// allocate data space
 	mPool = new pthread_t[size];
 	mThreadData = new threadDataType[size];
-	mSlotStack = new int[size];
-	mCreateArgs = new createArgumentsType[size];
-	mSearchArgs = new searchArgumentsType[size];
-	mSearchRangeArgs = new searchRangeArgumentsType[size];
+	mQueue = new TaskQueue(GLOBAL_QUEUE_SIZE);
 
 	mPoolSize = size;
+	mNuma = numa;
+	mNodes = 1;
+	mPending = 0;
+	mRunning = 1;
+
+	if (numa) {
+		topology = new NumaTopology();
+		mNodes = MIN(topology->getNodes(), size);
+	}
+
+	mNodeThreads = new int*[mNodes];
+	mNodeThreadCount = new int[mNodes];
+	mNodeNext = new unsigned int[mNodes];
+
+	for (int n = 0; n < mNodes; n++) {
+		mNodeThreads[n] = new int[(size - n - 1) / mNodes + 1];
+		mNodeThreadCount[n] = 0;
+		mNodeNext[n] = 0;
+	}
+
+	pthread_mutex_init(&mWaitMutex, NULL);
+	pthread_cond_init(&mWaitCondition, NULL);
 
-	pthread_attr_init(&pthreadAttr);
-	pthread_attr_setdetachstate(&pthreadAttr, PTHREAD_CREATE_DETACHED);
-	
 	for (int i = 0; i < size; i++) {
+		int node = i % mNodes;
+
 		// initialize thread data structure
 		mThreadData[i].slot = i;
 		mThreadData[i].pool = this;
-		mThreadData[i].task = 0;
+		mThreadData[i].node = node;
+		mThreadData[i].cpu = -1;
+		mThreadData[i].queue = new TaskQueue(LOCAL_QUEUE_SIZE);
+		mThreadData[i].sleeping = 0;
+
+		if (numa) {
+			// use the cpus of each node in turn
+			mThreadData[i].cpu = topology->getCpu(node, (i / mNodes) % topology->getCpuCount(node));
+		}
+
+		mNodeThreads[node][mNodeThreadCount[node]] = i;
+		mNodeThreadCount[node]++;
+
 		pthread_mutex_init(&(mThreadData[i].mutex), NULL);
 		pthread_cond_init(&(mThreadData[i].condition), NULL);
+	}
 
+	for (int i = 0; i < size; i++) {
 		// start thread
-		int rc = pthread_create(&mPool[i], &pthreadAttr, threadWrapper, (void*) (&(mThreadData[i])));
+		int rc = pthread_create(&mPool[i], NULL, threadWrapper, (void*) (&(mThreadData[i])));
 
 		rc = rc; // suppress warning in non-debug-mode
 		assert(rc == 0);
-		
-		// put all threads on thread stack
-		mSlotStack[i] = i;
 	}
 
-	mSlotStackPosition = 0;
-	
-	pthread_mutex_init(&mSlotStackMutex, NULL);
-	pthread_cond_init(&mSlotStackCondition, NULL);
+	if (topology != NULL) {
+		delete topology;
+	}
 }
 
 // destructor
 // stop all threads and discard allocated resources
 ThreadPool::~ThreadPool() {
-	// wait for locked threads
+	// wait for running tasks
 	wait();
 
-	// lock all threads
+	// stop all threads
+	__atomic_store_n(&mRunning, 0, __ATOMIC_SEQ_CST);
+
 	for (int i = 0; i < mPoolSize; i++) {
-		getSlot();
+		wake(i);
 	}
 
-	// send task "stop" = 3 to each thread
 	for (int i = 0; i < mPoolSize; i++) {
-		startSlot(3, i);
+		pthread_join(mPool[i], NULL);
 	}
-	
-	// wait for all threads to complete
-	wait();
 
 	// release resources
+	for (int i = 0; i < mPoolSize; i++) {
+		delete mThreadData[i].queue;
+		pthread_mutex_destroy(&(mThreadData[i].mutex));
+		pthread_cond_destroy(&(mThreadData[i].condition));
+	}
+
+	for (int n = 0; n < mNodes; n++) {
+		delete[] mNodeThreads[n];
+	}
+
+	pthread_mutex_destroy(&mWaitMutex);
+	pthread_cond_destroy(&mWaitCondition);
+
 	delete[] mPool;
-	delete[] mSlotStack;
-	delete[] mCreateArgs;
-	delete[] mSearchArgs;
+	delete[] mThreadData;
+	delete mQueue;
+	delete[] mNodeThreads;
+	delete[] mNodeThreadCount;
+	delete[] mNodeNext;
 }
 
-// lock next free thread by getting its corresponding
-// slot from the slot stack
-int ThreadPool::getSlot() {
-	int slot;
+// dispatch a task to create a new MultibitTree
+void ThreadPool::createMultibitTree(MultibitTree **tree, Fingerprint **prints, int leafStart, int leafEnd, int nBits, int cardinality, int leafLimit, int node) {
+	taskType task;
+
+	// set attributes
+	task.type = TASK_CREATE;
+	task.args.create.tree = tree;
+	task.args.create.prints = prints;
+	task.args.create.leafStart = leafStart;
+	task.args.create.leafEnd = leafEnd;
+	task.args.create.nBits = nBits;
+	task.args.create.cardinality = cardinality;
+	task.args.create.leafLimit = leafLimit;
+	task.args.create.copyPrints = mNuma && (mNodes > 1);
+
+	dispatch(&task, node);
+}
 
-	// wait for a free slot
-	pthread_mutex_lock(&mSlotStackMutex);
+// dispatch a task to search in a cell of a Grid1D
+void ThreadPool::searchCell(Grid1D *grid, int cell, QueryResult *result, Fingerprint *query, int cardinality, float minTanimoto, int node) {
+	taskType task;
 
-	while (mSlotStackPosition >= mPoolSize) {
-		pthread_cond_wait(&mSlotStackCondition, &mSlotStackMutex);
-	}
+	// set attributes	
+	task.type = TASK_SEARCH;
+	task.args.search.grid = grid;
+	task.args.search.cell = cell;
+	task.args.search.result = result;
+	task.args.search.query = query;
+	task.args.search.cardinality = cardinality;
+	task.args.search.minTanimoto = minTanimoto;
+
+	dispatch(&task, node);
+}
 
-	// get next free slot from the stack
-	slot = mSlotStack[mSlotStackPosition];
-	mSlotStackPosition++;
-	
-	pthread_mutex_unlock(&mSlotStackMutex);
+// dispatch a task to search in <cell> of a Grid1D on <node> for the queries
+// <first> to <last>-1 of <block>
+void ThreadPool::searchBlock(Grid1D *grid, int cell, queryBlockType *block, int first, int last, QueryResult *result, float minTanimoto, int node) {
+	taskType task;
 
-	return slot;
+	// set attributes
+	task.type = TASK_SEARCH_BLOCK;
+	task.args.searchBlock.grid = grid;
+	task.args.searchBlock.cell = cell;
+	task.args.searchBlock.block = block;
+	task.args.searchBlock.first = first;
+	task.args.searchBlock.last = last;
+	task.args.searchBlock.result = result;
+	task.args.searchBlock.minTanimoto = minTanimoto;
+
+	dispatch(&task, node);
 }
 
-// unlock thread after completing a task by putting
-// its corresponding slot back on the slot stack
-void ThreadPool::releaseSlot(int slot) {
-	pthread_mutex_lock(&mSlotStackMutex);
+// dispatch a task to search in a CompositeGrid for <query>
+void ThreadPool::searchComposite(CompositeGrid *grid, QueryResult *result, Fingerprint **query, float minScore) {
+	taskType task;
 
-	mSlotStackPosition--;
-	assert(mSlotStackPosition >= 0);
-	mSlotStack[mSlotStackPosition] = slot;
-	mThreadData[slot].task = 0;	// set task to "wait" = 0
+	// set attributes
+	task.type = TASK_SEARCH_COMPOSITE;
+	task.args.searchComposite.grid = grid;
+	task.args.searchComposite.result = result;
+	task.args.searchComposite.query = query;
+	task.args.searchComposite.minScore = minScore;
 
-	// signal main thread that "mSlotStackPosition" has changed
-	pthread_cond_signal(&mSlotStackCondition);
-	
-	pthread_mutex_unlock(&mSlotStackMutex);
+	dispatch(&task, -1);
 }
 
-// start locked thread to perform task
-void ThreadPool::startSlot(int task, int slot) {
-	pthread_mutex_lock(&(mThreadData[slot].mutex));
-	
-	// set task
-	mThreadData[slot].task = task;
-	
-	// signal thread that "task" has changed
-	pthread_cond_signal(&(mThreadData[slot].condition));
-	pthread_mutex_unlock(&(mThreadData[slot].mutex));
-}
+// dispatch a task to choose the search engine of a cell of a Grid1D
+void ThreadPool::planCell(Grid1D *grid, int cell, int node) {
+	taskType task;
 
-// dispatch a task to create a new MultibitTree
-void ThreadPool::createMultibitTree(MultibitTree **tree, Fingerprint **prints, int leafStart, int leafEnd, int nBits, int cardinality, int leafLimit) {
-	int slot;
+	// set attributes
+	task.type = TASK_PLAN;
+	task.args.plan.grid = grid;
+	task.args.plan.cell = cell;
 
-	// lock thread
-	slot = getSlot();
+	dispatch(&task, node);
+}
 
-	// set attributes
-	mCreateArgs[slot].tree = tree;
-	mCreateArgs[slot].prints = prints;
-	mCreateArgs[slot].leafStart = leafStart;
-	mCreateArgs[slot].leafEnd = leafEnd;
-	mCreateArgs[slot].nBits = nBits;
-	mCreateArgs[slot].cardinality = cardinality;
-	mCreateArgs[slot].leafLimit = leafLimit;
-
-	// start thread with task "create" = 1
-	startSlot(1, slot);
+// dispatch a task to search in all suitable MultibitTrees of a Grid1D
+void ThreadPool::searchGrid(Grid1D *grid, QueryResult *result, Fingerprint *query, float minTanimoto, int node, QueryPool *queries) {
+	taskType task;
+
+	// set attributes	
+	task.type = TASK_SEARCH_RANGE;
+	task.args.searchRange.grid = grid;
+	task.args.searchRange.result = result;
+	task.args.searchRange.query = query;
+	task.args.searchRange.minTanimoto = minTanimoto;
+	task.args.searchRange.node = node;
+	task.args.searchRange.queries = queries;
+
+	dispatch(&task, node);
 }
 
-// dispatch a task to search in a MultibitTree
-void ThreadPool::searchMultibitTree(MultibitTree *tree, QueryResult *result, Fingerprint *query, int cardinality, float minTanimoto) {
-	int slot;
+// dispatch a task to count the digits of a block for a radix sort pass
+void ThreadPool::countRadix(radixSortType *sort, int block) {
+	taskType task;
 
-	// lock thread
-	slot = getSlot();
+	task.type = TASK_RADIX_COUNT;
+	task.args.radix.sort = sort;
+	task.args.radix.block = block;
 
-	// set attributes	
-	mSearchArgs[slot].tree = tree;
-	mSearchArgs[slot].result = result;
-	mSearchArgs[slot].query = query;
-	mSearchArgs[slot].cardinality = cardinality;
-	mSearchArgs[slot].minTanimoto = minTanimoto;
-
-	// start thread with task "search" = 2
-	startSlot(2, slot);
+	dispatch(&task, -1);
 }
 
-// dispatch a task to search in an array of MultibitTrees
-void ThreadPool::searchMultibitTreeRange(MultibitTree **trees, int min, int max, QueryResult *result, Fingerprint *query, int cardinality, float minTanimoto) {
-	int slot;
+// dispatch a task to scatter a block for a radix sort pass
+void ThreadPool::scatterRadix(radixSortType *sort, int block) {
+	taskType task;
 
-	// lock thread
-	slot = getSlot();
+	task.type = TASK_RADIX_SCATTER;
+	task.args.radix.sort = sort;
+	task.args.radix.block = block;
 
-	// set attributes	
-	mSearchRangeArgs[slot].trees = trees;
-	mSearchRangeArgs[slot].min = min;
-	mSearchRangeArgs[slot].max = max;
-	mSearchRangeArgs[slot].result = result;
-	mSearchRangeArgs[slot].query = query;
-	mSearchRangeArgs[slot].cardinality = cardinality;
-	mSearchRangeArgs[slot].minTanimoto = minTanimoto;
-
-	// start thread with task "searchRange" = 4
-	startSlot(4, slot);
+	dispatch(&task, -1);
 }
 
 // wait until all threads have completed
 void ThreadPool::wait() {
-	pthread_mutex_lock(&mSlotStackMutex);
+	pthread_mutex_lock(&mWaitMutex);
 
-	while (mSlotStackPosition > 0) {
-		pthread_cond_wait(&mSlotStackCondition, &mSlotStackMutex);
+	while (__atomic_load_n(&mPending, __ATOMIC_SEQ_CST) > 0) {
+		pthread_cond_wait(&mWaitCondition, &mWaitMutex);
 	}
 
-	pthread_mutex_unlock(&mSlotStackMutex);
+	pthread_mutex_unlock(&mWaitMutex);
 }
-
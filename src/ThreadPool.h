@@ -30,98 +30,119 @@
 #include "QueryResult.h"
 #include "Fingerprint.h"
 #include "MultibitTree.h"
+#include "TaskQueue.h"
+#include "Numa.h"
 
 // forward declaration
 class ThreadPool;
 
-// Instances of threadDataType store task information
-// for a running thread. The main thread dispatches tasks
-// by filling in the task information into the task's slot
-// and signaling the condition to start.
+#define GLOBAL_QUEUE_SIZE 4096		// capacity of the shared task queue
+#define LOCAL_QUEUE_SIZE 256		// capacity of each thread's task queue
+#define SPIN_COUNT 1000			// failed polls before a thread goes to sleep
+
+// Instances of threadDataType store the state of a running thread.
+// Tasks that must run on the thread's NUMA node are put into its local
+// queue. A thread that finds no task sets its sleeping flag and waits
+// for the condition to be signalled.
 typedef struct threadDataStruct {
 	int slot;			// the thread's slot
+	int node;			// the thread's NUMA node
+	int cpu;			// the cpu the thread is bound to, -1 if not bound
         ThreadPool *pool;		// pointer on responsible ThreadPool
-	int task;			// task
+	TaskQueue *queue;		// local task queue
+	int sleeping;			// flag if the thread waits for the condition
 	pthread_mutex_t mutex;		// mutex for signal handling
 	pthread_cond_t condition;	// condition for signal handling
 } threadDataType;
 
-// Instances of createArgumentsType hold the parameters
-// for performing the creation of a MultibitTree.
-typedef struct createArgumentsStruct {
-        MultibitTree **tree;		// address where to store the new MultibitTree pointer
-        Fingerprint **prints;		// pointer to array of Fingerprints
-        int leafStart;			// cluster starting position in prints
-        int leafEnd;			// end of cluster
-        int nBits;			// maximal size of Fingerprint in bits
-        int cardinality;		// cluster cardinality
-        int leafLimit;			// leaf limit for MultibitTree creation
-} createArgumentsType;
-
-// Instances of searchArgumentsType hold the parameters
-// for searching in a MultibitTree.
-typedef struct searchArgumentsStruct {
-        MultibitTree *tree;		// pointer to the MultibitTree to search
-        QueryResult *result;		// QueryResult for storing the results
-        Fingerprint *query;		// query Fingerprint to search for
-        int cardinality;		// cardinality of query
-        float minTanimoto;		// filter criteria
-} searchArgumentsType;
-
-// Instances of searchRangeArgumentsType hold the parameters
-// for searching in an array of MultibitTrees.
-typedef struct searchRangeArgumentsStruct {
-        MultibitTree **trees;		// pointer to the MultibitTree array to search
-        int min;			// start of the range in the array
-        int max;			// end of the range in the array
-        QueryResult *result;		// QueryResult for storing the results
-        Fingerprint *query;		// query Fingerprint to search for
-        int cardinality;		// cardinality of query
-        float minTanimoto;		// filter criteria
-} searchRangeArgumentsType;
-
 // Instances of ThreadPool hold a set threads that can concurrently
-// perform task. ThreadPool dispatches a new task to the next free
-// thread and returns. If all threads are working, ThreadPool waits
-// until the task can be dispatched.
+// perform task. Tasks are put into a bounded lock-free queue that
+// is shared by all threads and the dispatching function returns
+// immediately. Only if the queue is full, the dispatching thread
+// waits until a task has been taken from it.
+//
+// A NUMA-aware ThreadPool distributes its threads evenly over the NUMA
+// nodes and binds each thread to one cpu of its node. Tasks can then be
+// dispatched to a thread of a given node, so data that is allocated
+// by a task stays local to the node that later searches it. Such tasks
+// are put into the local queue of a thread of the node. Idle threads
+// take tasks from the local queues of other threads of the same node.
 class ThreadPool {
 	private:
 
-	pthread_t *mPool;				// array of threads
-	threadDataType *mThreadData;			// array of task information per thread
-	createArgumentsType *mCreateArgs;		// array of arguments for task "create"
-	searchArgumentsType *mSearchArgs;		// array of arguments for task "search"
-	searchRangeArgumentsType *mSearchRangeArgs;	// array of arguments for task "searchRange"
-	
-	pthread_mutex_t mSlotStackMutex;	// mutex for signal handling
-	pthread_cond_t mSlotStackCondition;	// condition for signal handling
+	pthread_t *mPool;			// array of threads
+	threadDataType *mThreadData;		// array of state information per thread
+	TaskQueue *mQueue;			// task queue shared by all threads
 
 	int mPoolSize;				// number of managed threads
-	int *mSlotStack;			// stack of free threads
-	int mSlotStackPosition;			// stack position
-
-	int getSlot();				// lock next free thread
-	void startSlot(int task, int slot);	// start locked thread to perform task
-	void releaseSlot(int slot);		// unlock thread after completing a task
+	int mNodes;				// number of NUMA nodes with threads
+	int mNuma;				// flag if threads are bound to NUMA nodes
+	int **mNodeThreads;			// slots of the threads of each node
+	int *mNodeThreadCount;			// number of threads of each node
+	unsigned int *mNodeNext;		// round-robin counter for each node
+
+	long long mPending;			// number of dispatched, uncompleted tasks
+	int mRunning;				// flag cleared to stop all threads
+	pthread_mutex_t mWaitMutex;		// mutex for signal handling
+	pthread_cond_t mWaitCondition;		// condition for signal handling
+
+	int getTask(int slot, taskType *task);	// take the next task for thread <slot>
+	int hasTask(int slot);			// check if there is a task for thread <slot>
+	void dispatch(taskType *task, int node);	// queue task for <node>, any if <node> < 0
+	void wake(int slot);			// wake thread <slot> if it is sleeping
+	void completeTask();			// count a completed task and signal wait()
 
 	public:
 
 	// constructor
-	ThreadPool(int size);			// create a new ThreadPool with size threads
+	ThreadPool(int size, int numa);		// create a new ThreadPool with size threads
 
 	// destructor
 	~ThreadPool();				// stop all threads and discard allocated resources
 	
 	void worker(int slot);			// thread main loop for retrieving and performing tasks
 
-	// dispatch a task to create a new MultibitTree
-	void createMultibitTree(MultibitTree **tree, Fingerprint **prints, int leafStart, int leafEnd, int nBits, int cardinality, int leafLimit);
+	// dispatch a task to create a new MultibitTree on <node>
+	void createMultibitTree(MultibitTree **tree, Fingerprint **prints, int leafStart, int leafEnd, int nBits, int cardinality, int leafLimit, int node);
 	
-	// dispatch a task to search in a MultibitTree
-	void searchMultibitTree(MultibitTree *tree, QueryResult *result, Fingerprint *query, int cardinality, float minTanimoto);
+	// dispatch a task to search in <cell> of a Grid1D on <node>
+	void searchCell(Grid1D *grid, int cell, QueryResult *result, Fingerprint *query, int cardinality, float minTanimoto, int node);
+
+	// dispatch a task to search in <cell> of a Grid1D on <node> for the queries
+	// <first> to <last>-1 of <block>, the task releases each query when it is done
+	void searchBlock(Grid1D *grid, int cell, queryBlockType *block, int first, int last, QueryResult *result, float minTanimoto, int node);
+
+	// dispatch a task to search in a CompositeGrid for <query>
+	// the task registers the id of the query if it has results
+	void searchComposite(CompositeGrid *grid, QueryResult *result, Fingerprint **query, float minScore);
+
+	// dispatch a task to choose the search engine of <cell> of a Grid1D on <node>
+	void planCell(Grid1D *grid, int cell, int node);
+
+	// dispatch a task to search in all suitable MultibitTrees of a Grid1D on <node>
+	// if <queries> is given, the task releases <query> when it is done
+	void searchGrid(Grid1D *grid, QueryResult *result, Fingerprint *query, float minTanimoto, int node, QueryPool *queries);
+
+	// dispatch a task to count the digits of a block for a radix sort pass
+	void countRadix(radixSortType *sort, int block);
+
+	// dispatch a task to scatter a block for a radix sort pass
+	void scatterRadix(radixSortType *sort, int block);
+
+	// get number of threads
+	inline int getSize() {
+		return mPoolSize;
+	}
+
+	// get number of NUMA nodes with threads, 1 if the pool is not NUMA-aware
+	inline int getNodes() {
+		return mNodes;
+	}
 
-	// dispatch a task to search in an array of MultibitTrees
-	void searchMultibitTreeRange(MultibitTree **trees, int min, int max, QueryResult *result, Fingerprint *query, int cardinality, float minTanimoto);
+	// check if threads are bound to NUMA nodes
+	inline int isNuma() {
+		return mNuma;
+	}
 
 	// wait until all threads have completed
 	void wait();
@@ -0,0 +1,289 @@
+// Tuner.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#include <time.h>
+#include "Tuner.h"
+#include "Grid1D.h"
+
+// return the time of a monotonic clock in seconds
+static double tuneTime() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// constructor
+// tune for searches with <minTanimoto> in grids with <dims> bit ranges and <engine>
+// nothing is allocated before tune() is called
+Tuner::Tuner(int dims, int engine, float minTanimoto) {
+	mDims = dims;
+	mEngine = engine;
+	mMinTanimoto = minTanimoto;
+	mSample = NULL;
+	mSampleSize = 0;
+	mNBits = 0;
+	mQueries = NULL;
+	mQueryCount = 0;
+	mMeasurements = NULL;
+	mMeasurementCount = 0;
+	mLeafLimit = 8;
+	mThreads = 1;
+}
+
+// destructor
+Tuner::~Tuner() {
+	clear();
+
+	if (mMeasurements != NULL) {
+		delete[] mMeasurements;
+	}
+}
+
+// discard the sample
+void Tuner::clear() {
+	for (int i = 0; i < mQueryCount; i++) {
+		delete mQueries[i];
+	}
+
+	if (mQueries != NULL) {
+		delete[] mQueries;
+	}
+	if (mSample != NULL) {
+		delete[] mSample;
+	}
+
+	mQueries = NULL;
+	mQueryCount = 0;
+	mSample = NULL;
+	mSampleSize = 0;
+}
+
+// sample the largest cardinality buckets of <prints> and the queries
+// if the largest bucket alone exceeds TUNE_SAMPLE_SIZE, its prints are thinned out evenly
+void Tuner::sample(Fingerprint **prints, long long size, int nBits) {
+	long long count[nBits + 1];		// size of each cardinality bucket
+	int taken[nBits + 1];			// flag if a bucket is sampled
+	long long total = 0;			// number of prints in the sampled buckets
+	long long seen = 0;			// number of prints of sampled buckets seen so far
+	long long j = 0;
+
+	clear();
+
+	for (int c = 0; c <= nBits; c++) {
+		count[c] = 0;
+		taken[c] = 0;
+	}
+	for (long long i = 0; i < size; i++) {
+		count[prints[i]->cardinality()]++;
+	}
+
+	// take the largest buckets as long as they fit, but at least one
+	while (1) {
+		int largest = -1;
+
+		for (int c = 0; c <= nBits; c++) {
+			if (!taken[c] && (count[c] > 0) && ((largest < 0) || (count[c] > count[largest]))) {
+				largest = c;
+			}
+		}
+
+		if ((largest < 0) || ((total > 0) && (total + count[largest] > TUNE_SAMPLE_SIZE))) {
+			break;
+		}
+
+		taken[largest] = 1;
+		total += count[largest];
+	}
+
+	mSampleSize = MIN(total, (long long) TUNE_SAMPLE_SIZE);
+	mSample = new Fingerprint*[MAX(mSampleSize, 1LL)];
+	mNBits = nBits;
+
+	// take every print of the sampled buckets whose position in the
+	// buckets starts a new part of the sample
+	for (long long i = 0; i < size; i++) {
+		if (taken[prints[i]->cardinality()]) {
+			if (seen * mSampleSize / total == j) {
+				mSample[j++] = prints[i];
+			}
+			seen++;
+		}
+	}
+
+	// queries are evenly spaced copies of the sample
+	mQueryCount = (int) MIN((long long) TUNE_QUERIES, mSampleSize);
+	mQueries = new Fingerprint*[MAX(mQueryCount, 1)];
+
+	for (int i = 0; i < mQueryCount; i++) {
+		mQueries[i] = new Fingerprint(mSample[i * mSampleSize / mQueryCount]);
+	}
+}
+
+// build a grid of the sample in <pool> and return the throughput of the queries
+// the grid owns its prints, so it gets copies of the sample
+// the build is not timed
+double Tuner::measure(ThreadPool *pool, int leafLimit) {
+	Fingerprint **prints = new Fingerprint*[mSampleSize];
+	double start, time;
+	int rounds = 0;
+
+	for (long long i = 0; i < mSampleSize; i++) {
+		prints[i] = new Fingerprint(mSample[i]);
+	}
+
+	Grid1D grid(prints, mSampleSize, mNBits, pool, leafLimit, mDims, mEngine, mMinTanimoto, NULL);
+
+	start = tuneTime();
+
+	// repeat the queries until the time can be measured reliably
+	do {
+		for (int i = 0; i < mQueryCount; i += TUNE_BATCH) {
+			QueryResult queryResult(SORT_NONE, NULL, grid.getRecords(), grid.getThreads());
+
+			for (int j = i; j < MIN(i + TUNE_BATCH, mQueryCount); j++) {
+				grid.searchAsync(&queryResult, mQueries[j], mMinTanimoto, NULL);
+			}
+
+			grid.wait();
+		}
+
+		rounds++;
+		time = tuneTime() - start;
+	} while (time < TUNE_SECONDS);
+
+	return rounds * mQueryCount / time;
+}
+
+// choose the fastest leaf limit in <pool>
+void Tuner::tuneLeafLimit(ThreadPool *pool) {
+	double best = 0;
+
+	for (int i = 0; i < TUNE_LEAF_LIMIT_COUNT; i++) {
+		tuneMeasurementType *measurement = &mMeasurements[mMeasurementCount++];
+
+		measurement->leafLimit = TUNE_LEAF_LIMITS[i];
+		measurement->threads = pool->getSize();
+		measurement->queriesPerSecond = measure(pool, TUNE_LEAF_LIMITS[i]);
+
+		if (measurement->queriesPerSecond > best) {
+			best = measurement->queriesPerSecond;
+			mLeafLimit = TUNE_LEAF_LIMITS[i];
+		}
+	}
+}
+
+// choose the leaf limit and at most <maxThreads> threads for <prints>
+// the leaf limit is measured with one thread, the thread counts with the chosen leaf limit
+void Tuner::tune(Fingerprint **prints, long long size, int nBits, int maxThreads, int numa) {
+	int counts = 1;
+	double best = 0;
+	double *throughput;
+	int *threads;
+
+	while ((1 << counts) < maxThreads) {
+		counts++;
+	}
+	counts += (maxThreads > 1);
+
+	if (mMeasurements != NULL) {
+		delete[] mMeasurements;
+	}
+	mMeasurements = new tuneMeasurementType[TUNE_LEAF_LIMIT_COUNT + counts];
+	mMeasurementCount = 0;
+	mThreads = 1;
+
+	sample(prints, size, nBits);
+
+	if (mSampleSize == 0) {
+		clear();
+		return;
+	}
+
+	// choose leaf limit with one thread
+	ThreadPool *pool = new ThreadPool(1, numa);
+	tuneLeafLimit(pool);
+	delete pool;
+
+	// measure powers of two and the maximum
+	throughput = new double[counts];
+	threads = new int[counts];
+
+	for (int i = 0; i < counts; i++) {
+		threads[i] = MIN(1 << i, maxThreads);
+
+		if (i == 0) {
+			// one thread was measured with the chosen leaf limit already
+			for (int j = 0; j < mMeasurementCount; j++) {
+				if (mMeasurements[j].leafLimit == mLeafLimit) {
+					throughput[i] = mMeasurements[j].queriesPerSecond;
+				}
+			}
+		} else {
+			tuneMeasurementType *measurement = &mMeasurements[mMeasurementCount++];
+
+			pool = new ThreadPool(threads[i], numa);
+			throughput[i] = measure(pool, mLeafLimit);
+			delete pool;
+
+			measurement->leafLimit = mLeafLimit;
+			measurement->threads = threads[i];
+			measurement->queriesPerSecond = throughput[i];
+		}
+
+		best = MAX(best, throughput[i]);
+	}
+
+	// choose the smallest thread count that is close to the best
+	for (int i = counts - 1; i >= 0; i--) {
+		if (throughput[i] >= TUNE_SCALING * best) {
+			mThreads = threads[i];
+		}
+	}
+
+	delete[] throughput;
+	delete[] threads;
+
+	clear();
+}
+
+// choose the leaf limit for <prints> searched by the shared <pool>
+void Tuner::tune(Fingerprint **prints, long long size, int nBits, ThreadPool *pool) {
+	if (mMeasurements != NULL) {
+		delete[] mMeasurements;
+	}
+	mMeasurements = new tuneMeasurementType[TUNE_LEAF_LIMIT_COUNT];
+	mMeasurementCount = 0;
+	mThreads = pool->getSize();
+
+	sample(prints, size, nBits);
+
+	if (mSampleSize > 0) {
+		tuneLeafLimit(pool);
+	}
+
+	clear();
+}
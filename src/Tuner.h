@@ -0,0 +1,125 @@
+// Tuner.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TUNER_H
+#define TUNER_H
+
+#include "Fingerprint.h"
+#include "ThreadPool.h"
+
+#define TUNE_SAMPLE_SIZE 20000		// maximal number of sampled prints
+#define TUNE_QUERIES 500		// number of sampled queries
+#define TUNE_BATCH 50			// queries per QueryResult, bounds the memory of the results
+#define TUNE_SECONDS 0.2		// minimal time of a measurement, the queries are repeated
+#define TUNE_SCALING 0.95		// fraction of the best throughput a smaller thread count must reach
+
+// leaf limits that are tried
+static const int TUNE_LEAF_LIMITS[] = {1, 2, 4, 8, 16, 32, 64};
+#define TUNE_LEAF_LIMIT_COUNT 7
+
+// Instances of tuneMeasurementType hold the throughput
+// of the sampled queries for one setting.
+typedef struct tuneMeasurementStruct {
+	int leafLimit;			// leaf limit of the trees
+	int threads;			// number of threads
+	double queriesPerSecond;	// throughput of the sampled queries
+} tuneMeasurementType;
+
+// Objects of class Tuner choose the leaf limit and the number of threads
+// of a Grid1D for a set of fingerprints and a Tanimoto filter.
+//
+// The sample consists of the largest cardinality buckets, as most queries
+// are searched in them. Grids are built from copies of the sampled prints
+// with each leaf limit and one thread, and a sample of the prints is searched
+// as queries. The fastest leaf limit is then measured with thread counts of
+// powers of two up to the maximum. The smallest count that reaches
+// TUNE_SCALING of the best throughput is chosen, so threads are only added
+// while they pay off.
+
+class Tuner {
+	private:
+
+	int mDims;				// number of bit ranges for cells
+	int mEngine;				// search engine of the cells
+	float mMinTanimoto;			// Tanimoto filter of the sampled queries
+	Fingerprint **mSample;			// sampled prints, not owned
+	long long mSampleSize;			// number of sampled prints
+	int mNBits;				// maximal size of the sampled prints
+	Fingerprint **mQueries;			// copies of the sampled queries
+	int mQueryCount;			// number of sampled queries
+	tuneMeasurementType *mMeasurements;	// measured settings
+	int mMeasurementCount;			// number of measured settings
+	int mLeafLimit;				// chosen leaf limit
+	int mThreads;				// chosen number of threads
+
+	// sample the largest cardinality buckets of <prints> and the queries
+	void sample(Fingerprint **prints, long long size, int nBits);
+
+	// build a grid of the sample in <pool> and return the throughput of the queries
+	double measure(ThreadPool *pool, int leafLimit);
+
+	// choose the fastest leaf limit in <pool>
+	void tuneLeafLimit(ThreadPool *pool);
+
+	// discard the sample
+	void clear();
+
+	public:
+
+	// constructor
+	// tune for searches with <minTanimoto> in grids with <dims> bit ranges and <engine>
+	Tuner(int dims, int engine, float minTanimoto);
+
+	// destructor
+	~Tuner();
+
+	// choose the leaf limit and at most <maxThreads> threads for <prints>
+	// the ThreadPools are NUMA-aware if <numa> is set
+	void tune(Fingerprint **prints, long long size, int nBits, int maxThreads, int numa);
+
+	// choose the leaf limit for <prints> searched by the shared <pool>
+	void tune(Fingerprint **prints, long long size, int nBits, ThreadPool *pool);
+
+	// get chosen leaf limit
+	inline int getLeafLimit() {
+		return mLeafLimit;
+	}
+
+	// get chosen number of threads
+	inline int getThreads() {
+		return mThreads;
+	}
+
+	// get measured settings
+	inline tuneMeasurementType *getMeasurements() {
+		return mMeasurements;
+	}
+
+	// get number of measured settings
+	inline int getMeasurementCount() {
+		return mMeasurementCount;
+	}
+};
+#endif
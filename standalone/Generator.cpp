@@ -0,0 +1,138 @@
+// Generator.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "Generator.h"
+
+// syllables for names
+static const char *sSyllables[] = {
+	"AN", "BER", "CHRI", "DA", "EL", "FRIED", "GER", "HANS", "IN", "JO",
+	"KAR", "LO", "MA", "NIE", "OT", "PE", "RA", "SCHMI", "STE", "THO",
+	"UL", "VOL", "WER", "ZIM", "MEI", "ER", "MANN", "TER", "SCH", "KO"
+};
+
+#define SYLLABLES (sizeof(sSyllables) / sizeof(sSyllables[0]))
+
+// constructor for fingerprints of <length> bits with about <density> set bits
+// and duplicates with <errorRate> errors per character
+Generator::Generator(int length, double density, double errorRate, unsigned long long seed) {
+	char text[GENERATOR_TEXT_SIZE];
+	double bigrams = 0;
+
+	mState = seed | 1;
+	mLength = length;
+	mErrorRate = errorRate;
+
+	// each record has its length + 1 padded bigrams
+	for (int i = 0; i < GENERATOR_SAMPLES; i++) {
+		bigrams += record(text) + 1;
+	}
+	bigrams /= GENERATOR_SAMPLES;
+
+	// the expected density of a Bloom filter with k hashes of b bigrams
+	// into m bits is 1 - exp(-k * b / m)
+	mHashes = (int) floor(-log(1.0 - density) * length / bigrams + 0.5);
+	mHashes = (mHashes < 1) ? 1 : mHashes;
+}
+
+// create the text of a new random record, return its length
+int Generator::record(char *text) {
+	int len = 0;
+
+	// first name, last name
+	for (int name = 0; name < 2; name++) {
+		int syllables = 2 + uniform(2);
+
+		for (int i = 0; i < syllables; i++) {
+			const char *syllable = sSyllables[uniform(SYLLABLES)];
+
+			strcpy(text + len, syllable);
+			len += strlen(syllable);
+		}
+		text[len++] = ' ';
+	}
+
+	// date of birth
+	len += sprintf(text + len, "%04d%02d%02d", 1920 + uniform(90), 1 + uniform(12), 1 + uniform(28));
+
+	return len;
+}
+
+// create the text of a duplicate of <text> with random errors, return its length
+int Generator::duplicate(const char *text, char *copy) {
+	int len = 0;
+
+	for (int i = 0; (text[i] != 0) && (len < GENERATOR_TEXT_SIZE - 2); i++) {
+		if (real() >= mErrorRate) {
+			copy[len++] = text[i];
+			continue;
+		}
+
+		// substitution, deletion or insertion
+		switch (uniform(3)) {
+			case 0:
+				copy[len++] = 'A' + uniform(26);
+				break;
+			case 1:
+				break;
+			default:
+				copy[len++] = 'A' + uniform(26);
+				copy[len++] = text[i];
+				break;
+		}
+	}
+	copy[len] = 0;
+
+	return len;
+}
+
+// encode <text> as ascii-string of the CLK with <mLength> bits
+void Generator::encode(const char *text, char *bits) {
+	int len = strlen(text);
+
+	memset(bits, '0', mLength);
+	bits[mLength] = 0;
+
+	// padded bigrams " a", "ab", ..., "z "
+	for (int i = -1; i < len; i++) {
+		unsigned char first = (i < 0) ? ' ' : text[i];
+		unsigned char second = (i + 1 < len) ? text[i + 1] : ' ';
+		unsigned long long h1 = 14695981039346656037ULL;
+		unsigned long long h2 = 5381;
+
+		// FNV-1a and djb2 as base hashes for double hashing
+		h1 = (h1 ^ first) * 1099511628211ULL;
+		h1 = (h1 ^ second) * 1099511628211ULL;
+		h2 = ((h2 << 5) + h2) + first;
+		h2 = ((h2 << 5) + h2) + second;
+
+		for (int k = 0; k < mHashes; k++) {
+			bits[(h1 + k * h2) % mLength] = '1';
+		}
+	}
+}
@@ -0,0 +1,98 @@
+// Generator.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#define GENERATOR_TEXT_SIZE 64		// maximal length of a generated record text
+#define GENERATOR_SAMPLES 1000		// records used to estimate the number of bigrams
+
+// Instances of Generator create synthetic records for benchmarks and
+// encode them as cryptographic long-term keys (CLKs), i.e. Bloom filters
+// of the padded bigrams of the record text hashed by double hashing.
+// Records are made of names and a date of birth. A duplicate of a record
+// is a copy of its text with random typing errors, so its fingerprint has
+// a high, but not perfect Tanimoto coefficient to the original one.
+// The number of hash functions is chosen to reach the requested density.
+class Generator {
+	private:
+
+	unsigned long long mState;		// state of the random number generator
+	int mLength;				// bit-length of the fingerprints
+	int mHashes;				// number of hash functions per bigram
+	double mErrorRate;			// probability of an error per character
+
+	// get next random number
+	inline unsigned long long next() {
+		// xorshift64*
+		mState ^= mState >> 12;
+		mState ^= mState << 25;
+		mState ^= mState >> 27;
+
+		return mState * 2685821657736338717ULL;
+	}
+
+	// get a random number between 0 and <n>-1
+	inline int uniform(int n) {
+		return (int) ((next() >> 33) % n);
+	}
+
+	// get a random number between 0 and 1
+	inline double real() {
+		return (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	public:
+
+	// constructor for fingerprints of <length> bits with about <density> set bits
+	// and duplicates with <errorRate> errors per character
+	Generator(int length, double density, double errorRate, unsigned long long seed);
+
+	// create the text of a new random record, return its length
+	int record(char *text);
+
+	// create the text of a duplicate of <text> with random errors, return its length
+	int duplicate(const char *text, char *copy);
+
+	// encode <text> as ascii-string of the CLK with <mLength> bits
+	void encode(const char *text, char *bits);
+
+	// get a random number between 0 and 1
+	inline double random() {
+		return real();
+	}
+
+	// get a random number between 0 and <n>-1
+	inline int random(int n) {
+		return uniform(n);
+	}
+
+	// get number of hash functions per bigram
+	inline int getHashes() {
+		return mHashes;
+	}
+};
+#endif
@@ -0,0 +1,100 @@
+// Measure.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include "Misc.h"
+
+// This file contains helper functions for the standalone programs
+// to measure time, latencies and memory.
+
+// get monotonic time in seconds
+inline double currentTime() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// compare function for latencies
+inline int compareDoubles(const void *a, const void *b) {
+	double x = *((const double*) a);
+	double y = *((const double*) b);
+
+	return (x > y) - (x < y);
+}
+
+// get percentile <p> of sorted <values>
+inline double percentile(double *values, long long size, double p) {
+	if (size == 0) {
+		return 0;
+	}
+
+	return values[MIN((long long) (p * size), size - 1)];
+}
+
+// get resident memory of the process in bytes, 0 if it is unknown
+// the value is read from procfs on Linux
+inline long long residentMemory() {
+	FILE *in = fopen("/proc/self/status", "r");
+	char line[256];
+	long long kb = 0;
+
+	if (in == NULL) {
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		if (strncmp(line, "VmRSS:", 6) == 0) {
+			sscanf(line + 6, "%lld", &kb);
+			break;
+		}
+	}
+
+	fclose(in);
+
+	return kb * 1024;
+}
+
+// get number of bytes allocated on the heap
+// freed memory that is kept by the allocator is not counted,
+// so the value can be compared before and after building a grid
+inline long long allocatedMemory() {
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+
+	return (long long) (info.uordblks + info.hblkhd);
+#else
+	return residentMemory();
+#endif
+}
+#endif
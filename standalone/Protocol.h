@@ -0,0 +1,226 @@
+// Protocol.h
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "Fingerprint.h"
+
+// This file contains the binary protocol of the search server and
+// helper functions for its clients.
+//
+// A client sends requests over a Unix domain socket and may send further
+// requests before the responses arrive. Each request is a requestType
+// followed by the query's bits, lowest bit first, padded to whole bytes.
+// Each response is a responseType followed by its records and, if the
+// request has the flag REQUEST_IDS, by the ids of the records' fingerprints
+// as null-terminated strings in the order of the records. Records name
+// fingerprints by their line in the index file, starting with 0. Responses
+// of a connection are sent in the order of its requests. All numbers are
+// in the byte order of the host, as both sides run on the same machine.
+
+#define PROTOCOL_MAGIC 0x3154424du	// "MBT1" in little endian byte order
+#define PROTOCOL_MAX_BITS 65536		// maximal bit-length of a query
+
+#define REQUEST_SORT 1			// flag to sort the results by descending score
+#define REQUEST_IDS 2			// flag to send the ids of the fingerprints
+
+// status of a response
+#define STATUS_OK 0			// the records hold the results
+#define STATUS_INDEX 1			// the index does not exist
+#define STATUS_INVALID 2		// the measure or threshold is invalid
+
+// Instances of requestType hold the parameters of a search.
+typedef struct requestStruct {
+	unsigned int magic;		// PROTOCOL_MAGIC
+	unsigned int id;		// chosen by the client and returned in the response
+	unsigned short index;		// number of the index in the order of the server's index files
+	unsigned char measure;		// MEASURE_TANIMOTO, MEASURE_DICE, MEASURE_TVERSKY or MEASURE_HAMMING
+	unsigned char flags;		// REQUEST_SORT and REQUEST_IDS
+	float threshold;		// minimal score or maximal Hamming distance
+	float alpha;			// weights of the Tversky index
+	float beta;
+	unsigned int limit;		// maximal number of results, 0 for no limit
+	unsigned int bits;		// bit-length of the query
+} requestType;
+
+// Instances of responseType precede the records of a response.
+typedef struct responseStruct {
+	unsigned int magic;		// PROTOCOL_MAGIC
+	unsigned int id;		// id of the request
+	unsigned int status;		// STATUS_OK, STATUS_INDEX or STATUS_INVALID
+	unsigned int count;		// number of records
+	unsigned int idBytes;		// size of the ids after the records, 0 without REQUEST_IDS
+} responseType;
+
+// Instances of responseRecordType hold a single result.
+typedef struct responseRecordStruct {
+	unsigned int print;		// line of the fingerprint in the index file, starting with 0
+	float score;			// score or Hamming distance
+} responseRecordType;
+
+// Instances of responseBufferType hold the records and ids of a received response.
+// The buffers grow with the responses.
+typedef struct responseBufferStruct {
+	responseRecordType *records;	// records of the response
+	unsigned int recordCapacity;	// allocated size of records
+	char *ids;			// ids of the records, NULL before the first ids
+	unsigned int idCapacity;	// allocated size of ids
+} responseBufferType;
+
+// initialize an empty response buffer
+inline void responseBufferInit(responseBufferType *buffer) {
+	buffer->recordCapacity = 1024;
+	buffer->records = new responseRecordType[buffer->recordCapacity];
+	buffer->ids = NULL;
+	buffer->idCapacity = 0;
+}
+
+// release the buffers of <buffer>
+inline void responseBufferFree(responseBufferType *buffer) {
+	delete[] buffer->records;
+	delete[] buffer->ids;
+}
+
+// get the number of bytes of a query of <bits> bits
+inline int protocolBytes(unsigned int bits) {
+	return (bits + 7) / 8;
+}
+
+// write <size> bytes of <data> to socket <fd>, return 0 on failure
+inline int sendAll(int fd, const void *data, size_t size) {
+	const char *ptr = (const char*) data;
+
+	while (size > 0) {
+		ssize_t n = send(fd, ptr, size, MSG_NOSIGNAL);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		ptr += n;
+		size -= n;
+	}
+
+	return 1;
+}
+
+// read <size> bytes from socket <fd> into <data>, return 0 on failure or end of stream
+inline int receiveAll(int fd, void *data, size_t size) {
+	char *ptr = (char*) data;
+
+	while (size > 0) {
+		ssize_t n = recv(fd, ptr, size, 0);
+
+		if (n <= 0) {
+			if ((n < 0) && (errno == EINTR)) {
+				continue;
+			}
+			return 0;
+		}
+		ptr += n;
+		size -= n;
+	}
+
+	return 1;
+}
+
+// connect to the server at socket <path>, return the socket or -1 on failure
+inline int connectServer(const char *path) {
+	struct sockaddr_un address;
+	int fd;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// send <request> with the bits of <query> to socket <fd>
+// the id and search parameters of <request> must be set, return 0 on failure
+inline int sendRequest(int fd, requestType *request, Fingerprint *query) {
+	unsigned char data[sizeof(requestType) + PROTOCOL_MAX_BITS / 8];
+	int bytes;
+
+	request->magic = PROTOCOL_MAGIC;
+	request->bits = MIN(query->getLength(), PROTOCOL_MAX_BITS);
+	bytes = protocolBytes(request->bits);
+
+	memcpy(data, request, sizeof(requestType));
+	for (int i = 0; i < bytes; i++) {
+		data[sizeof(requestType) + i] = (query->getWord(i / (WORD_LEN / 8)) >> (8 * (i % (WORD_LEN / 8)))) & 0xFF;
+	}
+
+	return sendAll(fd, data, sizeof(requestType) + bytes);
+}
+
+// receive a response from socket <fd> into <response> and its records and ids
+// into <buffer>, return 0 on failure
+inline int receiveResponse(int fd, responseType *response, responseBufferType *buffer) {
+	if (!receiveAll(fd, response, sizeof(responseType)) || (response->magic != PROTOCOL_MAGIC)
+		|| (response->count > INT_MAX / sizeof(responseRecordType)) || (response->idBytes > INT_MAX)) {
+		return 0;
+	}
+
+	if (response->count > buffer->recordCapacity) {
+		delete[] buffer->records;
+		buffer->recordCapacity = MAX(response->count, 2 * buffer->recordCapacity);
+		buffer->records = new responseRecordType[buffer->recordCapacity];
+	}
+
+	if (response->idBytes > buffer->idCapacity) {
+		delete[] buffer->ids;
+		buffer->idCapacity = MAX(response->idBytes, 2 * buffer->idCapacity);
+		buffer->ids = new char[buffer->idCapacity];
+	}
+
+	return receiveAll(fd, buffer->records, response->count * sizeof(responseRecordType))
+		&& receiveAll(fd, buffer->ids, response->idBytes);
+}
+#endif
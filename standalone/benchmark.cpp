@@ -0,0 +1,414 @@
+// benchmark.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Grid1D.h"
+#include "Generator.h"
+#include "Measure.h"
+
+// This file contains a standalone benchmark for the search without R.
+// It generates synthetic CLK fingerprints, writes the records into a
+// temporary file and then, for each combination of thread count, leafLimit,
+// dims, engine and threshold, loads the records, builds a grid and searches
+// the queries. The cost model of the grid plans for the first threshold. The results are printed as csv with one line per combination.
+//
+// load time	reading and parsing the record file
+// build time	constructing the grid
+// memory	heap memory held by the prints and the grid
+// qps		queries per second of a batch search through the asynchronous path
+// latency	percentiles of single searches of a sample of the queries
+// recall	fraction of the planted duplicates that were found
+
+#define MAX_VALUES 32			// maximal number of values of a list option
+
+// parameters of the benchmark
+typedef struct benchmarkStruct {
+	long long records;		// number of records
+	long long queries;		// number of queries
+	int bits;			// bit-length of the fingerprints
+	double density;			// requested fraction of set bits
+	double duplicateRate;		// fraction of queries that are duplicates of records
+	double errorRate;		// errors per character in duplicates
+	long long latencySample;	// number of queries searched one by one
+	int numa;			// flag if the thread pools are NUMA-aware
+	unsigned long long seed;	// seed of the generator
+	double thresholds[MAX_VALUES];	// minimal Tanimoto coefficients
+	int nThresholds;
+	double leafLimits[MAX_VALUES];	// leaf limits of the trees
+	int nLeafLimits;
+	double threads[MAX_VALUES];	// thread counts
+	int nThreads;
+	double dims[MAX_VALUES];	// number of bit ranges for cells
+	int nDims;
+	int engines[MAX_VALUES];	// search engines of the cells
+	int nEngines;
+} benchmarkType;
+
+// parse comma-separated list <str> into <values>, return number of values
+int parseList(const char *str, double *values) {
+	int n = 0;
+	char *end;
+
+	while ((*str != 0) && (n < MAX_VALUES)) {
+		values[n++] = strtod(str, &end);
+		if ((end == str) || ((*end != ',') && (*end != 0))) {
+			fprintf(stderr, "invalid list '%s'\n", str);
+			exit(1);
+		}
+		str = (*end == ',') ? end + 1 : end;
+	}
+
+	return n;
+}
+
+// parse comma-separated list <str> of engine names into <engines>,
+// return number of engines
+int parseEngines(const char *str, int *engines) {
+	int n = 0;
+
+	while ((*str != 0) && (n < MAX_VALUES)) {
+		int length = strcspn(str, ",");
+
+		engines[n] = -1;
+		for (int i = 0; i < ENGINES; i++) {
+			if ((strncmp(str, ENGINE_NAMES[i], length) == 0) && (ENGINE_NAMES[i][length] == 0)) {
+				engines[n] = i;
+			}
+		}
+		if (engines[n] < 0) {
+			fprintf(stderr, "invalid engine list '%s'\n", str);
+			exit(1);
+		}
+		n++;
+		str = (str[length] == ',') ? str + length + 1 : str + length;
+	}
+
+	return n;
+}
+
+// print usage and exit
+void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n records        number of records (default 100000)\n"
+		"  -q queries        number of queries (default 10000)\n"
+		"  -b bits           bit-length of the fingerprints (default 1000)\n"
+		"  -d density        fraction of set bits (default 0.3)\n"
+		"  -r rate           fraction of queries that are duplicates (default 0.5)\n"
+		"  -e rate           errors per character in duplicates (default 0.05)\n"
+		"  -t list           thresholds (default 0.8)\n"
+		"  -l list           leaf limits (default 8)\n"
+		"  -T list           thread counts (default 1 and all cpus)\n"
+		"  -D list           number of bit ranges for cells (default 1)\n"
+		"  -E list           engines of the cells: auto, tree or scan (default auto)\n"
+		"  -L size           number of queries for latencies (default 1000)\n"
+		"  -N                bind threads to NUMA nodes\n"
+		"  -s seed           seed of the generator (default 1)\n"
+		"  -o file           write csv to file instead of stdout\n",
+		name);
+	exit(1);
+}
+
+// generate records into file <out> and queries into <queries>
+// <sources> gets the record number of each duplicate query, -1 for others
+void generate(benchmarkType *bench, Generator *generator, FILE *out, char **queries, long long *sources) {
+	char text[GENERATOR_TEXT_SIZE];
+	char copy[GENERATOR_TEXT_SIZE];
+	char *bits = new char[bench->bits + 1];
+	long long duplicates = (long long) (bench->duplicateRate * bench->queries);
+	long long nQueries = 0;
+
+	for (long long i = 0; i < bench->records; i++) {
+		generator->record(text);
+		generator->encode(text, bits);
+		fprintf(out, "%s\n", bits);
+
+		// plant each duplicate with the same probability
+		if ((nQueries < duplicates) && (generator->random() * (bench->records - i) < duplicates - nQueries)) {
+			generator->duplicate(text, copy);
+			generator->encode(copy, queries[nQueries]);
+			sources[nQueries++] = i;
+		}
+	}
+
+	// the other queries have no matching record
+	while (nQueries < bench->queries) {
+		generator->record(text);
+		generator->encode(text, queries[nQueries]);
+		sources[nQueries++] = -1;
+	}
+
+	// shuffle queries
+	for (long long i = bench->queries - 1; i > 0; i--) {
+		long long j = (long long) (generator->random() * (i + 1));
+		char *query = queries[i];
+		long long source = sources[i];
+
+		queries[i] = queries[j];
+		sources[i] = sources[j];
+		queries[j] = query;
+		sources[j] = source;
+	}
+
+	delete[] bits;
+}
+
+// read records from <in> into <prints>, return the maximal length
+int load(FILE *in, Fingerprint **prints, long long size, int bits, double *density) {
+	char *str = new char[bits + 16];
+	int nBits = 0;
+	long long setBits = 0;
+
+	rewind(in);
+
+	for (long long i = 0; i < size; i++) {
+		char *idStr = new char[21];
+
+		if (fgets(str, bits + 16, in) == NULL) {
+			fprintf(stderr, "cannot read record %lld\n", i + 1);
+			exit(1);
+		}
+		sprintf(idStr, "%012lld", i + 1);
+		prints[i] = new Fingerprint(idStr, str);
+		nBits = MAX(nBits, prints[i]->getLength());
+		setBits += prints[i]->cardinality();
+	}
+
+	*density = (double) setBits / ((double) size * bits);
+	delete[] str;
+
+	return nBits;
+}
+
+// search all queries asynchronously, return number of results
+// <found> gets the number of planted duplicates among the results
+long long searchBatch(Grid1D *grid, char **queries, long long *sources, long long size, float minTanimoto, long long *found) {
+	QueryResult queryResult(SORT_NONE, NULL, grid->getRecords(), grid->getThreads());
+	QueryPool queryPool(QUERY_POOL_SIZE);
+	resultRecordType *records;
+	long long sizeResult;
+
+	for (long long i = 0; i < size; i++) {
+		Fingerprint *queryPrint = queryPool.acquire(i);
+
+		queryPrint->parse(queries[i]);
+		grid->searchAsync(&queryResult, queryPrint, minTanimoto, &queryPool);
+	}
+
+	grid->wait();
+	queryResult.finish();
+	queryResult.merge(grid->getWorkerPool());
+
+	sizeResult = queryResult.getSize();
+	records = queryResult.getRecords();
+	*found = 0;
+
+	for (long long i = 0; i < sizeResult; i++) {
+		if (sources[records[i].query] == (long long) records[i].print) {
+			(*found)++;
+		}
+	}
+
+	return sizeResult;
+}
+
+// search the first <size> queries one by one and store their latencies in ms
+void searchSingle(Grid1D *grid, char **queries, long long size, float minTanimoto, double *latencies) {
+	Fingerprint queryPrint(NULL, "");
+
+	for (long long i = 0; i < size; i++) {
+		QueryResult queryResult(SORT_NONE, NULL, grid->getRecords(), grid->getThreads());
+		double start = currentTime();
+
+		queryPrint.parse(queries[i]);
+		grid->search(&queryResult, &queryPrint, minTanimoto);
+		queryResult.merge(grid->getWorkerPool());
+		latencies[i] = (currentTime() - start) * 1000;
+	}
+
+	qsort(latencies, size, sizeof(double), compareDoubles);
+}
+
+int main(int argc, char **argv) {
+	benchmarkType bench;
+	FILE *recordFile;
+	FILE *out = stdout;
+	char **queries;
+	long long *sources;
+	long long duplicates = 0;
+	double *latencies;
+	int opt;
+
+	bench.records = 100000;
+	bench.queries = 10000;
+	bench.bits = 1000;
+	bench.density = 0.3;
+	bench.duplicateRate = 0.5;
+	bench.errorRate = 0.05;
+	bench.latencySample = 1000;
+	bench.numa = 0;
+	bench.seed = 1;
+	bench.thresholds[0] = 0.8;
+	bench.nThresholds = 1;
+	bench.leafLimits[0] = 8;
+	bench.nLeafLimits = 1;
+	bench.threads[0] = 1;
+	bench.threads[1] = sysconf(_SC_NPROCESSORS_ONLN);
+	bench.nThreads = (bench.threads[1] > 1) ? 2 : 1;
+	bench.dims[0] = 1;
+	bench.nDims = 1;
+	bench.engines[0] = ENGINE_AUTO;
+	bench.nEngines = 1;
+
+	while ((opt = getopt(argc, argv, "n:q:b:d:r:e:t:l:T:D:E:L:Ns:o:")) != -1) {
+		switch (opt) {
+			case 'n': bench.records = atoll(optarg); break;
+			case 'q': bench.queries = atoll(optarg); break;
+			case 'b': bench.bits = atoi(optarg); break;
+			case 'd': bench.density = atof(optarg); break;
+			case 'r': bench.duplicateRate = atof(optarg); break;
+			case 'e': bench.errorRate = atof(optarg); break;
+			case 't': bench.nThresholds = parseList(optarg, bench.thresholds); break;
+			case 'l': bench.nLeafLimits = parseList(optarg, bench.leafLimits); break;
+			case 'T': bench.nThreads = parseList(optarg, bench.threads); break;
+			case 'D': bench.nDims = parseList(optarg, bench.dims); break;
+			case 'E': bench.nEngines = parseEngines(optarg, bench.engines); break;
+			case 'L': bench.latencySample = atoll(optarg); break;
+			case 'N': bench.numa = 1; break;
+			case 's': bench.seed = strtoull(optarg, NULL, 10); break;
+			case 'o':
+				out = fopen(optarg, "w");
+				if (out == NULL) {
+					fprintf(stderr, "cannot open %s\n", optarg);
+					return 1;
+				}
+				break;
+			default: usage(argv[0]);
+		}
+	}
+
+	if ((bench.records < 1) || (bench.queries < 1) || (bench.bits < 1) || (bench.density <= 0) || (bench.density >= 1)) {
+		usage(argv[0]);
+	}
+	bench.latencySample = MIN(MAX(bench.latencySample, 0), bench.queries);
+
+	Fingerprint::init();
+
+	// generate data
+	Generator generator(bench.bits, bench.density, bench.errorRate, bench.seed);
+
+	recordFile = tmpfile();
+	queries = new char*[bench.queries];
+	sources = new long long[bench.queries];
+	latencies = new double[MAX(bench.latencySample, 1)];
+
+	for (long long i = 0; i < bench.queries; i++) {
+		queries[i] = new char[bench.bits + 1];
+	}
+
+	fprintf(stderr, "generating %lld records and %lld queries with %d bits and %d hashes per bigram\n",
+		bench.records, bench.queries, bench.bits, generator.getHashes());
+	generate(&bench, &generator, recordFile, queries, sources);
+
+	for (long long i = 0; i < bench.queries; i++) {
+		duplicates += (sources[i] >= 0);
+	}
+
+	fprintf(out, "records,queries,bits,hashes,density,duplicates,errorRate,threads,leafLimit,dims,engine,threshold,"
+		"loadSeconds,buildSeconds,memoryBytes,scannedCells,queriesPerSecond,latencyP50,latencyP90,latencyP99,latencyMax,results,recall\n");
+
+	for (int t = 0; t < bench.nThreads; t++) {
+		ThreadPool pool((int) bench.threads[t], bench.numa);
+
+		for (int l = 0; l < bench.nLeafLimits; l++) {
+			for (int d = 0; d < bench.nDims; d++) {
+				for (int e = 0; e < bench.nEngines; e++) {
+					Fingerprint **prints = new Fingerprint*[bench.records];
+					long long memory = allocatedMemory();
+					double density, loadTime, buildTime;
+					double values[STATISTICS_SIZE], percents[STATISTICS_SIZE];
+					double start = currentTime();
+					int nBits;
+
+					nBits = load(recordFile, prints, bench.records, bench.bits, &density);
+					loadTime = currentTime() - start;
+
+					start = currentTime();
+					Grid1D grid(prints, bench.records, nBits, &pool, (int) bench.leafLimits[l], (int) bench.dims[d],
+						bench.engines[e], (float) bench.thresholds[0], NULL);
+					buildTime = currentTime() - start;
+					memory = allocatedMemory() - memory;
+					grid.getStatistics(values, percents);
+
+					for (int s = 0; s < bench.nThresholds; s++) {
+						float minTanimoto = (float) bench.thresholds[s];
+						long long sizeResult, found;
+						double searchTime;
+
+						fprintf(stderr, "threads %d leafLimit %d dims %d engine %s threshold %.2f\n",
+							(int) bench.threads[t], (int) bench.leafLimits[l], (int) bench.dims[d],
+							ENGINE_NAMES[bench.engines[e]], minTanimoto);
+
+						start = currentTime();
+						sizeResult = searchBatch(&grid, queries, sources, bench.queries, minTanimoto, &found);
+						searchTime = currentTime() - start;
+
+						searchSingle(&grid, queries, bench.latencySample, minTanimoto, latencies);
+
+						fprintf(out, "%lld,%lld,%d,%d,%.4f,%lld,%.4f,%d,%d,%d,%s,%.4f,%.6f,%.6f,%lld,%.0f,%.1f,%.6f,%.6f,%.6f,%.6f,%lld,%.6f\n",
+							bench.records, bench.queries, bench.bits, generator.getHashes(), density, duplicates,
+							bench.errorRate, (int) bench.threads[t], (int) bench.leafLimits[l], (int) bench.dims[d],
+							ENGINE_NAMES[bench.engines[e]], minTanimoto, loadTime, buildTime, memory, values[5],
+							bench.queries / searchTime,
+							percentile(latencies, bench.latencySample, 0.5),
+							percentile(latencies, bench.latencySample, 0.9),
+							percentile(latencies, bench.latencySample, 0.99),
+							percentile(latencies, bench.latencySample, 1.0),
+							sizeResult, (duplicates > 0) ? (double) found / duplicates : 1.0);
+						fflush(out);
+					}
+				}
+			}
+		}
+	}
+
+	for (long long i = 0; i < bench.queries; i++) {
+		delete[] queries[i];
+	}
+	delete[] queries;
+	delete[] sources;
+	delete[] latencies;
+	fclose(recordFile);
+
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	return 0;
+}
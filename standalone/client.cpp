@@ -0,0 +1,185 @@
+// client.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Parser.h"
+#include "Similarity.h"
+#include "Protocol.h"
+
+// This file contains a client of the search server. It sends the
+// fingerprints of a query file to the server and writes the results as
+// csv to the standard output: the id of the query, the id of the
+// fingerprint and the score, or the Hamming distance. Instead of the ids,
+// the server can send only the line numbers of the fingerprints.
+// Up to <window> requests are sent before the first response is read,
+// so the server can search them in one batch.
+//
+// exit codes
+// 0	success
+// 1	invalid arguments
+// 2	query file cannot be read
+// 3	server cannot be reached or closed the connection
+// 4	the server rejected a request
+
+// print usage and exit
+void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options] socket query-file\n"
+		"  -i index          number of the index of the server (default 0)\n"
+		"  -t threshold      minimal Tanimoto coefficient or score, maximal Hamming distance (default 0.8)\n"
+		"  -d measure        similarity measure: tanimoto, dice, hamming or tversky:alpha,beta\n"
+		"                    (default tanimoto)\n"
+		"  -m size           maximal number of results per query (default 0 = all)\n"
+		"  -S                sort the results of each query by score\n"
+		"  -n                write line numbers of the index file instead of fingerprint ids\n"
+		"  -w window         maximal number of requests without response (default 16)\n"
+		"  -s seperator      column seperator (default ,)\n",
+		name);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	int index = 0;
+	double threshold = 0.8;
+	const char *measureName = MEASURE_NAMES[MEASURE_TANIMOTO];
+	measureType measure;
+	int limit = 0;
+	int sort = 0;
+	int window = 16;
+	int numbers = 0;
+	const char *seperator = ",";
+	Fingerprint **queries;
+	long long sizeQueries;
+	long long sent = 0, received = 0;
+	int nBits;
+	requestType request;
+	responseType response;
+	responseBufferType buffer;
+	const char *id;
+	int status = 0;
+	int fd;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:t:d:m:Sw:s:n")) != -1) {
+		switch (opt) {
+			case 'i': index = atoi(optarg); break;
+			case 't': threshold = atof(optarg); break;
+			case 'd': measureName = optarg; break;
+			case 'm': limit = atoi(optarg); break;
+			case 'S': sort = 1; break;
+			case 'w': window = atoi(optarg); break;
+			case 's': seperator = optarg; break;
+			case 'n': numbers = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	if ((argc - optind != 2) || !measureParse(measureName, &measure) || (index < 0) || (index > 0xFFFF) || (limit < 0) || (window < 1)) {
+		usage(argv[0]);
+	}
+
+	queries = readPrints(argv[optind + 1], 0, &sizeQueries, &nBits);
+
+	if (queries == NULL) {
+		fprintf(stderr, "cannot read query file %s\n", argv[optind + 1]);
+		return 2;
+	}
+
+	fd = connectServer(argv[optind]);
+
+	if (fd < 0) {
+		fprintf(stderr, "cannot connect to %s\n", argv[optind]);
+		return 3;
+	}
+
+	memset(&request, 0, sizeof(requestType));
+	request.index = index;
+	request.measure = measure.type;
+	request.flags = (sort ? REQUEST_SORT : 0) | (numbers ? 0 : REQUEST_IDS);
+	request.threshold = threshold;
+	request.alpha = measure.alpha;
+	request.beta = measure.beta;
+	request.limit = limit;
+
+	responseBufferInit(&buffer);
+	printf("query%sfingerprint%s%s\n", seperator, seperator, MEASURE_NAMES[measure.type]);
+
+	// responses arrive in the order of the requests, their ids are the query numbers
+	while (received < sizeQueries) {
+		while ((sent < sizeQueries) && (sent - received < window)) {
+			request.id = (unsigned int) sent;
+
+			if (!sendRequest(fd, &request, queries[sent])) {
+				fprintf(stderr, "connection to %s failed\n", argv[optind]);
+				return 3;
+			}
+			sent++;
+		}
+
+		if (!receiveResponse(fd, &response, &buffer) || (response.id != (unsigned int) received)) {
+			fprintf(stderr, "connection to %s failed\n", argv[optind]);
+			return 3;
+		}
+
+		if (response.status != STATUS_OK) {
+			fprintf(stderr, "request rejected: %s\n", (response.status == STATUS_INDEX) ? "unknown index" : "invalid measure or threshold");
+			status = 4;
+			break;
+		}
+
+		// the ids follow each other in the order of the records
+		id = buffer.ids;
+		for (unsigned int i = 0; i < response.count; i++) {
+			responseRecordType *record = &buffer.records[i];
+
+			if (numbers) {
+				printf("%s%s%u%s", queries[received]->getId(), seperator, record->print + 1, seperator);
+			} else {
+				printf("%s%s%s%s", queries[received]->getId(), seperator, id, seperator);
+				id += strlen(id) + 1;
+			}
+			if (measure.type == MEASURE_HAMMING) {
+				printf("%d\n", (int) record->score);
+			} else {
+				printf("%.7f\n", record->score);
+			}
+		}
+		received++;
+	}
+
+	close(fd);
+
+	for (long long i = 0; i < sizeQueries; i++) {
+		delete queries[i];
+	}
+	delete[] queries;
+	responseBufferFree(&buffer);
+
+	return status;
+}
@@ -0,0 +1,707 @@
+// linker.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Grid1D.h"
+#include "CompositeGrid.h"
+#include "ResultWriter.h"
+#include "Parser.h"
+#include "BruteForce.h"
+#include "Tuner.h"
+#include "Measure.h"
+
+// This file contains a standalone command-line linker without R.
+// It loads the fingerprints of an index file, searches all fingerprints of
+// a query file through the asynchronous search and writes the results in
+// the format of multibitTree.searchFile. Statistics are printed to the
+// standard error.
+//
+// In verification mode, a sample of the queries is searched by the grid and
+// by a brute-force scan of the same fingerprints instead. Pairs that are only
+// found by the scan were missed by the pruning of the trees or the XOR-hash.
+//
+// With blocking keys, each line of both files holds a key such as sex or
+// birth year between the optional id and the fingerprint, and fingerprints
+// are only compared with queries of the same key.
+//
+// With weights for several fields, each line of both files holds a record of
+// one fingerprint per field, which are searched in a CompositeGrid by their
+// weighted mean Tanimoto coefficient.
+//
+// Fingerprints can be compared by the Dice coefficient, a Tversky index or
+// the Hamming distance instead of the Tanimoto coefficient. The threshold of
+// the Hamming distance is its maximum.
+//
+// With several thresholds, the results of a single search at the lowest
+// threshold are divided into bands, each result belongs to the band of the
+// highest threshold that it reaches. The bands can have their own limits
+// and result files, or are labelled in a band column.
+//
+// exit codes
+// 0	success
+// 1	invalid arguments
+// 2	index or query file cannot be read
+// 3	result file or cell files cannot be written
+// 4	verification found differences
+// 5	cell files could not be searched, the results are incomplete
+
+// print usage and exit
+void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options] index-file query-file\n"
+		"  -o files          result file, - for standard output (default -), or one per band\n"
+		"  -b                write results in binary format instead of csv\n"
+		"  -s seperator      column seperator of csv results (default ,)\n"
+		"  -t thresholds     minimal Tanimoto coefficient or score, maximal Hamming distance (default 0.8),\n"
+		"                    several comma-separated thresholds divide the results into bands\n"
+		"  -d measure        similarity measure: tanimoto, dice, hamming or tversky:alpha,beta\n"
+		"                    (default tanimoto)\n"
+		"  -m sizes          maximal number of results per query (default 0 = all), or one per band\n"
+		"  -S                sort results by query and score\n"
+		"  -T threads        number of threads (default all cpus)\n"
+		"  -l leafLimit      leaf limit of the trees (default 8)\n"
+		"  -A                choose leaf limit and threads from a sample, -T is the maximum\n"
+		"  -D dims           number of bit ranges for cells (default 1)\n"
+		"  -e engine         search engine of the cells: auto, tree or scan (default auto)\n"
+		"  -n size           number of index fingerprints to load (default 0 = all)\n"
+		"  -k                lines hold a blocking key before the fingerprint, only fingerprints\n"
+		"                    and queries with equal keys are compared (-V does not apply)\n"
+		"  -N                bind threads to NUMA nodes\n"
+		"  -O directory      keep the cells in files below directory, out of core\n"
+		"  -R megabytes      maximal size of mapped cells and build batches with -O (default 1024)\n"
+		"  -V size           verify the search of size queries against a brute-force scan\n"
+		"                    (bands do not apply)\n"
+		"  -M                print the heap memory of the index and results by component\n"
+		"  -F weights        records of several fingerprints with these comma-separated weights,\n"
+		"                    searched by the weighted mean Tanimoto coefficient of the fields\n"
+		"                    (-d, -l, -A, -D, -e, -N, -O, -R, -V, -M and bands do not apply)\n"
+		"  -q                do not print statistics\n",
+		name);
+	exit(1);
+}
+
+// compare function for result records by print
+int comparePrints(const void *a, const void *b) {
+	unsigned int x = ((const resultRecordType*) a)->print;
+	unsigned int y = ((const resultRecordType*) b)->print;
+
+	return (x > y) - (x < y);
+}
+
+// search all fingerprints of <queries> and sort the results by print
+// with the grid if <scanner> is NULL or with the scanner
+// return the number of results and add the search time to <time>
+// <minTanimoto> is a threshold of the measure of <result>
+long long searchSorted(Grid1D *grid, BruteForce *scanner, Fingerprint *query, float minTanimoto, QueryResult *result, double *time) {
+	double start = currentTime();
+	float threshold = minTanimoto;
+
+	if (scanner == NULL) {
+		grid->search(result, query, minTanimoto);
+	} else {
+		scanner->search(result, query, query->cardinality(), &threshold);
+	}
+	result->merge(grid->getWorkerPool());
+	*time += currentTime() - start;
+
+	qsort(result->getRecords(), result->getSize(), sizeof(resultRecordType), comparePrints);
+
+	return result->getSize();
+}
+
+// search <sample> evenly spaced fingerprints of <queries> with the grid and
+// with a brute-force scan, print the differences and the speedup
+// <minTanimoto> is a threshold of <measure>
+// return number of differences
+long long verify(Grid1D *grid, BruteForce *scanner, Fingerprint **queries, long long sizeQueries, long long sample, float minTanimoto, const measureType *measure) {
+	RecordTable *records = grid->getRecords();
+	long long treeResults = 0, scanResults = 0;
+	long long missed = 0, extra = 0, different = 0;
+	double treeTime = 0, scanTime = 0;
+
+	sample = MIN(sample, sizeQueries);
+
+	for (long long j = 0; j < sample; j++) {
+		Fingerprint *query = queries[j * sizeQueries / sample];
+		QueryResult treeResult(SORT_NONE, NULL, records, grid->getThreads());
+		QueryResult scanResult(SORT_NONE, NULL, NULL, grid->getThreads());
+		long long sizeTree, sizeScan;
+
+		treeResult.setMeasure(measure);
+		scanResult.setMeasure(measure);
+		sizeTree = searchSorted(grid, NULL, query, minTanimoto, &treeResult, &treeTime);
+		sizeScan = searchSorted(grid, scanner, query, minTanimoto, &scanResult, &scanTime);
+		resultRecordType *tree = treeResult.getRecords();
+		resultRecordType *scan = scanResult.getRecords();
+		long long t = 0, s = 0;
+
+		treeResults += sizeTree;
+		scanResults += sizeScan;
+
+		// merge the results sorted by print
+		while ((t < sizeTree) || (s < sizeScan)) {
+			if ((s == sizeScan) || ((t < sizeTree) && (tree[t].print < scan[s].print))) {
+				fprintf(stdout, "extra:     query %s fingerprint %s score %.7f\n", query->getId(), records->getId(tree[t].print), tree[t].tanimoto);
+				extra++;
+				t++;
+			} else if ((t == sizeTree) || (scan[s].print < tree[t].print)) {
+				fprintf(stdout, "missed:    query %s fingerprint %s score %.7f\n", query->getId(), records->getId(scan[s].print), scan[s].tanimoto);
+				missed++;
+				s++;
+			} else {
+				if (tree[t].tanimoto != scan[s].tanimoto) {
+					fprintf(stdout, "different: query %s fingerprint %s score %.7f instead of %.7f\n", query->getId(), records->getId(tree[t].print), tree[t].tanimoto, scan[s].tanimoto);
+					different++;
+				}
+				t++;
+				s++;
+			}
+		}
+	}
+
+	fprintf(stdout, "verified %lld queries with threshold %.4f of %s\n", sample, measureValue(measure, minTanimoto), MEASURE_NAMES[measure->type]);
+	fprintf(stdout, "results: %lld by trees, %lld by brute force\n", treeResults, scanResults);
+	fprintf(stdout, "missed: %lld, extra: %lld, different: %lld, recall: %.6f\n", missed, extra, different,
+		(scanResults > 0) ? (double) (scanResults - missed) / scanResults : 1.0);
+	fprintf(stdout, "time: %.6f s by trees with %d threads, %.6f s by brute force, speedup %.2f\n",
+		treeTime, grid->getThreads(), scanTime, scanTime / MAX(treeTime, 1e-9));
+
+	return missed + extra + different;
+}
+
+// print the heap memory of <grid> and its last results by component
+void printMemory(Grid1D *grid) {
+	memoryReportType report;
+	long long bytes = 0;
+	long long overhead = 0;
+	long long allocations = 0;
+	long long size = MAX(grid->getSize(), 1);
+	long long heapFree = memoryHeapFree();
+
+	memoryInit(&report);
+	grid->getMemory(&report);
+
+	for (int c = 0; c < MEMORY_COMPONENTS; c++) {
+		fprintf(stderr, "memory:  %-9s %12lld bytes, overhead %11lld bytes, %9lld allocations, %8.1f bytes/print\n",
+			MEMORY_NAMES[c], report.bytes[c], report.overhead[c], report.allocations[c],
+			(double) (report.bytes[c] + report.overhead[c]) / size);
+		bytes += report.bytes[c];
+		overhead += report.overhead[c];
+		allocations += report.allocations[c];
+	}
+
+	fprintf(stderr, "memory:  %-9s %12lld bytes, overhead %11lld bytes, %9lld allocations, %8.1f bytes/print\n",
+		"total", bytes, overhead, allocations, (double) (bytes + overhead) / size);
+
+	if (heapFree >= 0) {
+		fprintf(stderr, "memory:  %lld free bytes kept by the allocator\n", heapFree);
+	}
+}
+
+// parse the comma-separated <list> of at most <max> numbers into <values>
+// return number of values, -1 if the list is invalid or has an empty element
+int parseList(const char *list, double *values, int max) {
+	int count = 0;
+	char *end = NULL;
+
+	while (count < max) {
+		values[count++] = strtod(list, &end);
+
+		if (end == list) {
+			return -1;
+		}
+
+		if (*end != ',') {
+			break;
+		}
+		list = end + 1;
+	}
+
+	return ((end != NULL) && (*end == 0)) ? count : -1;
+}
+
+// parse the comma-separated <list> into <weights>
+// return number of weights, -1 if the list is invalid or all weights are 0
+int parseWeights(const char *list, double *weights) {
+	int count = parseList(list, weights, MAX_FIELDS);
+	double sum = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (!(weights[i] >= 0)) {
+			return -1;
+		}
+		sum += weights[i];
+	}
+
+	return (sum > 0) ? count : -1;
+}
+
+// split the comma-separated <list> of at most <max> names into <names>
+// the list is modified, return number of names, -1 if there are more
+// or a name is empty
+int splitList(char *list, const char **names, int max) {
+	int count = 0;
+
+	while (count < max) {
+		names[count++] = list;
+		list = strchr(list, ',');
+
+		if (list != NULL) {
+			*list++ = 0;
+		}
+
+		if (names[count - 1][0] == 0) {
+			return -1;
+		}
+
+		if (list == NULL) {
+			return count;
+		}
+	}
+
+	return -1;
+}
+
+// link the records of <nFields> fingerprints of <indexFile> and <queryFile>
+// with the options of main() and return its exit code
+int linkFields(const char *indexFile, const char *queryFile, double *weights, int nFields, long long size, int threads,
+		double minScore, int maxResults, int sort, const char *resultFile, int format, const char *seperator, int quiet) {
+	Fingerprint ***fields;
+	long long sizeRecords, sizeQueries, sizeResult;
+	int nBits[MAX_FIELDS];
+	double start, loadTime, buildTime, searchTime;
+	FILE *in;
+	int status;
+
+	// load index
+	start = currentTime();
+	fields = readFields(indexFile, nFields, size, &sizeRecords, nBits);
+	loadTime = currentTime() - start;
+
+	if (fields == NULL) {
+		fprintf(stderr, "cannot read index file %s\n", indexFile);
+		return 2;
+	}
+
+	in = fopen(queryFile, "r");
+
+	if (in == NULL) {
+		fprintf(stderr, "cannot read query file %s\n", queryFile);
+		return 2;
+	}
+
+	start = currentTime();
+	CompositeGrid grid(fields, nFields, sizeRecords, nBits, weights, threads);
+	buildTime = currentTime() - start;
+	delete[] fields;
+
+	// search queries, the score column is named like that of multibitTree.searchFields
+	ResultWriter writer(&resultFile, 1, format, seperator, grid.getRecords(), NULL, NULL);
+
+	if (!writer.isOpen()) {
+		fprintf(stderr, "cannot open result file %s\n", resultFile);
+		return 3;
+	}
+
+	start = currentTime();
+	QueryResult queryResult(sort ? SORT_QUERY : SORT_NONE, sort ? NULL : &writer, grid.getRecords(), grid.getThreads());
+
+	if (maxResults > 0) {
+		queryResult.setLimit((int) MIN((long long) maxResults, grid.getSize()));
+	}
+
+	sizeQueries = grid.searchFile(&queryResult, in, minScore);
+	fclose(in);
+
+	queryResult.finish();
+	queryResult.merge(grid.getWorkerPool());
+	sizeResult = queryResult.getSize();
+
+	if (sort) {
+		writer.submitRecords(&queryResult, queryResult.getRecords(), sizeResult);
+	}
+	status = writer.close();
+	searchTime = currentTime() - start;
+
+	if (status != 0) {
+		fprintf(stderr, "cannot write result file %s\n", resultFile);
+		return 3;
+	}
+
+	if (!quiet) {
+		fprintf(stderr, "index:   %lld records of %d fields, loaded in %.3f s, built in %.3f s\n", sizeRecords, nFields, loadTime, buildTime);
+		fprintf(stderr, "cells:   %d, %.2f%% skipped, %.2f%% of the records scored\n", grid.getCells(), grid.getSkippedCells(), grid.getScoredRecords());
+		fprintf(stderr, "queries: %lld in %.3f s, %.1f queries/s\n", sizeQueries, searchTime, sizeQueries / MAX(searchTime, 1e-9));
+		fprintf(stderr, "results: %lld, %.1f results/s\n", sizeResult, sizeResult / MAX(searchTime, 1e-9));
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	char defaultFile[] = "-";
+	char *fileList = defaultFile;
+	const char *resultFiles[MAX_BANDS];
+	int files;
+	const char *seperator = ",";
+	int format = FORMAT_CSV;
+	const char *thresholdList = "0.8";
+	double thresholds[MAX_BANDS];
+	double minTanimoto;
+	const char *limitList = "0";
+	double limits[MAX_BANDS];
+	int nLimits;
+	float bandThresholds[MAX_BANDS];
+	int bandLimits[MAX_BANDS];
+	bandsType bands;
+	int nBands;
+	const char *measureName = MEASURE_NAMES[MEASURE_TANIMOTO];
+	measureType measure;
+	float minScore, planTanimoto;
+	double meanCard = 0;
+	int sort = 0;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int leafLimit = 8;
+	int dims = 1;
+	int engine = -1;
+	const char *engineName = ENGINE_NAMES[ENGINE_AUTO];
+	long long size = 0;
+	int numa = 0;
+	const char *storeDir = NULL;
+	long long resident = 1024;
+	CellStore *store = NULL;
+	int quiet = 0;
+	int tune = 0;
+	int memory = 0;
+	long long sample = 0;
+	double weights[MAX_FIELDS];
+	int nFields = 0;
+	int blocked = 0;
+	BlockKeys *blocks = NULL;
+	Fingerprint **queries = NULL;
+	BruteForce *scanner = NULL;
+	Fingerprint **scanPrints = NULL;
+	int queryBits;
+	Fingerprint **prints = NULL;
+	RecordTable *records = NULL;
+	Grid1D *grid;
+	long long sizePrints, sizeQueries, sizeResult;
+	int nBits;
+	double start, loadTime, buildTime, searchTime;
+	double values[STATISTICS_SIZE], percents[STATISTICS_SIZE];
+	FILE *in;
+	int status;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "o:bs:t:d:m:ST:l:AD:e:n:kNO:R:V:MF:q")) != -1) {
+		switch (opt) {
+			case 'o': fileList = optarg; break;
+			case 'b': format = FORMAT_BINARY; break;
+			case 's': seperator = optarg; break;
+			case 't': thresholdList = optarg; break;
+			case 'd': measureName = optarg; break;
+			case 'm': limitList = optarg; break;
+			case 'S': sort = 1; break;
+			case 'T': threads = atoi(optarg); break;
+			case 'l': leafLimit = atoi(optarg); break;
+			case 'A': tune = 1; break;
+			case 'D': dims = atoi(optarg); break;
+			case 'e': engineName = optarg; break;
+			case 'n': size = atoll(optarg); break;
+			case 'k': blocked = 1; break;
+			case 'N': numa = 1; break;
+			case 'O': storeDir = optarg; break;
+			case 'R': resident = atoll(optarg); break;
+			case 'V': sample = atoll(optarg); break;
+			case 'M': memory = 1; break;
+			case 'F': nFields = parseWeights(optarg, weights); break;
+			case 'q': quiet = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	for (int i = 0; i < ENGINES; i++) {
+		if (strcmp(engineName, ENGINE_NAMES[i]) == 0) {
+			engine = i;
+		}
+	}
+
+	// the lowest threshold of the bands is searched, for Hamming distances the highest
+	nBands = parseList(thresholdList, thresholds, MAX_BANDS);
+	nLimits = parseList(limitList, limits, MAX_BANDS);
+	files = splitList(fileList, resultFiles, MAX_BANDS);
+
+	if (!measureParse(measureName, &measure) || (nBands < 1) || ((nLimits != 1) && (nLimits != nBands)) || ((files != 1) && (files != nBands))) {
+		usage(argv[0]);
+	}
+
+	minTanimoto = thresholds[0];
+	for (int i = 0; i < nBands; i++) {
+		if ((measure.type == MEASURE_HAMMING) ? (thresholds[i] < 0) : ((thresholds[i] <= 0) || (thresholds[i] > 1))) {
+			usage(argv[0]);
+		}
+		minTanimoto = (measure.type == MEASURE_HAMMING) ? MAX(minTanimoto, thresholds[i]) : MIN(minTanimoto, thresholds[i]);
+	}
+
+	for (int i = 0; i < nLimits; i++) {
+		if (!(limits[i] >= 0)) {
+			usage(argv[0]);
+		}
+	}
+
+	if ((argc - optind != 2) || (engine < 0) || ((nFields > 0) && ((measure.type != MEASURE_TANIMOTO) || (nBands > 1) || (nLimits > 1) || (files > 1))) || ((sample > 0) && (nBands > 1)) || (threads < 1) || (leafLimit < 1) || (dims < 1) || (dims > MAX_DIMS) || (size < 0) || (sample < 0) || (resident < 1) || (nFields < 0) || (blocked && (sample > 0))) {
+		usage(argv[0]);
+	}
+
+	if (nFields > 0) {
+		return linkFields(argv[optind], argv[optind + 1], weights, nFields, size, threads,
+			minTanimoto, (int) limits[0], sort, resultFiles[0], format, seperator, quiet);
+	}
+
+	// the cells of a store are built from a partition of the prints in its directory
+	if (storeDir != NULL) {
+		store = new CellStore(storeDir, resident << 20);
+
+		if (!store->isOpen()) {
+			fprintf(stderr, "cannot create cell files in %s\n", storeDir);
+			delete store;
+			return 3;
+		}
+	}
+
+	// load index
+	start = currentTime();
+	if (blocked) {
+		blocks = new BlockKeys();
+	}
+	if (store != NULL) {
+		records = new RecordTable();
+		sizePrints = partitionPrints(argv[optind], size, store, records, &nBits, blocks);
+	} else if (blocked) {
+		prints = readBlockedPrints(argv[optind], size, &sizePrints, &nBits, blocks);
+	} else {
+		prints = readPrints(argv[optind], size, &sizePrints, &nBits);
+	}
+	loadTime = currentTime() - start;
+
+	if ((store != NULL) ? (sizePrints < 0) : (prints == NULL)) {
+		fprintf(stderr, "cannot read index file %s\n", argv[optind]);
+		delete blocks;
+		delete records;
+		delete store;
+		return 2;
+	}
+
+	in = fopen(argv[optind + 1], "r");
+
+	if (in == NULL) {
+		fprintf(stderr, "cannot read query file %s\n", argv[optind + 1]);
+		return 2;
+	}
+
+	// the engines are planned for the Tanimoto coefficient that is equivalent
+	// to the threshold of the measure at the mean cardinality
+	minScore = measureValue(&measure, minTanimoto);
+	if (store != NULL) {
+		for (int c = 0; c <= nBits; c++) {
+			meanCard += (double) c * store->getPartitionCount(c);
+		}
+	} else {
+		for (long long i = 0; i < sizePrints; i++) {
+			meanCard += prints[i]->cardinality();
+		}
+	}
+	meanCard /= MAX(sizePrints, 1);
+	planTanimoto = measurePlanTanimoto(&measure, (int) (meanCard + 0.5), minScore);
+
+	// choose leaf limit and threads, the measurements can be used for later runs
+	// with a store the tuner gets the sample of the partition
+	if (tune) {
+		Tuner tuner(dims, engine, planTanimoto);
+
+		start = currentTime();
+		if (store != NULL) {
+			Fingerprint **tunePrints = new Fingerprint*[TUNE_SAMPLE_SIZE];
+			long long sizeTune = store->samplePartition(tunePrints, TUNE_SAMPLE_SIZE);
+
+			tuner.tune(tunePrints, sizeTune, nBits, threads, numa);
+
+			for (long long i = 0; i < sizeTune; i++) {
+				delete tunePrints[i];
+			}
+			delete[] tunePrints;
+		} else {
+			tuner.tune(prints, sizePrints, nBits, threads, numa);
+		}
+		leafLimit = tuner.getLeafLimit();
+		threads = tuner.getThreads();
+
+		if (!quiet) {
+			for (int i = 0; i < tuner.getMeasurementCount(); i++) {
+				tuneMeasurementType *measurement = &tuner.getMeasurements()[i];
+
+				fprintf(stderr, "tuning:  leafLimit %d, %d threads, %.1f queries/s\n",
+					measurement->leafLimit, measurement->threads, measurement->queriesPerSecond);
+			}
+			fprintf(stderr, "tuned:   -l %d -T %d in %.3f s\n", leafLimit, threads, currentTime() - start);
+		}
+	}
+
+	// the scan of the verification copies the prints numbered like the grid,
+	// as the grid keeps only one print of each set of duplicates
+	// with a store the prints are only in the partition and are read again
+	if (sample > 0) {
+		long long sizeScan;
+		int scanBits;
+
+		fclose(in);
+		queries = readPrints(argv[optind + 1], 0, &sizeQueries, &queryBits);
+		scanPrints = (store != NULL) ? readPrints(argv[optind], sizePrints, &sizeScan, &scanBits) : prints;
+
+		if ((queries == NULL) || (scanPrints == NULL)) {
+			fprintf(stderr, "cannot read the prints of the verification\n");
+			return 2;
+		}
+
+		for (long long i = 0; i < sizePrints; i++) {
+			scanPrints[i]->setIndex(i);
+		}
+		scanner = new BruteForce(scanPrints, 0, sizePrints, MAX(nBits, queryBits));
+
+		if (store != NULL) {
+			for (long long i = 0; i < sizePrints; i++) {
+				delete scanPrints[i];
+			}
+			delete[] scanPrints;
+		}
+	}
+
+	start = currentTime();
+	if (store != NULL) {
+		grid = new Grid1D(store, records, threads, numa, leafLimit, dims, engine, planTanimoto, blocks);
+	} else {
+		grid = new Grid1D(prints, sizePrints, nBits, threads, numa, leafLimit, dims, engine, planTanimoto, blocks);
+	}
+	buildTime = currentTime() - start;
+
+	if (sample > 0) {
+		long long differences = verify(grid, scanner, queries, sizeQueries, sample, minScore, &measure);
+
+		for (long long i = 0; i < sizeQueries; i++) {
+			delete queries[i];
+		}
+		delete[] queries;
+		delete scanner;
+		delete grid;
+
+		return (differences > 0) ? 4 : 0;
+	}
+
+	// search queries, the limits of the bands are given in the order of their thresholds
+	for (int i = 0; i < nBands; i++) {
+		bandThresholds[i] = measureValue(&measure, thresholds[i]);
+		bandLimits[i] = (int) MIN((long long) limits[(nLimits > 1) ? i : 0], grid->getSize());
+	}
+	bandsInit(&bands, nBands, bandThresholds, bandLimits);
+
+	ResultWriter writer(resultFiles, files, format, seperator, grid->getRecords(), &measure, &bands);
+
+	if (!writer.isOpen()) {
+		if (files == 1) {
+			fprintf(stderr, "cannot open result file %s\n", resultFiles[0]);
+		} else {
+			fprintf(stderr, "cannot open the result files of the bands\n");
+		}
+		delete grid;
+		return 3;
+	}
+
+	start = currentTime();
+	QueryResult queryResult(sort ? SORT_QUERY : SORT_NONE, sort ? NULL : &writer, grid->getRecords(), grid->getThreads());
+
+	queryResult.setBands(&bands);
+	queryResult.setMeasure(&measure);
+	sizeQueries = grid->searchFile(&queryResult, in, minScore);
+	fclose(in);
+
+	queryResult.finish();
+	queryResult.merge(grid->getWorkerPool());
+	sizeResult = queryResult.getSize();
+
+	if (sort) {
+		writer.submitRecords(&queryResult, queryResult.getRecords(), sizeResult);
+	}
+	status = writer.close();
+	searchTime = currentTime() - start;
+	grid->setResultMemory(&queryResult);
+
+	if (status != 0) {
+		if (files == 1) {
+			fprintf(stderr, "cannot write result file %s\n", resultFiles[0]);
+		} else {
+			fprintf(stderr, "cannot write the result files of the bands\n");
+		}
+		delete grid;
+		return 3;
+	}
+
+	if (!quiet) {
+		fprintf(stderr, "index:   %lld fingerprints, %lld distinct, loaded in %.3f s, built in %.3f s\n", sizePrints, grid->getDistinct(), loadTime, buildTime);
+		grid->getStatistics(values, percents);
+		if (blocks != NULL) {
+			fprintf(stderr, "blocks:  %d keys in %d cells\n", blocks->getSize(), grid->getCells());
+		}
+		if (isnan(values[6])) {
+			fprintf(stderr, "engines: %.0f of %d cells scanned, predicted cost %.0f (trees not measured)\n",
+				values[5], grid->getCells(), values[8]);
+		} else {
+			fprintf(stderr, "engines: %.0f of %d cells scanned, predicted cost %.0f (trees %.0f, scans %.0f)\n",
+				values[5], grid->getCells(), values[8], values[6], values[7]);
+		}
+		if (store != NULL) {
+			fprintf(stderr, "store:   %lld cell files mapped, %lld reads failed\n", store->getMaps(), store->getFailures());
+		}
+		fprintf(stderr, "queries: %lld in %.3f s, %.1f queries/s\n", sizeQueries, searchTime, sizeQueries / MAX(searchTime, 1e-9));
+		fprintf(stderr, "results: %lld, %.1f results/s\n", sizeResult, sizeResult / MAX(searchTime, 1e-9));
+	}
+
+	if (memory) {
+		printMemory(grid);
+	}
+
+	// failed reads of cell files are reported even if statistics are not
+	if ((store != NULL) && (store->getFailures() > 0)) {
+		fprintf(stderr, "%lld reads of cell files failed, the results are incomplete\n", store->getFailures());
+		delete grid;
+		return 5;
+	}
+
+	delete grid;
+	return 0;
+}
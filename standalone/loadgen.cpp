@@ -0,0 +1,247 @@
+// loadgen.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Parser.h"
+#include "Similarity.h"
+#include "Protocol.h"
+#include "Measure.h"
+
+// This file contains a load generator for the search server. Each of
+// <connections> threads opens a connection and sends <requests> queries of
+// a query file, starting at a different query, with up to <window> requests
+// without response. The throughput and the percentiles of the latencies
+// between sending a request and receiving its response are printed.
+//
+// exit codes
+// 0	success
+// 1	invalid arguments
+// 2	query file cannot be read
+// 3	server cannot be reached or closed the connection
+// 4	the server rejected a request
+
+// Instances of loadThreadType hold the parameters and measurements of a connection.
+typedef struct loadThreadStruct {
+	const char *path;		// socket of the server
+	Fingerprint **queries;		// the queries
+	long long sizeQueries;		// number of queries
+	long long first;		// number of the first query to send
+	long long requests;		// number of requests to send
+	int window;			// maximal number of requests without response
+	requestType request;		// parameters of the requests
+	double *latencies;		// latency of each request in ms
+	long long results;		// number of results
+	int status;			// exit code of the thread
+} loadThreadType;
+
+// print usage and exit
+void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options] socket query-file\n"
+		"  -c connections    number of concurrent connections (default 4)\n"
+		"  -r requests       number of requests per connection (default 1000)\n"
+		"  -w window         maximal number of requests without response per connection (default 1)\n"
+		"  -i index          number of the index of the server (default 0)\n"
+		"  -t threshold      minimal Tanimoto coefficient or score, maximal Hamming distance (default 0.8)\n"
+		"  -d measure        similarity measure: tanimoto, dice, hamming or tversky:alpha,beta\n"
+		"                    (default tanimoto)\n"
+		"  -m size           maximal number of results per query (default 0 = all)\n"
+		"  -S                sort the results of each query by score\n"
+		"  -I                request the ids of the fingerprints\n",
+		name);
+	exit(1);
+}
+
+// send the requests of a connection and measure their latencies
+void *runConnection(void *arg) {
+	loadThreadType *load = (loadThreadType*) arg;
+	double *sendTimes = new double[load->window];
+	responseBufferType buffer;
+	responseType response;
+	long long sent = 0, received = 0;
+	int fd = connectServer(load->path);
+
+	load->results = 0;
+	load->status = 0;
+	responseBufferInit(&buffer);
+
+	if (fd < 0) {
+		load->status = 3;
+	}
+
+	// the send times are kept in a ring of <window> entries, responses arrive in order
+	while ((load->status != 3) && (received < load->requests)) {
+		while ((sent < load->requests) && (sent - received < load->window)) {
+			load->request.id = (unsigned int) sent;
+			sendTimes[sent % load->window] = currentTime();
+
+			if (!sendRequest(fd, &load->request, load->queries[(load->first + sent) % load->sizeQueries])) {
+				load->status = 3;
+				break;
+			}
+			sent++;
+		}
+
+		if ((load->status == 3) || !receiveResponse(fd, &response, &buffer) || (response.id != (unsigned int) received)) {
+			load->status = 3;
+			break;
+		}
+
+		load->latencies[received] = (currentTime() - sendTimes[received % load->window]) * 1000;
+		load->results += response.count;
+
+		if (response.status != STATUS_OK) {
+			load->status = 4;
+		}
+		received++;
+	}
+
+	if (fd >= 0) {
+		close(fd);
+	}
+	delete[] sendTimes;
+	responseBufferFree(&buffer);
+
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	int connections = 4;
+	long long requests = 1000;
+	int window = 1;
+	int index = 0;
+	double threshold = 0.8;
+	const char *measureName = MEASURE_NAMES[MEASURE_TANIMOTO];
+	measureType measure;
+	int limit = 0;
+	int sort = 0;
+	int ids = 0;
+	Fingerprint **queries;
+	long long sizeQueries;
+	int nBits;
+	loadThreadType *loads;
+	pthread_t *threads;
+	double *latencies;
+	long long results = 0;
+	int status = 0;
+	double start, time;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:r:w:i:t:d:m:SI")) != -1) {
+		switch (opt) {
+			case 'c': connections = atoi(optarg); break;
+			case 'r': requests = atoll(optarg); break;
+			case 'w': window = atoi(optarg); break;
+			case 'i': index = atoi(optarg); break;
+			case 't': threshold = atof(optarg); break;
+			case 'd': measureName = optarg; break;
+			case 'm': limit = atoi(optarg); break;
+			case 'S': sort = 1; break;
+			case 'I': ids = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	if ((argc - optind != 2) || !measureParse(measureName, &measure) || (connections < 1) || (requests < 1) || (window < 1) || (index < 0) || (index > 0xFFFF) || (limit < 0)) {
+		usage(argv[0]);
+	}
+
+	queries = readPrints(argv[optind + 1], 0, &sizeQueries, &nBits);
+
+	if ((queries == NULL) || (sizeQueries == 0)) {
+		fprintf(stderr, "cannot read query file %s\n", argv[optind + 1]);
+		return 2;
+	}
+
+	loads = new loadThreadType[connections];
+	threads = new pthread_t[connections];
+	latencies = new double[connections * requests];
+
+	// the connections start at evenly spread queries
+	for (int i = 0; i < connections; i++) {
+		loadThreadType *load = &loads[i];
+
+		load->path = argv[optind];
+		load->queries = queries;
+		load->sizeQueries = sizeQueries;
+		load->first = i * sizeQueries / connections;
+		load->requests = requests;
+		load->window = window;
+		load->latencies = &latencies[i * requests];
+
+		memset(&load->request, 0, sizeof(requestType));
+		load->request.index = index;
+		load->request.measure = measure.type;
+		load->request.flags = (sort ? REQUEST_SORT : 0) | (ids ? REQUEST_IDS : 0);
+		load->request.threshold = threshold;
+		load->request.alpha = measure.alpha;
+		load->request.beta = measure.beta;
+		load->request.limit = limit;
+	}
+
+	start = currentTime();
+	for (int i = 0; i < connections; i++) {
+		pthread_create(&threads[i], NULL, runConnection, &loads[i]);
+	}
+	for (int i = 0; i < connections; i++) {
+		pthread_join(threads[i], NULL);
+		results += loads[i].results;
+		status = MAX(status, loads[i].status);
+	}
+	time = currentTime() - start;
+
+	if (status == 3) {
+		fprintf(stderr, "connection to %s failed\n", argv[optind]);
+	} else {
+		long long total = connections * requests;
+
+		if (status == 4) {
+			fprintf(stderr, "the server rejected requests\n");
+		}
+
+		qsort(latencies, total, sizeof(double), compareDoubles);
+
+		printf("requests: %lld on %d connections in %.3f s, %.1f requests/s\n", total, connections, time, total / MAX(time, 1e-9));
+		printf("latency:  p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+			percentile(latencies, total, 0.5), percentile(latencies, total, 0.9),
+			percentile(latencies, total, 0.99), latencies[total - 1]);
+		printf("results:  %lld, %.1f per request\n", results, (double) results / total);
+	}
+
+	for (long long i = 0; i < sizeQueries; i++) {
+		delete queries[i];
+	}
+	delete[] queries;
+	delete[] loads;
+	delete[] threads;
+	delete[] latencies;
+
+	return status;
+}
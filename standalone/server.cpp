@@ -0,0 +1,608 @@
+// server.cpp
+//
+// Copyright (c) 2015
+// Universitaet Duisburg-Essen
+// Campus Duisburg
+// Institut fuer Soziologie
+// Prof. Dr. Rainer Schnell
+// Lotharstr. 65
+// 47057 Duisburg 
+//
+// This file is part of the R-Package "multibitTree".
+//
+// "multibitTree" is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// "multibitTree" is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with "multibitTree". If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include "Grid1D.h"
+#include "Parser.h"
+#include "Similarity.h"
+#include "Protocol.h"
+#include "Measure.h"
+
+// This file contains a search server that keeps the grids of one or more
+// index files in memory and answers the requests of local clients over a
+// Unix domain socket in the binary protocol of Protocol.h.
+//
+// The server waits for input on all connections at once. All requests that
+// are complete after a wait form a batch: their searches are dispatched to
+// the ThreadPool shared by the grids before the server waits for any of them,
+// so the threads work on the whole batch. A batch with fewer requests than
+// threads is searched cell by cell, a larger one query by query. The responses
+// are sent after the batch is complete, a client may send further requests
+// in the meantime.
+//
+// The server stops on SIGINT or SIGTERM and removes the socket.
+//
+// exit codes
+// 0	success
+// 1	invalid arguments
+// 2	index file cannot be read
+// 3	socket cannot be created
+
+#define MAX_INDEXES 64			// maximal number of index files
+#define MAX_CONNECTIONS 1024		// maximal number of open connections
+#define READ_SIZE 65536			// bytes read from a connection at once
+#define INPUT_LIMIT (1 << 20)		// buffered input of a connection that stops reading
+#define OUTPUT_LIMIT (64 << 20)		// unsent output of a connection that stops searching its requests
+
+// Instances of connectionType hold the buffers of a client connection.
+typedef struct connectionStruct {
+	int fd;				// socket of the connection
+	char *input;			// received bytes
+	long long inputStart;		// first byte of the next request
+	long long inputSize;		// number of received bytes
+	long long inputCapacity;	// allocated size of input
+	char *output;			// responses to be sent
+	long long outputSent;		// number of sent bytes
+	long long outputSize;		// number of bytes of the responses
+	long long outputCapacity;	// allocated size of output
+	int reading;			// flag cleared once the client stopped sending
+	int failed;			// flag if the connection failed or sent an invalid request
+} connectionType;
+
+// Instances of pendingType hold a request of a batch.
+typedef struct pendingStruct {
+	connectionType *connection;	// connection of the request
+	requestType request;		// header of the request
+	measureType measure;		// measure of the request
+	Grid1D *grid;			// grid of the index of the request
+	Fingerprint *query;		// the query
+	QueryResult *result;		// results, NULL if the request is invalid
+	unsigned int status;		// status of the response
+} pendingType;
+
+static volatile sig_atomic_t sStop = 0;	// flag set by a signal to stop the server
+
+// set the stop flag
+void stopServer(int) {
+	sStop = 1;
+}
+
+// print usage and exit
+void usage(const char *name) {
+	fprintf(stderr,
+		"usage: %s [options] socket index-file...\n"
+		"  -T threads        number of threads shared by the indexes (default all cpus)\n"
+		"  -l leafLimit      leaf limit of the trees (default 8)\n"
+		"  -D dims           number of bit ranges for cells (default 1)\n"
+		"  -e engine         search engine of the cells: auto, tree or scan (default auto)\n"
+		"  -t tanimoto       Tanimoto coefficient the engines are planned for (default 0.8)\n"
+		"  -N                bind threads to NUMA nodes\n"
+		"  -B size           maximal number of requests of a batch (default 256)\n"
+		"  -q                do not print statistics\n"
+		"requests name the index by the number of its file, starting with 0\n",
+		name);
+	exit(1);
+}
+
+// create the listening socket at <path>, an existing socket is replaced
+// return the socket or -1 on failure
+int listenSocket(const char *path) {
+	struct sockaddr_un address;
+	int fd;
+
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if ((bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0) || (listen(fd, SOMAXCONN) != 0)) {
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
+}
+
+// create a connection for socket <fd>
+connectionType *openConnection(int fd) {
+	connectionType *connection = new connectionType;
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	connection->fd = fd;
+	connection->inputCapacity = READ_SIZE;
+	connection->input = new char[connection->inputCapacity];
+	connection->inputStart = 0;
+	connection->inputSize = 0;
+	connection->outputCapacity = READ_SIZE;
+	connection->output = new char[connection->outputCapacity];
+	connection->outputSent = 0;
+	connection->outputSize = 0;
+	connection->reading = 1;
+	connection->failed = 0;
+
+	return connection;
+}
+
+// close <connection> and release its buffers
+void closeConnection(connectionType *connection) {
+	close(connection->fd);
+	delete[] connection->input;
+	delete[] connection->output;
+	delete connection;
+}
+
+// read the available bytes of <connection>
+// clear the reading flag at the end of the stream
+void readInput(connectionType *connection) {
+	// move the incomplete request to the start of the buffer
+	if (connection->inputStart > 0) {
+		memmove(connection->input, connection->input + connection->inputStart, connection->inputSize - connection->inputStart);
+		connection->inputSize -= connection->inputStart;
+		connection->inputStart = 0;
+	}
+
+	while (connection->inputSize < INPUT_LIMIT) {
+		ssize_t n;
+
+		if (connection->inputCapacity - connection->inputSize < READ_SIZE) {
+			char *input = new char[2 * connection->inputCapacity];
+
+			memcpy(input, connection->input, connection->inputSize);
+			delete[] connection->input;
+			connection->input = input;
+			connection->inputCapacity *= 2;
+		}
+
+		n = recv(connection->fd, connection->input + connection->inputSize, READ_SIZE, 0);
+
+		if (n > 0) {
+			connection->inputSize += n;
+		} else if (n == 0) {
+			connection->reading = 0;
+			return;
+		} else if (errno != EINTR) {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				connection->failed = 1;
+			}
+			return;
+		}
+	}
+}
+
+// send the pending output of <connection> until the socket is full
+void writeOutput(connectionType *connection) {
+	while (connection->outputSent < connection->outputSize) {
+		ssize_t n = send(connection->fd, connection->output + connection->outputSent,
+			connection->outputSize - connection->outputSent, MSG_NOSIGNAL);
+
+		if (n > 0) {
+			connection->outputSent += n;
+		} else if ((n < 0) && (errno != EINTR)) {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				connection->failed = 1;
+			}
+			return;
+		}
+	}
+
+	connection->outputSent = 0;
+	connection->outputSize = 0;
+}
+
+// append <size> bytes of <data> to the output of <connection>
+void appendOutput(connectionType *connection, const void *data, long long size) {
+	if (connection->outputSize + size > connection->outputCapacity) {
+		long long capacity = MAX(2 * connection->outputCapacity, connection->outputSize + size);
+		char *output = new char[capacity];
+
+		memcpy(output, connection->output, connection->outputSize);
+		delete[] connection->output;
+		connection->output = output;
+		connection->outputCapacity = capacity;
+	}
+
+	memcpy(connection->output + connection->outputSize, data, size);
+	connection->outputSize += size;
+}
+
+// check if the input of <connection> holds a complete request
+// return 1 if it does, 0 if it does not and -1 if the request is invalid
+int requestReady(connectionType *connection) {
+	requestType request;
+	long long available = connection->inputSize - connection->inputStart;
+
+	if (available < (long long) sizeof(requestType)) {
+		return 0;
+	}
+
+	memcpy(&request, connection->input + connection->inputStart, sizeof(requestType));
+
+	if ((request.magic != PROTOCOL_MAGIC) || (request.bits > PROTOCOL_MAX_BITS)) {
+		return -1;
+	}
+
+	return available >= (long long) sizeof(requestType) + protocolBytes(request.bits);
+}
+
+// take the next request of <connection> into <pending>
+// the request must be complete
+void takeRequest(connectionType *connection, pendingType *pending) {
+	const unsigned char *bytes;
+	int count;
+
+	memcpy(&pending->request, connection->input + connection->inputStart, sizeof(requestType));
+	bytes = (const unsigned char*) connection->input + connection->inputStart + sizeof(requestType);
+	count = protocolBytes(pending->request.bits);
+
+	// the padding bits of the last byte are ignored
+	pending->query = new Fingerprint((int) pending->request.bits);
+	for (int i = 0; i < count; i++) {
+		unsigned char byte = bytes[i];
+
+		if ((i == count - 1) && (pending->request.bits % 8 != 0)) {
+			byte &= (1u << (pending->request.bits % 8)) - 1;
+		}
+		pending->query->setByte(i, byte);
+	}
+	pending->query->fold();
+
+	pending->connection = connection;
+	pending->result = NULL;
+	connection->inputStart += sizeof(requestType) + count;
+}
+
+// check the parameters of <pending> and start its search in <grids>
+// <cells> is set if the search is parallelised by cells
+void startSearch(pendingType *pending, Grid1D **grids, int nGrids, int cells) {
+	requestType *request = &pending->request;
+	measureType *measure = &pending->measure;
+	Grid1D *grid;
+	float minScore;
+
+	if (request->index >= nGrids) {
+		pending->status = STATUS_INDEX;
+		return;
+	}
+
+	measure->type = request->measure;
+	measure->alpha = request->alpha;
+	measure->beta = request->beta;
+
+	if ((request->measure >= MEASURES) || ((measure->type == MEASURE_TVERSKY) && (!(measure->alpha >= 0) || !(measure->beta >= 0) || !(measure->alpha + measure->beta > 0)))
+		|| ((measure->type == MEASURE_HAMMING) ? !(request->threshold >= 0) : (!(request->threshold > 0) || (request->threshold > 1)))) {
+		pending->status = STATUS_INVALID;
+		return;
+	}
+
+	grid = grids[request->index];
+	pending->grid = grid;
+	pending->status = STATUS_OK;
+	pending->query->setIndex(0);
+	pending->result = new QueryResult((request->flags & REQUEST_SORT) ? SORT_TANIMOTO : SORT_NONE, NULL, grid->getRecords(), grid->getThreads());
+	pending->result->setMeasure(measure);
+
+	// the heap for the limited results needs not be larger than the grid
+	if (request->limit > 0) {
+		pending->result->setLimit((int) MIN(MIN((long long) request->limit, grid->getSize()), (long long) INT_MAX));
+	}
+
+	minScore = measureValue(measure, request->threshold);
+
+	if (cells && (request->limit == 0)) {
+		grid->searchCells(pending->result, pending->query, minScore);
+	} else {
+		grid->searchAsync(pending->result, pending->query, minScore, NULL);
+	}
+}
+
+// append the response of <pending> to the output of its connection
+// all searches must be completed, return the number of results
+long long finishSearch(pendingType *pending, ThreadPool *pool) {
+	responseType response;
+	resultRecordType *records = NULL;
+	RecordTable *ids = NULL;
+	long long size = 0;
+	long long idBytes = 0;
+
+	response.magic = PROTOCOL_MAGIC;
+	response.id = pending->request.id;
+	response.status = pending->status;
+
+	if (pending->result != NULL) {
+		pending->result->merge(pool);
+		size = pending->result->getSize();
+
+		if (pending->request.limit > 0) {
+			size = MIN(size, (long long) pending->request.limit);
+		}
+		records = pending->result->getRecords();
+	}
+
+	// the ids follow the records, the header gives their size
+	if ((size > 0) && (pending->request.flags & REQUEST_IDS)) {
+		ids = pending->grid->getRecords();
+
+		for (long long i = 0; i < size; i++) {
+			idBytes += strlen(ids->getId(records[i].print)) + 1;
+		}
+	}
+
+	response.count = (unsigned int) size;
+	response.idBytes = (unsigned int) idBytes;
+	appendOutput(pending->connection, &response, sizeof(responseType));
+
+	for (long long i = 0; i < size; i++) {
+		responseRecordType record;
+
+		record.print = records[i].print;
+		// adding 0 turns the negated distance of an exact match from -0 into 0
+		record.score = measureValue(&pending->measure, records[i].tanimoto) + 0.0f;
+		appendOutput(pending->connection, &record, sizeof(responseRecordType));
+	}
+
+	if (ids != NULL) {
+		for (long long i = 0; i < size; i++) {
+			const char *id = ids->getId(records[i].print);
+
+			appendOutput(pending->connection, id, strlen(id) + 1);
+		}
+	}
+
+	delete pending->result;
+	delete pending->query;
+
+	return size;
+}
+
+int main(int argc, char **argv) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int leafLimit = 8;
+	int dims = 1;
+	int engine = -1;
+	const char *engineName = ENGINE_NAMES[ENGINE_AUTO];
+	double planTanimoto = 0.8;
+	int numa = 0;
+	int batchLimit = 256;
+	int quiet = 0;
+	Grid1D *grids[MAX_INDEXES];
+	int nGrids;
+	connectionType *connections[MAX_CONNECTIONS];
+	int nConnections = 0;
+	struct pollfd fds[MAX_CONNECTIONS + 1];
+	pendingType *batch;
+	int backlog = 0;
+	long long requests = 0, batches = 0, results = 0, accepted = 0;
+	double start;
+	int listener;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "T:l:D:e:t:NB:q")) != -1) {
+		switch (opt) {
+			case 'T': threads = atoi(optarg); break;
+			case 'l': leafLimit = atoi(optarg); break;
+			case 'D': dims = atoi(optarg); break;
+			case 'e': engineName = optarg; break;
+			case 't': planTanimoto = atof(optarg); break;
+			case 'N': numa = 1; break;
+			case 'B': batchLimit = atoi(optarg); break;
+			case 'q': quiet = 1; break;
+			default: usage(argv[0]);
+		}
+	}
+
+	for (int i = 0; i < ENGINES; i++) {
+		if (strcmp(engineName, ENGINE_NAMES[i]) == 0) {
+			engine = i;
+		}
+	}
+
+	nGrids = argc - optind - 1;
+
+	if ((nGrids < 1) || (nGrids > MAX_INDEXES) || (engine < 0) || (threads < 1) || (leafLimit < 1) || (dims < 1) || (dims > MAX_DIMS) || (planTanimoto <= 0) || (planTanimoto > 1) || (batchLimit < 1)) {
+		usage(argv[0]);
+	}
+
+	// load the indexes into grids that share the threads
+	ThreadPool pool(threads, numa);
+
+	for (int i = 0; i < nGrids; i++) {
+		const char *filename = argv[optind + 1 + i];
+		Fingerprint **prints;
+		long long size;
+		int nBits;
+
+		start = currentTime();
+		prints = readPrints(filename, 0, &size, &nBits);
+
+		if (prints == NULL) {
+			fprintf(stderr, "cannot read index file %s\n", filename);
+			return 2;
+		}
+
+		grids[i] = new Grid1D(prints, size, nBits, &pool, leafLimit, dims, engine, planTanimoto, NULL);
+
+		if (!quiet) {
+			fprintf(stderr, "index %d: %s, %lld fingerprints, %lld distinct, loaded in %.3f s\n",
+				i, filename, size, grids[i]->getDistinct(), currentTime() - start);
+		}
+	}
+
+	listener = listenSocket(argv[optind]);
+
+	if (listener < 0) {
+		fprintf(stderr, "cannot create socket %s\n", argv[optind]);
+		return 3;
+	}
+
+	signal(SIGINT, stopServer);
+	signal(SIGTERM, stopServer);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (!quiet) {
+		fprintf(stderr, "listening on %s with %d threads\n", argv[optind], pool.getSize());
+	}
+
+	batch = new pendingType[batchLimit];
+	start = currentTime();
+
+	while (!sStop) {
+		int nBatch = 0;
+		int taken;
+
+		// close connections that failed or are done
+		for (int i = 0; i < nConnections; i++) {
+			connectionType *connection = connections[i];
+
+			if (connection->failed || (!connection->reading && (connection->outputSize == 0) && (requestReady(connection) == 0))) {
+				closeConnection(connection);
+				connections[i--] = connections[--nConnections];
+			}
+		}
+
+		// wait for input, without waiting if requests were left over from the last batch
+		fds[0].fd = listener;
+		fds[0].events = (nConnections < MAX_CONNECTIONS) ? POLLIN : 0;
+		for (int i = 0; i < nConnections; i++) {
+			connectionType *connection = connections[i];
+
+			fds[i + 1].fd = connection->fd;
+			fds[i + 1].events = (connection->reading && (connection->inputSize - connection->inputStart < INPUT_LIMIT)) ? POLLIN : 0;
+			if (connection->outputSize > 0) {
+				fds[i + 1].events |= POLLOUT;
+			}
+		}
+
+		if (poll(fds, nConnections + 1, backlog ? 0 : -1) < 0) {
+			continue;
+		}
+
+		for (int i = 0; i < nConnections; i++) {
+			if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+				readInput(connections[i]);
+			}
+			if (fds[i + 1].revents & POLLOUT) {
+				writeOutput(connections[i]);
+			}
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd;
+
+			while ((nConnections < MAX_CONNECTIONS) && ((fd = accept(listener, NULL, NULL)) >= 0)) {
+				connections[nConnections++] = openConnection(fd);
+				accepted++;
+			}
+		}
+
+		// take the complete requests of all connections in turn
+		do {
+			taken = 0;
+
+			for (int i = 0; (i < nConnections) && (nBatch < batchLimit); i++) {
+				connectionType *connection = connections[i];
+				int ready;
+
+				if (connection->failed || (connection->outputSize - connection->outputSent >= OUTPUT_LIMIT)) {
+					continue;
+				}
+
+				ready = requestReady(connection);
+
+				if (ready < 0) {
+					connection->failed = 1;
+				} else if (ready > 0) {
+					takeRequest(connection, &batch[nBatch++]);
+					taken = 1;
+				}
+			}
+		} while (taken && (nBatch < batchLimit));
+
+		backlog = (nBatch == batchLimit);
+
+		if (nBatch == 0) {
+			continue;
+		}
+
+		// search the batch and send the responses
+		for (int i = 0; i < nBatch; i++) {
+			startSearch(&batch[i], grids, nGrids, nBatch < pool.getSize());
+		}
+		pool.wait();
+
+		for (int i = 0; i < nBatch; i++) {
+			results += finishSearch(&batch[i], &pool);
+		}
+
+		for (int i = 0; i < nConnections; i++) {
+			if (!connections[i]->failed && (connections[i]->outputSize > 0)) {
+				writeOutput(connections[i]);
+			}
+		}
+
+		requests += nBatch;
+		batches++;
+	}
+
+	if (!quiet) {
+		double time = currentTime() - start;
+
+		fprintf(stderr, "served:  %lld connections, %lld requests in %lld batches in %.3f s, %.1f requests/batch\n",
+			accepted, requests, batches, time, (double) requests / MAX(batches, 1));
+		fprintf(stderr, "results: %lld, %.1f per request\n", results, (double) results / MAX(requests, 1));
+	}
+
+	for (int i = 0; i < nConnections; i++) {
+		closeConnection(connections[i]);
+	}
+	close(listener);
+	unlink(argv[optind]);
+
+	for (int i = 0; i < nGrids; i++) {
+		delete grids[i];
+	}
+	delete[] batch;
+
+	return 0;
+}